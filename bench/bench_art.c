@@ -0,0 +1,115 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+// Compares longest-prefix matching of URL-like paths against a routing table,
+// with cu_art against cu_hm. The map has to be probed once for every '/' in
+// the path, longest prefix first, while the tree walks the path once.
+//
+// Usage: bench_art [number of routes]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <cu/art.h>
+#include <cu/hashmap.h>
+#include <cu/dbgassert.h>
+
+#define DEFAULT_NROUTES (UINT64_C(1) << 16)
+#define NLOOKUPS (UINT64_C(1) << 21)
+#define ROUTE_LEN 48
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t next_rand(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+// Longest route in `map` that's a prefix of `path` ending at a '/' or at the
+// end of the path.
+static void *hm_longest_prefix(cu_hm *map, cu_str path)
+{
+	for (size_t len = path.len; len > 0; --len) {
+		if (len != path.len && path.buf[len] != '/')
+			continue;
+		void *value = cu_hm_at(map, (cu_str){
+			.buf = path.buf,
+			.len = len,
+		});
+		if (value != NULL)
+			return value;
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t nroutes = DEFAULT_NROUTES;
+	if (argc > 1)
+		nroutes = strtoull(argv[1], NULL, 10);
+	dbgassert(nroutes > 0);
+
+	char *routes = malloc(nroutes * ROUTE_LEN);
+	char *paths = malloc(NLOOKUPS * ROUTE_LEN);
+	cu_str *path_strs = malloc(NLOOKUPS * sizeof(cu_str));
+	dbgassert(routes != NULL && paths != NULL && path_strs != NULL);
+
+	// routes like /svc12/v3/res45, and paths below them
+	uint64_t rng = UINT64_C(0x9E3779B97F4A7C15);
+	for (uint64_t i = 0; i < nroutes; ++i) {
+		snprintf(routes + i * ROUTE_LEN, ROUTE_LEN,
+			"/svc%llu/v%llu/res%llu",
+			(unsigned long long)(i % 64),
+			(unsigned long long)(i / 64 % 4),
+			(unsigned long long)(i / 256));
+	}
+	for (uint64_t i = 0; i < NLOOKUPS; ++i) {
+		char *path = paths + i * ROUTE_LEN;
+		snprintf(path, ROUTE_LEN, "%s/item/%llu",
+			routes + next_rand(&rng) % nroutes * ROUTE_LEN,
+			(unsigned long long)(next_rand(&rng) % 1000));
+		path_strs[i] = cu_str_from_cstr(path);
+	}
+
+	cu_art tree;
+	cu_hm map;
+	dbgassert(cu_art_new(&tree, NULL, 1 << 16) == 0);
+	dbgassert(cu_hm_new(&map, NULL) == 0);
+	for (uint64_t i = 0; i < nroutes; ++i) {
+		cu_str route = cu_str_from_cstr(routes + i * ROUTE_LEN);
+		dbgassert(cu_art_insert(&tree, route, routes + i * ROUTE_LEN)
+			== 0);
+		dbgassert(cu_hm_insert(&map, route, routes + i * ROUTE_LEN)
+			== 0);
+	}
+
+	printf("%llu routes, %llu lookups, ns/lookup\n",
+		(unsigned long long)nroutes, (unsigned long long)NLOOKUPS);
+	double start = now();
+	for (uint64_t i = 0; i < NLOOKUPS; ++i) {
+		dbgassert(cu_art_longest_prefix(&tree, path_strs[i], NULL)
+			!= NULL);
+	}
+	printf("%-8s %10.2f\n", "art", (now() - start) * 1e9 / NLOOKUPS);
+	start = now();
+	for (uint64_t i = 0; i < NLOOKUPS; ++i)
+		dbgassert(hm_longest_prefix(&map, path_strs[i]) != NULL);
+	printf("%-8s %10.2f\n", "cu_hm", (now() - start) * 1e9 / NLOOKUPS);
+
+	cu_hm_free(&map);
+	cu_art_free(&tree);
+	free(path_strs);
+	free(paths);
+	free(routes);
+}
@@ -0,0 +1,101 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+// Compares looking keys up one at a time with cu_hm_at against batched
+// lookups with cu_hm_at_many.
+//
+// Usage: bench_hashmap [number of keys]
+//
+// The default map is a few hundred megabytes, which should be well past the
+// size of any last-level cache.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <cu/hashmap.h>
+#include <cu/dbgassert.h>
+
+#define DEFAULT_NKEYS (UINT64_C(1) << 22)
+#define NLOOKUPS (UINT64_C(1) << 22)
+#define KEY_LEN 32
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// xorshift, just to scatter the lookups across the whole map
+static uint64_t next_rand(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t nkeys = DEFAULT_NKEYS;
+	if (argc > 1)
+		nkeys = strtoull(argv[1], NULL, 10);
+	dbgassert(nkeys > 0);
+
+	char *key_storage = malloc(nkeys * KEY_LEN);
+	cu_str *keys = malloc(nkeys * sizeof(cu_str));
+	cu_str *lookups = malloc(NLOOKUPS * sizeof(cu_str));
+	void **values = malloc(NLOOKUPS * sizeof(void *));
+	dbgassert(key_storage != NULL && keys != NULL);
+	dbgassert(lookups != NULL && values != NULL);
+
+	cu_hm hm;
+	dbgassert(cu_hm_new(&hm, NULL) == 0);
+	dbgassert(cu_hm_reserve(&hm, nkeys) == 0);
+	for (uint64_t i = 0; i < nkeys; ++i) {
+		char *key = key_storage + i * KEY_LEN;
+		snprintf(key, KEY_LEN, "bench-key-%llu", (unsigned long long)i);
+		keys[i] = cu_str_from_cstr(key);
+		dbgassert(cu_hm_insert(&hm, keys[i], key) == 0);
+	}
+
+	uint64_t rng = UINT64_C(0x9E3779B97F4A7C15);
+	for (uint64_t i = 0; i < NLOOKUPS; ++i) {
+		lookups[i] = keys[next_rand(&rng) % nkeys];
+	}
+
+	printf("%llu keys, %llu buckets (%llu MiB), %llu lookups\n",
+		(unsigned long long)nkeys,
+		(unsigned long long)hm.capacity,
+		(unsigned long long)(hm.capacity * sizeof(cu_hm_bucket) >> 20),
+		(unsigned long long)NLOOKUPS);
+
+	double start = now();
+	for (uint64_t i = 0; i < NLOOKUPS; ++i) {
+		values[i] = cu_hm_at(&hm, lookups[i]);
+	}
+	double single = now() - start;
+	for (uint64_t i = 0; i < NLOOKUPS; ++i) {
+		dbgassert(values[i] != NULL);
+	}
+
+	start = now();
+	cu_hm_at_many(&hm, lookups, NLOOKUPS, values);
+	double batched = now() - start;
+	for (uint64_t i = 0; i < NLOOKUPS; ++i) {
+		dbgassert(values[i] != NULL);
+	}
+
+	printf("cu_hm_at:      %7.2f ns/lookup\n", single * 1e9 / NLOOKUPS);
+	printf("cu_hm_at_many: %7.2f ns/lookup\n", batched * 1e9 / NLOOKUPS);
+	printf("speedup:       %7.2fx\n", single / batched);
+
+	cu_hm_free(&hm);
+	free(values);
+	free(lookups);
+	free(keys);
+	free(key_storage);
+}
@@ -0,0 +1,165 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+// Compares the chaining cu_hm_chain at several load factors against cu_hm,
+// with both of its layouts, for inserts, successful lookups and failed
+// lookups.
+//
+// Usage: bench_hashmap_chain [number of keys]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <cu/hashmap.h>
+#include <cu/hashmap_chain.h>
+#include <cu/dbgassert.h>
+
+#define DEFAULT_NKEYS (UINT64_C(1) << 20)
+#define NLOOKUPS (UINT64_C(1) << 22)
+#define KEY_LEN 32
+
+typedef struct {
+	cu_hm_chain_node node;
+	uint64_t id;
+} entry;
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t next_rand(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static uint64_t NKEYS;
+static cu_str *KEYS;
+static cu_str *HITS;
+static cu_str *MISSES;
+static entry *ENTRIES;
+
+static void report(const char *name, double insert, double hit, double miss,
+	double table_bytes)
+{
+	printf("%-16s %10.2f %10.2f %10.2f %10.2f\n", name,
+		insert * 1e9 / NKEYS, hit * 1e9 / NLOOKUPS,
+		miss * 1e9 / NLOOKUPS, table_bytes / NKEYS);
+}
+
+static void bench_hm(cu_hm_engine engine)
+{
+	cu_hm hm;
+	dbgassert(cu_hm_new_engine(&hm, NULL, CU_HM_SIPHASH13, engine) == 0);
+	double start = now();
+	for (uint64_t i = 0; i < NKEYS; ++i)
+		dbgassert(cu_hm_insert(&hm, KEYS[i], ENTRIES + i) == 0);
+	double insert = now() - start;
+
+	start = now();
+	for (uint64_t i = 0; i < NLOOKUPS; ++i)
+		dbgassert(cu_hm_at(&hm, HITS[i]) != NULL);
+	double hit = now() - start;
+	start = now();
+	for (uint64_t i = 0; i < NLOOKUPS; ++i)
+		dbgassert(cu_hm_at(&hm, MISSES[i]) == NULL);
+	double miss = now() - start;
+
+	// Swiss tables have a control byte per bucket on top
+	bool swiss = engine == CU_HM_SWISS;
+	char name[32];
+	snprintf(name, sizeof(name), "%s (%.2f)", swiss ? "swiss" : "cu_hm",
+		(double)hm.nel / hm.capacity);
+	report(name, insert, hit, miss,
+		(double)hm.capacity * (sizeof(cu_hm_bucket) + swiss));
+	cu_hm_free(&hm);
+}
+
+static void bench_chain(uint64_t max_load)
+{
+	cu_hm_chain hm;
+	dbgassert(cu_hm_chain_new(&hm, NULL) == 0);
+	cu_hm_chain_set_max_load(&hm, max_load);
+	double start = now();
+	for (uint64_t i = 0; i < NKEYS; ++i) {
+		cu_hm_chain_node *node = &ENTRIES[i].node;
+		dbgassert(cu_hm_chain_insert(&hm, node, KEYS[i]) == node);
+	}
+	double insert = now() - start;
+
+	start = now();
+	for (uint64_t i = 0; i < NLOOKUPS; ++i)
+		dbgassert(cu_hm_chain_at(&hm, HITS[i]) != NULL);
+	double hit = now() - start;
+	start = now();
+	for (uint64_t i = 0; i < NLOOKUPS; ++i)
+		dbgassert(cu_hm_chain_at(&hm, MISSES[i]) == NULL);
+	double miss = now() - start;
+
+	// the nodes live in the entries, but count them as part of the map
+	// to be fair to the open-addressing maps
+	char name[32];
+	snprintf(name, sizeof(name), "chain (%.2f)",
+		(double)hm.nel / hm.capacity);
+	report(name, insert, hit, miss,
+		(double)hm.capacity * sizeof(cu_slist)
+			+ (double)NKEYS * sizeof(cu_hm_chain_node));
+	cu_hm_chain_free(&hm);
+}
+
+int main(int argc, char **argv)
+{
+	NKEYS = DEFAULT_NKEYS;
+	if (argc > 1)
+		NKEYS = strtoull(argv[1], NULL, 10);
+	dbgassert(NKEYS > 0);
+
+	char *key_storage = malloc(2 * NKEYS * KEY_LEN);
+	cu_str *misses = malloc(NKEYS * sizeof(cu_str));
+	KEYS = malloc(NKEYS * sizeof(cu_str));
+	HITS = malloc(NLOOKUPS * sizeof(cu_str));
+	MISSES = malloc(NLOOKUPS * sizeof(cu_str));
+	ENTRIES = malloc(NKEYS * sizeof(entry));
+	dbgassert(key_storage != NULL && misses != NULL && KEYS != NULL);
+	dbgassert(HITS != NULL && MISSES != NULL && ENTRIES != NULL);
+
+	for (uint64_t i = 0; i < NKEYS; ++i) {
+		char *key = key_storage + i * KEY_LEN;
+		snprintf(key, KEY_LEN, "bench-key-%llu", (unsigned long long)i);
+		KEYS[i] = cu_str_from_cstr(key);
+		key += NKEYS * KEY_LEN;
+		snprintf(key, KEY_LEN, "missing-%llu", (unsigned long long)i);
+		misses[i] = cu_str_from_cstr(key);
+		ENTRIES[i].id = i;
+	}
+	uint64_t rng = UINT64_C(0x9E3779B97F4A7C15);
+	for (uint64_t i = 0; i < NLOOKUPS; ++i) {
+		HITS[i] = KEYS[next_rand(&rng) % NKEYS];
+		MISSES[i] = misses[next_rand(&rng) % NKEYS];
+	}
+
+	printf("%llu keys, %llu lookups, ns/op and bytes/key, "
+		"final load factor in parentheses\n",
+		(unsigned long long)NKEYS, (unsigned long long)NLOOKUPS);
+	printf("%-16s %10s %10s %10s %10s\n",
+		"map", "insert", "hit", "miss", "bytes/key");
+	bench_hm(CU_HM_LINEAR);
+	bench_hm(CU_HM_SWISS);
+	for (uint64_t max_load = 1; max_load <= 8; max_load *= 2)
+		bench_chain(max_load);
+
+	free(ENTRIES);
+	free(MISSES);
+	free(HITS);
+	free(KEYS);
+	free(misses);
+	free(key_storage);
+}
@@ -0,0 +1,144 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+// Compares cu_hm_cpy against cu_hm_compact, which keeps short keys in its
+// buckets, for short keys (which fit in a bucket) and long ones (which don't).
+//
+// Usage: bench_hashmap_compact [number of keys]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <cu/hashmap.h>
+#include <cu/hashmap_compact.h>
+#include <cu/dbgassert.h>
+
+#define DEFAULT_NKEYS (UINT64_C(1) << 20)
+#define NLOOKUPS (UINT64_C(1) << 22)
+#define KEY_LEN 40
+#define ARENA_BLOCKSIZE (1 << 20)
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t next_rand(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static uint64_t NKEYS;
+static cu_str *KEYS;
+static cu_str *HITS;
+static cu_str *MISSES;
+
+static void report(const char *name, double insert, double hit, double miss)
+{
+	printf("%-16s %10.2f %10.2f %10.2f\n", name, insert * 1e9 / NKEYS,
+		hit * 1e9 / NLOOKUPS, miss * 1e9 / NLOOKUPS);
+}
+
+static void bench_cpy(const char *name)
+{
+	cu_hm_cpy hm;
+	dbgassert(cu_hm_cpy_new(&hm, NULL, ARENA_BLOCKSIZE) == 0);
+	double start = now();
+	for (uint64_t i = 0; i < NKEYS; ++i)
+		dbgassert(cu_hm_cpy_insert(&hm, KEYS[i], KEYS + i) == 0);
+	double insert = now() - start;
+
+	start = now();
+	for (uint64_t i = 0; i < NLOOKUPS; ++i)
+		dbgassert(cu_hm_cpy_at(&hm, HITS[i]) != NULL);
+	double hit = now() - start;
+	start = now();
+	for (uint64_t i = 0; i < NLOOKUPS; ++i)
+		dbgassert(cu_hm_cpy_at(&hm, MISSES[i]) == NULL);
+	double miss = now() - start;
+	report(name, insert, hit, miss);
+	cu_hm_cpy_free(&hm);
+}
+
+static void bench_compact(const char *name)
+{
+	cu_hm_compact hm;
+	dbgassert(cu_hm_compact_new(&hm, NULL, ARENA_BLOCKSIZE) == 0);
+	double start = now();
+	for (uint64_t i = 0; i < NKEYS; ++i)
+		dbgassert(cu_hm_compact_insert(&hm, KEYS[i], KEYS + i) == 0);
+	double insert = now() - start;
+
+	start = now();
+	for (uint64_t i = 0; i < NLOOKUPS; ++i)
+		dbgassert(cu_hm_compact_at(&hm, HITS[i]) != NULL);
+	double hit = now() - start;
+	start = now();
+	for (uint64_t i = 0; i < NLOOKUPS; ++i)
+		dbgassert(cu_hm_compact_at(&hm, MISSES[i]) == NULL);
+	double miss = now() - start;
+	report(name, insert, hit, miss);
+	cu_hm_compact_free(&hm);
+}
+
+// Fills the key arrays with keys starting with `prefix`.
+static void make_keys(char *storage, cu_str *misses, const char *prefix)
+{
+	for (uint64_t i = 0; i < NKEYS; ++i) {
+		char *key = storage + i * KEY_LEN;
+		snprintf(key, KEY_LEN, "%s%llx", prefix, (unsigned long long)i);
+		KEYS[i] = cu_str_from_cstr(key);
+		key += NKEYS * KEY_LEN;
+		snprintf(key, KEY_LEN, "%s-%llx", prefix,
+			(unsigned long long)i);
+		misses[i] = cu_str_from_cstr(key);
+	}
+	uint64_t rng = UINT64_C(0x9E3779B97F4A7C15);
+	for (uint64_t i = 0; i < NLOOKUPS; ++i) {
+		HITS[i] = KEYS[next_rand(&rng) % NKEYS];
+		MISSES[i] = misses[next_rand(&rng) % NKEYS];
+	}
+}
+
+int main(int argc, char **argv)
+{
+	NKEYS = DEFAULT_NKEYS;
+	if (argc > 1)
+		NKEYS = strtoull(argv[1], NULL, 10);
+	dbgassert(NKEYS > 0);
+
+	char *key_storage = malloc(2 * NKEYS * KEY_LEN);
+	cu_str *misses = malloc(NKEYS * sizeof(cu_str));
+	KEYS = malloc(NKEYS * sizeof(cu_str));
+	HITS = malloc(NLOOKUPS * sizeof(cu_str));
+	MISSES = malloc(NLOOKUPS * sizeof(cu_str));
+	dbgassert(key_storage != NULL && misses != NULL && KEYS != NULL);
+	dbgassert(HITS != NULL && MISSES != NULL);
+
+	printf("%llu keys, %llu lookups, ns/op\n",
+		(unsigned long long)NKEYS, (unsigned long long)NLOOKUPS);
+	printf("%-16s %10s %10s %10s\n", "map", "insert", "hit", "miss");
+
+	// at most 15 bytes for up to 2^40 keys
+	make_keys(key_storage, misses, "key");
+	bench_cpy("cpy (short)");
+	bench_compact("compact (short)");
+
+	make_keys(key_storage, misses, "a-somewhat-longer-key-");
+	bench_cpy("cpy (long)");
+	bench_compact("compact (long)");
+
+	free(MISSES);
+	free(HITS);
+	free(KEYS);
+	free(misses);
+	free(key_storage);
+}
@@ -0,0 +1,125 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+// Measures how lookups in a cu_hm_sharded scale with the number of reader
+// threads, with and without a thread writing to the map at the same time.
+//
+// Usage: bench_hashmap_sharded [max threads]
+//
+// Scaling can't be any better than the number of cores the bench runs on.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <pthread.h>
+#include <cu/hashmap_sharded.h>
+#include <cu/dbgassert.h>
+
+#define NKEYS (UINT64_C(1) << 16)
+#define LOOKUPS_PER_THREAD (UINT64_C(1) << 21)
+#define KEY_LEN 32
+#define NSHARDS 64
+
+static char KEY_STORAGE[NKEYS][KEY_LEN];
+static cu_str KEYS[NKEYS];
+static cu_hm_sharded MAP;
+static atomic_bool STOP_WRITER;
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t next_rand(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static void *reader(void *arg)
+{
+	uint64_t rng = (uint64_t)(uintptr_t)arg * UINT64_C(0x9E3779B97F4A7C15)
+		+ 1;
+	for (uint64_t i = 0; i < LOOKUPS_PER_THREAD; ++i) {
+		cu_str key = KEYS[next_rand(&rng) % NKEYS];
+		dbgassert(cu_hm_sharded_at(&MAP, key) != NULL);
+	}
+	return NULL;
+}
+
+// keeps overwriting values, so readers contend with a writer
+static void *writer(void *arg)
+{
+	(void)arg;
+	uint64_t rng = 12345;
+	while (!atomic_load_explicit(&STOP_WRITER, memory_order_relaxed)) {
+		uint64_t i = next_rand(&rng) % NKEYS;
+		dbgassert(cu_hm_sharded_insert(&MAP, KEYS[i], KEY_STORAGE[i])
+			== 0);
+	}
+	return NULL;
+}
+
+// Returns the total lookups per second across `nthreads` readers.
+static double run(size_t nthreads, bool with_writer)
+{
+	pthread_t threads[64];
+	pthread_t writer_thread;
+	atomic_store(&STOP_WRITER, false);
+	if (with_writer)
+		dbgassert(pthread_create(&writer_thread, NULL, writer, NULL)
+			== 0);
+	double start = now();
+	for (size_t i = 0; i < nthreads; ++i) {
+		dbgassert(pthread_create(threads + i, NULL, reader,
+			(void *)(uintptr_t)i) == 0);
+	}
+	for (size_t i = 0; i < nthreads; ++i)
+		dbgassert(pthread_join(threads[i], NULL) == 0);
+	double elapsed = now() - start;
+	if (with_writer) {
+		atomic_store(&STOP_WRITER, true);
+		dbgassert(pthread_join(writer_thread, NULL) == 0);
+	}
+	return nthreads * LOOKUPS_PER_THREAD / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+	size_t max_threads = 8;
+	if (argc > 1)
+		max_threads = strtoull(argv[1], NULL, 10);
+	dbgassert(max_threads > 0 && max_threads <= 64);
+
+	dbgassert(cu_hm_sharded_new(&MAP, NSHARDS, NULL) == 0);
+	for (uint64_t i = 0; i < NKEYS; ++i) {
+		snprintf(KEY_STORAGE[i], KEY_LEN, "bench-key-%llu",
+			(unsigned long long)i);
+		KEYS[i] = cu_str_from_cstr(KEY_STORAGE[i]);
+		dbgassert(cu_hm_sharded_insert(&MAP, KEYS[i], KEY_STORAGE[i])
+			== 0);
+	}
+
+	printf("%d shards, %llu keys, Mlookups/s in total\n", NSHARDS,
+		(unsigned long long)NKEYS);
+	printf("%-8s %10s %10s %10s\n", "threads", "read-only", "scaling",
+		"1 writer");
+	double base = 0;
+	for (size_t n = 1; n <= max_threads; n *= 2) {
+		double read_only = run(n, false);
+		if (n == 1)
+			base = read_only;
+		double contended = run(n, true);
+		printf("%-8zu %10.2f %9.2fx %10.2f\n", n, read_only * 1e-6,
+			read_only / base, contended * 1e-6);
+	}
+	cu_hm_sharded_free(&MAP);
+}
@@ -0,0 +1,90 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+// Measures how fast cu_intern turns a stream of tokens into IDs, one at a
+// time and in batches, in tokens and bytes per second.
+//
+// Usage: bench_intern [number of distinct tokens]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <cu/intern.h>
+#include <cu/dbgassert.h>
+
+#define DEFAULT_NTOKENS (UINT64_C(1) << 16)
+#define STREAM_LEN (UINT64_C(1) << 23)
+#define TOKEN_LEN 16
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t next_rand(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static void report(const char *name, double seconds, uint64_t bytes)
+{
+	printf("%-8s %10.2f %10.2f %10.2f\n", name, seconds * 1e9 / STREAM_LEN,
+		STREAM_LEN / seconds * 1e-6, bytes / seconds * 1e-9);
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t ntokens = DEFAULT_NTOKENS;
+	if (argc > 1)
+		ntokens = strtoull(argv[1], NULL, 10);
+	dbgassert(ntokens > 0);
+
+	char *token_storage = malloc(ntokens * TOKEN_LEN);
+	cu_str *stream = malloc(STREAM_LEN * sizeof(cu_str));
+	uint32_t *ids = malloc(STREAM_LEN * sizeof(uint32_t));
+	dbgassert(token_storage != NULL && stream != NULL && ids != NULL);
+
+	uint64_t rng = UINT64_C(0x9E3779B97F4A7C15);
+	uint64_t bytes = 0;
+	for (uint64_t i = 0; i < ntokens; ++i) {
+		snprintf(token_storage + i * TOKEN_LEN, TOKEN_LEN, "tok%llx",
+			(unsigned long long)next_rand(&rng) % 0xFFFFFFFF);
+	}
+	for (uint64_t i = 0; i < STREAM_LEN; ++i) {
+		// roughly Zipfian, like words in a log
+		uint64_t r = next_rand(&rng) % ntokens;
+		uint64_t index = r * r / ntokens * r / ntokens;
+		stream[i] = cu_str_from_cstr(token_storage + index * TOKEN_LEN);
+		bytes += stream[i].len;
+	}
+
+	printf("%llu distinct tokens, stream of %llu\n",
+		(unsigned long long)ntokens, (unsigned long long)STREAM_LEN);
+	printf("%-8s %10s %10s %10s\n", "call", "ns/token", "Mtoken/s", "GB/s");
+
+	cu_intern table;
+	dbgassert(cu_intern_new(&table, NULL, 1 << 16) == 0);
+	double start = now();
+	for (uint64_t i = 0; i < STREAM_LEN; ++i)
+		dbgassert(cu_intern_str(&table, stream[i], ids + i) == 0);
+	report("single", now() - start, bytes);
+	cu_intern_free(&table);
+
+	dbgassert(cu_intern_new(&table, NULL, 1 << 16) == 0);
+	start = now();
+	dbgassert(cu_intern_many(&table, stream, STREAM_LEN, ids) == 0);
+	report("many", now() - start, bytes);
+	cu_intern_free(&table);
+
+	free(ids);
+	free(stream);
+	free(token_storage);
+}
@@ -0,0 +1,150 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+// Measures SipHash on short keys, hashing one key at a time and 4 or 8 keys
+// at once, and then on long messages, hashed all at once and streamed in
+// pieces.
+//
+// Usage: bench_siphash [min key length] [max key length]
+//
+// Every key length in the range (1 to 64 bytes by default) gets its own row,
+// and the "mixed" row has keys of random lengths spread over the range, for
+// comparing against a real key-length distribution.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <cu/siphash.h>
+#include <cu/dbgassert.h>
+
+// small enough to stay in cache, so it's the hashing that's measured
+#define NKEYS (UINT64_C(1) << 12)
+#define NROUNDS 256
+#define MAX_LEN 64
+// keys start at every offset within a word
+#define KEY_STRIDE (MAX_LEN + 9)
+#define LONG_LEN 4096
+#define PIECE_LEN 1000
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t next_rand(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static void bench_keys(const char *label, const cu_siphash_key *key,
+	const uint8_t **bufs, const size_t *sizes, uint64_t *hashes)
+{
+	double start = now();
+	for (size_t r = 0; r < NROUNDS; ++r) {
+		for (uint64_t i = 0; i < NKEYS; ++i)
+			hashes[i] = cu_siphash_hash(key, bufs[i], sizes[i]);
+	}
+	double single = now() - start;
+	uint64_t check = hashes[NKEYS - 1];
+
+	start = now();
+	for (size_t r = 0; r < NROUNDS; ++r) {
+		for (uint64_t i = 0; i < NKEYS; i += 4) {
+			cu_siphash_hash_x4(key, bufs + i, sizes + i,
+				hashes + i);
+		}
+	}
+	double x4 = now() - start;
+	dbgassert(hashes[NKEYS - 1] == check);
+
+	start = now();
+	for (size_t r = 0; r < NROUNDS; ++r) {
+		for (uint64_t i = 0; i < NKEYS; i += 8) {
+			cu_siphash_hash_x8(key, bufs + i, sizes + i,
+				hashes + i);
+		}
+	}
+	double x8 = now() - start;
+	dbgassert(hashes[NKEYS - 1] == check);
+
+	printf("%-6s %10.2f %10.2f %10.2f\n", label,
+		single * 1e9 / (NKEYS * NROUNDS),
+		x4 * 1e9 / (NKEYS * NROUNDS),
+		x8 * 1e9 / (NKEYS * NROUNDS));
+}
+
+int main(int argc, char **argv)
+{
+	size_t min_len = 1;
+	size_t max_len = MAX_LEN;
+	if (argc > 1)
+		min_len = strtoull(argv[1], NULL, 10);
+	if (argc > 2)
+		max_len = strtoull(argv[2], NULL, 10);
+	dbgassert(min_len <= max_len && max_len <= MAX_LEN);
+
+	cu_siphash_key key;
+	dbgassert(cu_siphash_init(&key) == 0);
+	uint8_t *storage = malloc(NKEYS * KEY_STRIDE + LONG_LEN);
+	const uint8_t **bufs = malloc(NKEYS * sizeof(uint8_t *));
+	size_t *sizes = malloc(NKEYS * sizeof(size_t));
+	uint64_t *hashes = malloc(NKEYS * sizeof(uint64_t));
+	dbgassert(storage != NULL && bufs != NULL && sizes != NULL
+		&& hashes != NULL);
+	for (uint64_t i = 0; i < NKEYS * KEY_STRIDE + LONG_LEN; ++i)
+		storage[i] = (uint8_t)(i * 2654435761u >> 13);
+	for (uint64_t i = 0; i < NKEYS; ++i)
+		bufs[i] = storage + i * KEY_STRIDE;
+
+	printf("%llu keys, ns/key\n",
+		(unsigned long long)(NKEYS * NROUNDS));
+	printf("%-6s %10s %10s %10s\n", "bytes", "single", "x4", "x8");
+	for (size_t len = min_len; len <= max_len; ++len) {
+		for (uint64_t i = 0; i < NKEYS; ++i)
+			sizes[i] = len;
+		char label[16];
+		snprintf(label, sizeof(label), "%zu", len);
+		bench_keys(label, &key, bufs, sizes, hashes);
+	}
+	uint64_t rng = UINT64_C(0x9E3779B97F4A7C15);
+	for (uint64_t i = 0; i < NKEYS; ++i)
+		sizes[i] = min_len + next_rand(&rng) % (max_len - min_len + 1);
+	bench_keys("mixed", &key, bufs, sizes, hashes);
+
+	// long messages, in GB/s
+	double start = now();
+	uint64_t hash = 0;
+	for (size_t r = 0; r < NROUNDS; ++r)
+		hash += cu_siphash_hash(&key, storage, LONG_LEN);
+	double whole = now() - start;
+	start = now();
+	uint64_t streamed = 0;
+	for (size_t r = 0; r < NROUNDS; ++r) {
+		cu_siphash_state state;
+		cu_siphash_state_init(&state, &key);
+		for (size_t i = 0; i < LONG_LEN; i += PIECE_LEN) {
+			size_t piece = LONG_LEN - i < PIECE_LEN
+				? LONG_LEN - i : PIECE_LEN;
+			cu_siphash_update(&state, storage + i, piece);
+		}
+		streamed += cu_siphash_final(&state);
+	}
+	double stream = now() - start;
+	dbgassert(hash == streamed);
+	printf("\n%d-byte messages, GB/s\n", LONG_LEN);
+	printf("%-8s %10.2f\n", "whole", LONG_LEN * NROUNDS / whole * 1e-9);
+	printf("%-8s %10.2f\n", "stream", LONG_LEN * NROUNDS / stream * 1e-9);
+
+	free(hashes);
+	free(sizes);
+	free(bufs);
+	free(storage);
+}
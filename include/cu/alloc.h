@@ -9,6 +9,7 @@
 
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <cu/bitmanip.h>
 
@@ -139,6 +140,29 @@ cu_freearray(
 	cu_free(mem, nel * elemsize, alloc);
 }
 
+// Allocates `memsize` bytes aligned to `align`, which must be a power of two,
+// by allocating `align - 1` extra bytes and rounding the pointer up.
+//
+// `*base` is set to the pointer that was actually allocated. Pass it to
+// cu_free_aligned, with the same size and alignment, to free the memory.
+static inline void *
+cu_malloc_aligned(size_t memsize, size_t align, void **base, cu_alloc *alloc)
+{
+	*base = cu_malloc(memsize + align - 1, alloc);
+	if (*base == NULL)
+		return NULL;
+	size_t misalignment = (uintptr_t)*base & (align - 1);
+	if (misalignment == 0)
+		return *base;
+	return (uint8_t *)*base + (align - misalignment);
+}
+
+static inline void
+cu_free_aligned(void *base, size_t memsize, size_t align, cu_alloc *alloc)
+{
+	cu_free(base, memsize + align - 1, alloc);
+}
+
 // realloc()'s an array of elements.
 //
 // This checks for integer overflow, similar to Linux's reallocarray(),
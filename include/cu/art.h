@@ -0,0 +1,92 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#ifndef CU_ART_H
+#define CU_ART_H
+
+#include <cu/string.h>
+#include <cu/arena.h>
+
+// An adaptive radix tree mapping strings to arbitrary values.
+//
+// Each node branches on one byte of the key and comes in four sizes, for up
+// to 4, 16, 48 or 256 children, so sparse nodes stay small and dense ones are
+// a single array lookup. Nodes move down a size again once most of their
+// children are erased. Runs of bytes with no branching are stored once per
+// node instead of as a chain of nodes. Finding the longest key that's a
+// prefix of some string, or every key starting with a prefix, only walks the
+// nodes along that string.
+//
+// Nodes with 16 children are searched with SSE2 where it's available.
+// Defining `CU_ART_NO_SIMD` forces the portable version.
+//
+// Keys are copied. Keys and nodes are allocated from an arena owned by the
+// tree. Nodes that are outgrown or erased are reused by later inserts, and
+// key copies are only freed with the whole tree.
+//
+// Like `cu_hm`, NULL values can't be told apart from missing keys.
+//
+// Any insertion or erasure invalidates iterators.
+
+#if (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64))\
+	&& !defined(CU_ART_NO_SIMD)
+#	define CU_ART_SSE2
+#endif
+
+typedef struct cu_art_node cu_art_node;
+
+typedef struct {
+	cu_art_node *root;
+	uint64_t nel;
+	cu_arena *arena;
+	cu_art_node *free_nodes[4]; // by node size
+} cu_art;
+
+typedef struct {
+	const cu_art_node *next;
+	const cu_art_node *root; // of the subtree being iterated over
+} cu_art_iter;
+
+// Returns 0 on success, -1 on failure.
+int cu_art_new(cu_art *tree, cu_alloc *alloc, size_t arena_blocksize);
+void cu_art_free(cu_art *tree);
+
+void *cu_art_at(const cu_art *tree, cu_str key);
+static inline bool cu_art_contains(const cu_art *tree, cu_str key)
+{
+	return cu_art_at(tree, key) != NULL;
+}
+
+// Maps `key` to `value`, replacing any value `key` already had.
+//
+// Returns 0 on success, -1 on failure, in which case the tree is unchanged.
+int cu_art_insert(cu_art *tree, cu_str key, void *value);
+
+// Removes `key` from the tree.
+//
+// Returns the value that was associated with `key`, or NULL if `key` wasn't
+// present.
+void *cu_art_erase(cu_art *tree, cu_str key);
+
+// Finds the longest key in the tree that `str` starts with, e.g. the most
+// specific route for a URL.
+//
+// Returns its value, or NULL if no key is a prefix of `str`. If `match !=
+// NULL`, the key is stored in `*match`.
+void *cu_art_longest_prefix(const cu_art *tree, cu_str str, cu_str *match);
+
+// Returns an iterator over every key in the tree, or every key starting with
+// `prefix`, in the order given by cu_str_cmp.
+cu_art_iter cu_art_begin(const cu_art *tree);
+cu_art_iter cu_art_prefix(const cu_art *tree, cu_str prefix);
+
+// Stores the next key and value in `*key` and `*value`, either of which can
+// be NULL, and moves past them.
+//
+// Returns false, without storing anything, once the iterator is done.
+bool cu_art_next(cu_art_iter *iter, cu_str *key, void **value);
+
+#endif // CU_ART_H
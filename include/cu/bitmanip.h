@@ -28,6 +28,50 @@ size_t cu_bit_ceil(size_t val);
 
 #endif // CU_HAVE_STDBIT
 
+// cu_trailing_zeros and cu_bit_width are analogous to stdc_trailing_zeros and
+// stdc_bit_width, except they only take uint64_t arguments
+#ifdef CU_HAVE_STDBIT
+
+#	define cu_trailing_zeros stdc_trailing_zeros
+#	define cu_bit_width stdc_bit_width
+
+#else
+
+// these are on the hashmaps' hot paths, so they're kept inline
+static inline unsigned cu_trailing_zeros(uint64_t val)
+{
+	if (val == 0)
+		return 64;
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(val);
+#else
+	unsigned count = 0;
+	while ((val & 1) == 0) {
+		val >>= 1;
+		++count;
+	}
+	return count;
+#endif
+}
+
+static inline unsigned cu_bit_width(uint64_t val)
+{
+	if (val == 0)
+		return 0;
+#if defined(__GNUC__) || defined(__clang__)
+	return 64 - __builtin_clzll(val);
+#else
+	unsigned count = 0;
+	while (val != 0) {
+		val >>= 1;
+		++count;
+	}
+	return count;
+#endif
+}
+
+#endif // CU_HAVE_STDBIT
+
 // cu_ckd_mul is identical to ckd_mul in C23, except RESULT cannot point to A
 // or B.
 #ifdef CU_HAVE_CKDINT
@@ -0,0 +1,112 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#ifndef CU_BTREE_H
+#define CU_BTREE_H
+
+#include <cu/string.h>
+#include <cu/arena.h>
+
+// An ordered map from strings to arbitrary values, ordered by cu_str_cmp.
+//
+// It's a B+ tree: every key and value is in a leaf, the leaves are linked in
+// order for range scans, and the inner nodes only route lookups. Every node
+// takes `node_size` bytes, so the fanout can be tuned to a multiple of the
+// cache line or page size. Each node also keeps the first 8 bytes of its keys
+// next to each other, so most comparisons during a search don't have to
+// follow the keys' pointers.
+//
+// Like `cu_hm`, keys aren't copied and NULL values can't be told apart from
+// missing keys. A key can be freed as soon as it's erased.
+//
+// Nodes come from `alloc`, which can be an arena (see cu_arena_cast). Arenas
+// never free anything, so cu_btree_free doesn't bother walking the tree if
+// `alloc` can't free memory.
+//
+// Any insertion or erasure invalidates iterators.
+
+#define CU_BTREE_DEFAULT_NODE_SIZE 512
+
+typedef struct cu_btree_node cu_btree_node;
+
+typedef struct {
+	cu_btree_node *root;
+	uint64_t nel;
+	uint32_t max_keys; // in any node, set by the node size
+	size_t node_size;
+	cu_alloc *alloc;
+} cu_btree;
+
+// Where an iterator stops, other than the end of the tree.
+enum cu_btree_bound {
+	CU_BTREE_UNBOUNDED,
+	CU_BTREE_BEFORE, // stops at the first key >= `bound`
+	CU_BTREE_PREFIX, // stops at the first key not starting with `bound`
+};
+
+typedef struct {
+	const cu_btree *tree;
+	const cu_btree_node *leaf;
+	uint32_t index;
+	enum cu_btree_bound bound_kind;
+	cu_str bound;
+} cu_btree_iter;
+
+// Creates an empty tree whose nodes each take `node_size` bytes.
+//
+// Returns 0 on success, or -1 if `node_size` is too small to hold 3 keys per
+// node.
+int cu_btree_new(cu_btree *tree, cu_alloc *alloc, size_t node_size);
+void cu_btree_free(cu_btree *tree);
+
+// Creates a tree holding `keys[i] -> values[i]` for every `i` below `n`.
+//
+// `keys` must be in strictly ascending order. The tree is built bottom-up,
+// which is much faster than inserting the keys one by one: each level's keys
+// are spread evenly over as few nodes as possible, so every node is at least
+// half full.
+//
+// Returns 0 on success. On failure, including if `keys` isn't sorted, -1 is
+// returned and nothing needs to be freed.
+int cu_btree_build(cu_btree *tree, cu_alloc *alloc, size_t node_size,
+	const cu_str *keys, void *const *values, size_t n);
+
+void *cu_btree_at(const cu_btree *tree, cu_str key);
+static inline bool cu_btree_contains(const cu_btree *tree, cu_str key)
+{
+	return cu_btree_at(tree, key) != NULL;
+}
+
+// Maps `key` to `value`, replacing any value `key` already had.
+//
+// Returns 0 on success, -1 on failure, in which case the tree is unchanged.
+int cu_btree_insert(cu_btree *tree, cu_str key, void *value);
+
+// Removes `key` from the tree.
+//
+// Returns the value that was associated with `key`, or NULL if `key` wasn't
+// present.
+void *cu_btree_erase(cu_btree *tree, cu_str key);
+
+// These return an iterator over, in order:
+// - every key
+// - every key >= `key`
+// - every key >= `lo` and < `hi`
+// - every key starting with `prefix`
+//
+// The strings passed in have to outlive the iterator.
+cu_btree_iter cu_btree_begin(const cu_btree *tree);
+cu_btree_iter cu_btree_lower_bound(const cu_btree *tree, cu_str key);
+cu_btree_iter cu_btree_range(const cu_btree *tree, cu_str lo, cu_str hi);
+cu_btree_iter cu_btree_prefix(const cu_btree *tree, cu_str prefix);
+
+// Stores the next key and value in `*key` and `*value`, either of which can
+// be NULL, and moves past them.
+//
+// Returns false, without storing anything, once the iterator is done.
+bool cu_btree_next(cu_btree_iter *iter, cu_str *key, void **value);
+
+#endif // CU_BTREE_H
@@ -15,9 +15,23 @@
 #include <cu/bitmanip.h>
 #include <cu/dbgassert.h>
 #include <cu/hashmap.h>
+#include <cu/hashmap_sharded.h>
+#include <cu/hashmap_rcu.h>
+#include <cu/hashmap_typed.h>
+#include <cu/hashmap_u64.h>
+#include <cu/hashmap_frozen.h>
+#include <cu/hashmap_view.h>
+#include <cu/hashmap_chain.h>
+#include <cu/hashset.h>
+#include <cu/hashmap_compact.h>
+#include <cu/keystore.h>
+#include <cu/intern.h>
+#include <cu/btree.h>
+#include <cu/art.h>
 #include <cu/list.h>
 #include <cu/rand.h>
 #include <cu/siphash.h>
+#include <cu/wyhash.h>
 #include <cu/string.h>
 
 #endif // CU_CU_H
@@ -9,25 +9,151 @@
 
 #include <cu/string.h>
 #include <cu/arena.h>
+#include <cu/keystore.h>
+#include <cu/wyhash.h>
 
 // This hashmap is primarily intended to map string keys to arbitrary values.
 // Other usecases are uncommon for me.
 
 // It's assumed that you'll store values in an arena or something.
-// It should be secure even for maliciously-chosen keys, and uses quadratic
-// probing.
+// It should be secure even for maliciously-chosen keys, and uses linear
+// probing by default.
+//
+// Erasing uses backward-shift deletion, so no tombstones are left behind and
+// lookups don't get slower as keys are inserted and erased over time.
+//
+// Maps can also be created with a Swiss table layout (CU_HM_SWISS below),
+// which every function here works with as well.
+//
+// Any insertion or erasure invalidates pointers to buckets and iterators.
 
+// How a map hashes its keys. Every map gets its own random key whichever
+// hash function it uses.
+typedef enum {
+	// SipHash-1-3, the default, and secure against maliciously-chosen
+	// keys
+	CU_HM_SIPHASH13 = 0,
+	// SipHash-2-4, with a wider security margin, but slower
+	CU_HM_SIPHASH24,
+	// wyhash, much faster on short keys, but only for maps whose keys
+	// attackers can't choose
+	CU_HM_WYHASH,
+} cu_hm_hasher;
+
+// How a map lays out its table.
+typedef enum {
+	// linear probing over the buckets, the default
+	CU_HM_LINEAR = 0,
+	// Laid out like Abseil's Swiss tables. Alongside the buckets there's an
+	// array of 1-byte control bytes, each holding 7 bits of its bucket's
+	// hash (or an empty/deleted marker). Probing loads a whole group of
+	// control bytes at once and compares them all against the key's hash
+	// tag, so most lookups touch one group of control bytes and a single
+	// bucket.
+	//
+	// Erased buckets are marked deleted until the next rehash instead of
+	// being shifted back, and resizes always happen all at once.
+	CU_HM_SWISS,
+} cu_hm_engine;
+
+// Swiss table groups are 16 bytes wide and matched with SSE2 where it's
+// available. Everywhere else, groups are 8 bytes wide and matched with plain
+// 64-bit integer ops. Defining `CU_HM_SWISS_NO_SIMD` forces the portable
+// version.
+#if (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64))\
+	&& !defined(CU_HM_SWISS_NO_SIMD)
+#	define CU_HM_SWISS_SSE2
+#	define CU_HM_SWISS_GROUP 16
+#else
+#	define CU_HM_SWISS_GROUP 8
+#endif
+
+// `hash` caches the hash of `key`, so resizing never rehashes and probes
+// can reject most non-matching keys without comparing them.
 typedef struct {
 	cu_str key;
 	void *value;
+	uint64_t hash;
 } cu_hm_bucket;
 
+// Number of old buckets moved by each insert or erase while an incremental
+// resize is in progress.
+//
+// A resize happens when the map is half full, and the next one happens after
+// about half as many inserts again. Draining the old table takes at most
+// 1.5x its capacity in steps, so anything above 3 steps per insert finishes
+// in time.
+#ifndef CU_HM_MIGRATE_STEPS
+#define CU_HM_MIGRATE_STEPS 8
+#endif
+
+#ifdef CU_HM_STATS
+
+// Instrumentation for tuning maps, only compiled in when CU_HM_STATS is
+// defined (the C_UTILS_HM_STATS CMake option).
+//
+// Lookups write to the map's stats when this is on, so a map must not be read
+// from several threads at once, which rules out cu_hm_rcu and the shared
+// locks of cu_hm_sharded.
+
+// Probes of the table, by lookups and by inserts looking for a free bucket,
+// are counted by probe length: the number of buckets looked at past a key's
+// home bucket. The last entry counts every longer probe. For CU_HM_SWISS
+// maps, it's the number of groups of control bytes looked at past the first.
+#define CU_HM_STATS_PROBE_LENGTHS 16
+
+typedef struct {
+	uint64_t old_capacity;
+	uint64_t new_capacity;
+	uint64_t nel;
+	uint64_t nanoseconds; // spent allocating and moving buckets
+	bool incremental; // old buckets are moved later, not counted above
+} cu_hm_resize_event;
+
+typedef struct {
+	uint64_t probe_lengths[CU_HM_STATS_PROBE_LENGTHS];
+	uint64_t total_probe_length;
+	uint64_t max_probe_length;
+	uint64_t probes;
+
+	uint64_t resizes;
+	uint64_t resize_nanoseconds;
+	uint64_t max_resize_nanoseconds;
+
+	uint64_t bytes_allocated; // by the tables, right now
+	uint64_t peak_bytes_allocated;
+
+	// called after every resize, if it isn't NULL
+	void (*on_resize)(const cu_hm_resize_event *event, void *ctx);
+	void *on_resize_ctx;
+} cu_hm_stats;
+
+#endif // CU_HM_STATS
+
 typedef struct {
 	cu_hm_bucket *arr;
 	uint64_t capacity;
-	uint64_t nel;
+	uint64_t nel; // includes elements still in `old_arr`
 	cu_alloc *alloc;
 	cu_siphash_key key;
+	cu_hm_hasher hasher;
+	cu_hm_engine engine;
+
+	// Only used by CU_HM_SWISS maps. `ctrl` has a control byte for every
+	// bucket, and `growth_left` is the number of empty buckets that can be
+	// filled before the table has to be rehashed.
+	uint8_t *ctrl;
+	uint64_t growth_left;
+
+	// Only used while an incremental resize is in progress.
+	// Everything before `migrate_pos` in the old table has been moved.
+	cu_hm_bucket *old_arr;
+	uint64_t old_capacity;
+	uint64_t migrate_pos;
+	bool incremental;
+#ifdef CU_HM_STATS
+	cu_hm_stats stats;
+#endif
 } cu_hm;
 
 typedef struct {
@@ -35,17 +161,149 @@ typedef struct {
 	uint64_t index;
 } cu_hm_iter;
 
+// Creates a map hashing its keys with SipHash-1-3.
 int cu_hm_new(cu_hm *map, cu_alloc *alloc);
+// Creates a map hashing its keys with `hasher`.
+int cu_hm_new_hasher(cu_hm *map, cu_alloc *alloc, cu_hm_hasher hasher);
+// Creates a map hashing its keys with `hasher`, laid out by `engine`.
+int cu_hm_new_engine(cu_hm *map, cu_alloc *alloc, cu_hm_hasher hasher,
+	cu_hm_engine engine);
 void cu_hm_free(cu_hm *map);
 
-void *cu_hm_at(cu_hm *map, cu_str key);
+// Makes `dst` an independent copy of `src`, using the same allocator, hash
+// function, layout and key. The keys themselves aren't copied, just the
+// buckets.
+//
+// Returns 0 on success, -1 on failure.
+int cu_hm_clone(cu_hm *dst, const cu_hm *src);
+
+#ifdef CU_HM_STATS
+// Clears the probe and resize counters. The allocation counts and the resize
+// callback are kept.
+void cu_hm_stats_reset(cu_hm *map);
+#endif
+
+// Turns incremental resizing on or off. It's off by default.
+//
+// Normally, an insert that grows the map moves every element into the new
+// table at once, which takes O(n) time.
+//
+// With incremental resizing on, the old and new tables are kept side by side
+// instead, and each following insert or erase moves a bounded number of old
+// buckets over. This bounds the time any single insert takes, at the cost of
+// lookups checking both tables until the move is done.
+//
+// Lookups don't move anything, so they never modify the map.
+//
+// cu_hm_reserve always finishes any resize in progress before starting a new
+// one. Turning incremental resizing off does the same.
+//
+// CU_HM_SWISS maps ignore this.
+void cu_hm_set_incremental(cu_hm *map, bool incremental);
+
+// Hashes `key` the way `map` does.
+//
+// The `*_hashed` functions below take a hash from this function instead of
+// hashing the key themselves, so a key that's used several times only has
+// to be hashed once. Maps get their own random keys, so a hash is only valid
+// for the map it came from.
+//
+// The hash function is picked with a switch rather than a function pointer,
+// so each case is a direct call, and the switch folds away wherever the
+// compiler can see which hasher the map was created with.
+static inline uint64_t cu_hm_hash(const cu_hm *map, cu_str key)
+{
+	switch (map->hasher) {
+	case CU_HM_SIPHASH24:
+		assert(key.buf != NULL && "Cannot hash a null string");
+		return cu_siphash24_hash(&map->key, key.buf, key.len);
+	case CU_HM_WYHASH:
+		assert(key.buf != NULL && "Cannot hash a null string");
+		return cu_wyhash(&map->key, key.buf, key.len);
+	default:
+		return cu_str_hash(key, &map->key);
+	}
+}
+
+void *cu_hm_at_hashed(cu_hm *map, cu_str key, uint64_t hash);
+static inline void *cu_hm_at(cu_hm *map, cu_str key)
+{
+	return cu_hm_at_hashed(map, key, cu_hm_hash(map, key));
+}
 static inline bool cu_hm_contains(cu_hm *map, cu_str key)
 {
 	return cu_hm_at(map, key) != NULL;
 }
-int cu_hm_insert(cu_hm *map, cu_str key, void *value);
+
+// Looks up `n` keys at once, storing the value for `keys[i]` (or NULL) in
+// `values[i]`.
+//
+// Keys are hashed and their buckets prefetched in batches before any of them
+// are compared, so for maps much larger than the CPU cache the memory
+// accesses for different keys overlap instead of happening one at a time.
+void cu_hm_at_many(cu_hm *map, const cu_str *keys, size_t n, void **values);
+
+int cu_hm_insert_hashed(cu_hm *map, cu_str key, uint64_t hash, void *value);
+static inline int cu_hm_insert(cu_hm *map, cu_str key, void *value)
+{
+	return cu_hm_insert_hashed(map, key, cu_hm_hash(map, key), value);
+}
+
+// Returns the bucket for `key`, inserting it with a NULL value if it isn't
+// in the map yet. `&bucket->value` can then be read and written directly,
+// so an upsert only has to probe the map once.
+//
+// If `inserted != NULL`, `*inserted` is set to whether the key was inserted.
+//
+// Returns NULL if the map had to grow and allocation failed.
+//
+// The returned bucket is invalidated by the next insertion or erasure.
+cu_hm_bucket *
+cu_hm_get_or_insert_hashed(cu_hm *map, cu_str key, uint64_t hash,
+	bool *inserted);
+static inline cu_hm_bucket *
+cu_hm_get_or_insert(cu_hm *map, cu_str key, bool *inserted)
+{
+	return cu_hm_get_or_insert_hashed(
+		map, key, cu_hm_hash(map, key), inserted);
+}
+
 int cu_hm_reserve(cu_hm *map, uint64_t nel);
 
+// Shrinks the table to the smallest size that fits the map's elements, or
+// frees it entirely if the map is empty. Finishes any resize in progress.
+//
+// Returns 0 on success, -1 on failure, in which case the map is unchanged.
+int cu_hm_shrink_to_fit(cu_hm *map);
+
+// Creates a map holding `keys[i] -> values[i]` for every `i` below `n`.
+//
+// The table is allocated once up front, so nothing gets resized or checked
+// for room while inserting. If a key appears more than once, its last value
+// is kept.
+//
+// Returns 0 on success. On failure, -1 is returned and the map still has to
+// be freed.
+int cu_hm_build(cu_hm *map, cu_alloc *alloc, const cu_str *keys,
+	void *const *values, size_t n);
+// Like cu_hm_build, but the map hashes its keys with `hasher`.
+int cu_hm_build_hasher(cu_hm *map, cu_alloc *alloc, const cu_str *keys,
+	void *const *values, size_t n, cu_hm_hasher hasher);
+// Like cu_hm_build_hasher, but the map is laid out by `engine`.
+int cu_hm_build_engine(cu_hm *map, cu_alloc *alloc, const cu_str *keys,
+	void *const *values, size_t n, cu_hm_hasher hasher,
+	cu_hm_engine engine);
+
+// Removes `key` from the map.
+//
+// Returns the value that was associated with `key`, or NULL if `key` wasn't
+// present.
+void *cu_hm_erase_hashed(cu_hm *map, cu_str key, uint64_t hash);
+static inline void *cu_hm_erase(cu_hm *map, cu_str key)
+{
+	return cu_hm_erase_hashed(map, key, cu_hm_hash(map, key));
+}
+
 static inline cu_hm_iter cu_hm_begin(cu_hm *map)
 {
 	return (cu_hm_iter){
@@ -57,26 +315,83 @@ static inline cu_hm_iter cu_hm_begin(cu_hm *map)
 cu_hm_bucket *cu_hm_next(cu_hm_iter *iter);
 
 // copies the keys of the hashmap
+//
+// The copies either go in the map's own arena, or in a `cu_keystore` shared
+// with other maps, which only stores each distinct key once.
 typedef struct {
 	cu_hm hm;
-	cu_arena *name_arena;
+	cu_arena *name_arena; // NULL if `keys` is used instead
+	cu_keystore *keys;
 } cu_hm_cpy;
 
 static inline int
-cu_hm_cpy_new(cu_hm_cpy *map, cu_alloc *alloc, size_t arena_blocksize)
+cu_hm_cpy_new_engine(cu_hm_cpy *map, cu_alloc *alloc, size_t arena_blocksize,
+	cu_hm_hasher hasher, cu_hm_engine engine)
 {
-	int retval = cu_hm_new(&map->hm, alloc);
+	int retval = cu_hm_new_engine(&map->hm, alloc, hasher, engine);
 	if (retval != 0)
 		return retval;
+	map->keys = NULL;
 	map->name_arena = cu_arena_new(arena_blocksize, alloc);
 	if (map->name_arena == NULL)
 		return -1;
 	return 0;
 }
+static inline int
+cu_hm_cpy_new_hasher(cu_hm_cpy *map, cu_alloc *alloc, size_t arena_blocksize,
+	cu_hm_hasher hasher)
+{
+	return cu_hm_cpy_new_engine(map, alloc, arena_blocksize, hasher,
+		CU_HM_LINEAR);
+}
+static inline int
+cu_hm_cpy_new(cu_hm_cpy *map, cu_alloc *alloc, size_t arena_blocksize)
+{
+	return cu_hm_cpy_new_hasher(map, alloc, arena_blocksize,
+		CU_HM_SIPHASH13);
+}
+
+// Creates a map that copies its keys into `keys` instead of its own arena.
+//
+// Every key in the map is then a handle from `keys`, so a lookup with a handle
+// matches the stored key without comparing any bytes. `keys` has to outlive
+// the map.
+static inline int
+cu_hm_cpy_new_shared_engine(cu_hm_cpy *map, cu_alloc *alloc,
+	cu_keystore *keys, cu_hm_hasher hasher, cu_hm_engine engine)
+{
+	map->name_arena = NULL;
+	map->keys = keys;
+	return cu_hm_new_engine(&map->hm, alloc, hasher, engine);
+}
+static inline int
+cu_hm_cpy_new_shared_hasher(cu_hm_cpy *map, cu_alloc *alloc,
+	cu_keystore *keys, cu_hm_hasher hasher)
+{
+	return cu_hm_cpy_new_shared_engine(map, alloc, keys, hasher,
+		CU_HM_LINEAR);
+}
+static inline int
+cu_hm_cpy_new_shared(cu_hm_cpy *map, cu_alloc *alloc, cu_keystore *keys)
+{
+	return cu_hm_cpy_new_shared_hasher(map, alloc, keys, CU_HM_SIPHASH13);
+}
+
+// Leaves a shared `cu_keystore` alone.
 static inline void cu_hm_cpy_free(cu_hm_cpy *map)
 {
 	cu_hm_free(&map->hm);
-	cu_arena_free(map->name_arena);
+	if (map->name_arena != NULL)
+		cu_arena_free(map->name_arena);
+}
+static inline uint64_t cu_hm_cpy_hash(const cu_hm_cpy *map, cu_str key)
+{
+	return cu_hm_hash(&map->hm, key);
+}
+static inline void *cu_hm_cpy_at_hashed(cu_hm_cpy *map, cu_str key,
+	uint64_t hash)
+{
+	return cu_hm_at_hashed(&map->hm, key, hash);
 }
 static inline void *cu_hm_cpy_at(cu_hm_cpy *map, cu_str key)
 {
@@ -86,20 +401,86 @@ static inline bool cu_hm_cpy_contains(cu_hm_cpy *map, cu_str key)
 {
 	return cu_hm_contains(&map->hm, key);
 }
-static inline int cu_hm_cpy_insert(cu_hm_cpy *map, cu_str key, void *value)
+static inline void
+cu_hm_cpy_at_many(cu_hm_cpy *map, const cu_str *keys, size_t n, void **values)
+{
+	cu_hm_at_many(&map->hm, keys, n, values);
+}
+// The key is only copied if it's actually inserted.
+static inline cu_hm_bucket *
+cu_hm_cpy_get_or_insert_hashed(cu_hm_cpy *map, cu_str key, uint64_t hash,
+	bool *inserted)
+{
+	bool is_new = false;
+	cu_hm_bucket *bucket =
+		cu_hm_get_or_insert_hashed(&map->hm, key, hash, &is_new);
+	if (inserted != NULL)
+		*inserted = is_new;
+	if (bucket == NULL || !is_new)
+		return bucket;
+
+	uint8_t *new_key;
+	if (map->keys != NULL) {
+		// doesn't copy anything if another map already has the key
+		new_key = cu_keystore_intern(map->keys, key).buf;
+	} else {
+		// allocating key separately
+		new_key = cu_arena_alloc(key.len, map->name_arena);
+		if (new_key != NULL)
+			memcpy(new_key, key.buf, key.len);
+	}
+	if (new_key == NULL) {
+		cu_hm_erase_hashed(&map->hm, key, hash);
+		return NULL;
+	}
+	bucket->key.buf = new_key;
+	return bucket;
+}
+static inline cu_hm_bucket *
+cu_hm_cpy_get_or_insert(cu_hm_cpy *map, cu_str key, bool *inserted)
+{
+	return cu_hm_cpy_get_or_insert_hashed(
+		map, key, cu_hm_cpy_hash(map, key), inserted);
+}
+static inline int cu_hm_cpy_insert_hashed(cu_hm_cpy *map, cu_str key,
+	uint64_t hash, void *value)
 {
-	// allocating key separately
-	uint8_t *new_key = cu_arena_alloc(key.len, map->name_arena);
-	if (new_key == NULL)
+	cu_hm_bucket *bucket =
+		cu_hm_cpy_get_or_insert_hashed(map, key, hash, NULL);
+	if (bucket == NULL)
 		return -1;
-	memcpy(new_key, key.buf, key.len);
-	key.buf = new_key;
-	return cu_hm_insert(&map->hm, key, value);
+	bucket->value = value;
+	return 0;
+}
+static inline int cu_hm_cpy_insert(cu_hm_cpy *map, cu_str key, void *value)
+{
+	return cu_hm_cpy_insert_hashed(
+		map, key, cu_hm_cpy_hash(map, key), value);
+}
+// The erased key's copy isn't freed until the whole map (or its shared
+// `cu_keystore`) is freed.
+static inline void *cu_hm_cpy_erase_hashed(cu_hm_cpy *map, cu_str key,
+	uint64_t hash)
+{
+	return cu_hm_erase_hashed(&map->hm, key, hash);
+}
+static inline void *cu_hm_cpy_erase(cu_hm_cpy *map, cu_str key)
+{
+	return cu_hm_erase(&map->hm, key);
 }
 static inline int cu_hm_cpy_reserve(cu_hm_cpy *map, uint64_t nel)
 {
 	return cu_hm_reserve(&map->hm, nel);
 }
+// Only shrinks the table, the key copies are kept until the map is freed.
+static inline int cu_hm_cpy_shrink_to_fit(cu_hm_cpy *map)
+{
+	return cu_hm_shrink_to_fit(&map->hm);
+}
+static inline void cu_hm_cpy_set_incremental(cu_hm_cpy *map, bool incremental)
+{
+	cu_hm_set_incremental(&map->hm, incremental);
+}
 static inline cu_hm_iter cu_hm_cpy_begin(cu_hm_cpy *map)
 {
 	return cu_hm_begin(&map->hm);
@@ -0,0 +1,136 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#ifndef CU_HASHMAP_CHAIN_H
+#define CU_HASHMAP_CHAIN_H
+
+#include <cu/hashmap.h>
+#include <cu/list.h>
+
+// An intrusive hashmap that resolves collisions by chaining.
+//
+// Instead of the map storing values, the values store the map's nodes: put a
+// `cu_hm_chain_node` in your struct, insert a pointer to it, and get back to
+// your struct from the nodes the map returns with `cu_container_of`. Each
+// bucket is a `cu_slist` of the nodes that hash to it.
+//
+// This means inserting never allocates anything except when the bucket array
+// grows, and nodes never move, so pointers to them stay valid until they're
+// erased. The price is a pointer chase for every node visited.
+//
+// Keys are hashed with SipHash, and the hash is cached in the node, so
+// growing the bucket array never rehashes a key. Like `cu_hm`, the bucket
+// array can be resized incrementally.
+//
+// Keys aren't copied, they must stay around until their node is erased.
+// Insertions and erasures invalidate iterators, but not nodes.
+
+typedef struct {
+	cu_slist link;
+	cu_str key;
+	uint64_t hash;
+} cu_hm_chain_node;
+
+typedef struct {
+	cu_slist *arr; // heads of each bucket's list
+	uint64_t capacity;
+	uint64_t nel;
+	uint64_t max_load;
+	cu_alloc *alloc;
+	cu_siphash_key key;
+
+	// Only used while an incremental resize is in progress.
+	// Every bucket before `migrate_pos` in the old array is empty.
+	cu_slist *old_arr;
+	uint64_t old_capacity;
+	uint64_t migrate_pos;
+	bool incremental;
+} cu_hm_chain;
+
+typedef struct {
+	cu_hm_chain *hmap;
+	uint64_t index;
+	cu_slist *pos;
+} cu_hm_chain_iter;
+
+// Allocates a small initial bucket array, so that inserting can't fail.
+//
+// Returns 0 on success, -1 on failure.
+int cu_hm_chain_new(cu_hm_chain *map, cu_alloc *alloc);
+
+// Frees the bucket array. The nodes belong to you, and aren't touched.
+void cu_hm_chain_free(cu_hm_chain *map);
+
+// Turns incremental resizing on or off, see cu_hm_set_incremental.
+void cu_hm_chain_set_incremental(cu_hm_chain *map, bool incremental);
+
+// Sets the average number of nodes per bucket that the map grows at. The
+// default is 1.
+//
+// Higher loads save memory at the cost of longer chains.
+void cu_hm_chain_set_max_load(cu_hm_chain *map, uint64_t max_load);
+
+static inline uint64_t cu_hm_chain_hash(const cu_hm_chain *map, cu_str key)
+{
+	return cu_str_hash(key, &map->key);
+}
+
+cu_hm_chain_node *
+cu_hm_chain_at_hashed(cu_hm_chain *map, cu_str key, uint64_t hash);
+static inline cu_hm_chain_node *cu_hm_chain_at(cu_hm_chain *map, cu_str key)
+{
+	return cu_hm_chain_at_hashed(map, key, cu_hm_chain_hash(map, key));
+}
+static inline bool cu_hm_chain_contains(cu_hm_chain *map, cu_str key)
+{
+	return cu_hm_chain_at(map, key) != NULL;
+}
+
+// Inserts `node` under `key`, unless `key` is already in the map.
+//
+// Returns the node that `key` maps to afterwards: `node` if it was inserted,
+// or the node that was already there, in which case `node` is left alone.
+//
+// Never fails. If the bucket array can't grow, chains just get longer.
+cu_hm_chain_node *cu_hm_chain_insert_hashed(cu_hm_chain *map,
+	cu_hm_chain_node *node, cu_str key, uint64_t hash);
+static inline cu_hm_chain_node *
+cu_hm_chain_insert(cu_hm_chain *map, cu_hm_chain_node *node, cu_str key)
+{
+	return cu_hm_chain_insert_hashed(
+		map, node, key, cu_hm_chain_hash(map, key));
+}
+
+// Makes sure that `nel` nodes fit without growing.
+//
+// Returns 0 on success, -1 on failure.
+int cu_hm_chain_reserve(cu_hm_chain *map, uint64_t nel);
+
+// Removes `key` from the map.
+//
+// Returns its node, or NULL if `key` wasn't present.
+cu_hm_chain_node *
+cu_hm_chain_erase_hashed(cu_hm_chain *map, cu_str key, uint64_t hash);
+static inline cu_hm_chain_node *
+cu_hm_chain_erase(cu_hm_chain *map, cu_str key)
+{
+	return cu_hm_chain_erase_hashed(map, key, cu_hm_chain_hash(map, key));
+}
+
+// Removes `node`, which must be in the map.
+void cu_hm_chain_erase_node(cu_hm_chain *map, cu_hm_chain_node *node);
+
+static inline cu_hm_chain_iter cu_hm_chain_begin(cu_hm_chain *map)
+{
+	return (cu_hm_chain_iter){
+		.hmap = map,
+		.index = 0,
+		.pos = NULL,
+	};
+}
+cu_hm_chain_node *cu_hm_chain_next(cu_hm_chain_iter *iter);
+
+#endif // CU_HASHMAP_CHAIN_H
@@ -0,0 +1,158 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#ifndef CU_HASHMAP_COMPACT_H
+#define CU_HASHMAP_COMPACT_H
+
+#include <cu/string.h>
+#include <cu/arena.h>
+
+// A key-copying map like `cu_hm_cpy`, but short keys are stored inside the
+// buckets instead of in the arena.
+//
+// Comparing a key in a `cu_hm_cpy` means following the bucket's pointer into
+// the arena, which is a second cache miss on top of the bucket itself. Here,
+// keys of up to CU_HM_COMPACT_INLINE bytes are kept in the bucket, so looking
+// them up only touches the bucket's cache line. Longer keys are copied to the
+// arena as usual.
+//
+// Otherwise this works like `cu_hm`: linear probing, backward-shift deletion
+// and a cached SipHash per bucket. There's no incremental resizing.
+//
+// Any insertion or erasure invalidates pointers to buckets, iterators, and
+// the strings returned by cu_hm_compact_key.
+
+#define CU_HM_COMPACT_INLINE 15
+
+// `tag` of a bucket whose key is in the arena
+#define CU_HM_COMPACT_SPILLED 0xFF
+
+typedef struct {
+	uint64_t hash;
+	void *value;
+	// A key of up to CU_HM_COMPACT_INLINE bytes is stored here directly,
+	// with `tag` set to its length plus one. Longer keys start with a
+	// pointer to their copy in the arena, and `tag` is
+	// CU_HM_COMPACT_SPILLED. Empty buckets have a `tag` of 0.
+	uint8_t key[CU_HM_COMPACT_INLINE];
+	uint8_t tag;
+} cu_hm_compact_bucket;
+
+// two buckets per cache line
+static_assert(sizeof(cu_hm_compact_bucket) == 32,
+	"cu_hm_compact_bucket has padding");
+
+typedef struct {
+	cu_hm_compact_bucket *arr;
+	uint64_t capacity;
+	uint64_t nel;
+	cu_alloc *alloc;
+	cu_siphash_key key;
+	cu_arena *name_arena; // only holds keys that don't fit in a bucket
+} cu_hm_compact;
+
+typedef struct {
+	cu_hm_compact *hmap;
+	uint64_t index;
+} cu_hm_compact_iter;
+
+// Returns 0 on success, -1 on failure.
+int cu_hm_compact_new(cu_hm_compact *map, cu_alloc *alloc,
+	size_t arena_blocksize);
+void cu_hm_compact_free(cu_hm_compact *map);
+
+// The key stored in `bucket`. For short keys, this points into the bucket.
+static inline cu_str cu_hm_compact_key(const cu_hm_compact_bucket *bucket)
+{
+	assert(bucket->tag != 0 && "Bucket is empty");
+	if (bucket->tag != CU_HM_COMPACT_SPILLED) {
+		return (cu_str){
+			.buf = (uint8_t *)bucket->key,
+			.len = bucket->tag - 1,
+		};
+	}
+	// the copy is prefixed with its length
+	uint8_t *copy;
+	size_t len;
+	memcpy(&copy, bucket->key, sizeof(copy));
+	memcpy(&len, copy, sizeof(len));
+	return (cu_str){
+		.buf = copy + sizeof(size_t),
+		.len = len,
+	};
+}
+
+static inline uint64_t cu_hm_compact_hash(const cu_hm_compact *map, cu_str key)
+{
+	return cu_str_hash(key, &map->key);
+}
+
+void *cu_hm_compact_at_hashed(cu_hm_compact *map, cu_str key, uint64_t hash);
+static inline void *cu_hm_compact_at(cu_hm_compact *map, cu_str key)
+{
+	return cu_hm_compact_at_hashed(map, key, cu_hm_compact_hash(map, key));
+}
+
+static inline bool cu_hm_compact_contains(cu_hm_compact *map, cu_str key)
+{
+	return cu_hm_compact_at(map, key) != NULL;
+}
+
+// Works like cu_hm_get_or_insert. The key is only copied if it's inserted.
+//
+// Returns NULL if the map had to grow or a long key had to be copied, and
+// allocation failed.
+cu_hm_compact_bucket *
+cu_hm_compact_get_or_insert_hashed(cu_hm_compact *map, cu_str key,
+	uint64_t hash, bool *inserted);
+static inline cu_hm_compact_bucket *
+cu_hm_compact_get_or_insert(cu_hm_compact *map, cu_str key, bool *inserted)
+{
+	return cu_hm_compact_get_or_insert_hashed(
+		map, key, cu_hm_compact_hash(map, key), inserted);
+}
+
+static inline int cu_hm_compact_insert_hashed(cu_hm_compact *map, cu_str key,
+	uint64_t hash, void *value)
+{
+	cu_hm_compact_bucket *bucket =
+		cu_hm_compact_get_or_insert_hashed(map, key, hash, NULL);
+	if (bucket == NULL)
+		return -1;
+	bucket->value = value;
+	return 0;
+}
+static inline int
+cu_hm_compact_insert(cu_hm_compact *map, cu_str key, void *value)
+{
+	return cu_hm_compact_insert_hashed(
+		map, key, cu_hm_compact_hash(map, key), value);
+}
+
+int cu_hm_compact_reserve(cu_hm_compact *map, uint64_t nel);
+
+// Removes `key` from the map.
+//
+// Returns the value that was associated with `key`, or NULL if `key` wasn't
+// present. The copy of a long key isn't freed until the whole map is freed.
+void *
+cu_hm_compact_erase_hashed(cu_hm_compact *map, cu_str key, uint64_t hash);
+static inline void *cu_hm_compact_erase(cu_hm_compact *map, cu_str key)
+{
+	return cu_hm_compact_erase_hashed(
+		map, key, cu_hm_compact_hash(map, key));
+}
+
+static inline cu_hm_compact_iter cu_hm_compact_begin(cu_hm_compact *map)
+{
+	return (cu_hm_compact_iter){
+		.hmap = map,
+		.index = 0,
+	};
+}
+cu_hm_compact_bucket *cu_hm_compact_next(cu_hm_compact_iter *iter);
+
+#endif // CU_HASHMAP_COMPACT_H
@@ -0,0 +1,117 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#ifndef CU_HASHMAP_FROZEN_H
+#define CU_HASHMAP_FROZEN_H
+
+#include <cu/hashmap.h>
+#include <cu/hashmap_typed.h>
+
+// An immutable hashmap built from a `cu_hm` with a minimal perfect hash.
+//
+// Meant for tables that are filled once and then only read, like keyword
+// tables. The map has exactly one bucket per key and no empty buckets, and
+// every lookup looks at exactly one bucket.
+//
+// Keys are split into small groups by their hash, and each group gets a
+// "pilot" number chosen so that all the keys in the group land in buckets
+// no other key uses (hash-and-displace, as in CHD and PTHash). A lookup
+// hashes the key, reads its group's pilot, and goes straight to the bucket.
+// The pilots add a little over a byte per key on top of the buckets.
+//
+// Keys that aren't in the map still land in some bucket, and are rejected by
+// comparing against the key stored there.
+
+typedef struct {
+	cu_hm_bucket *arr; // exactly `nel` buckets, all of them full
+	uint32_t *pilots;
+	uint64_t nel;
+	uint64_t ngroups;
+	cu_alloc *alloc;
+	cu_siphash_key key;
+} cu_hm_frozen;
+
+typedef struct {
+	const cu_hm_frozen *hmap;
+	uint64_t index;
+} cu_hm_frozen_iter;
+
+// Maps a 32-bit value onto [0, range) without a division.
+static inline uint64_t cu_hm_frozen_reduce(uint32_t val, uint64_t range)
+{
+	return ((uint64_t)val * range) >> 32;
+}
+
+// The group that a key with this hash is in.
+//
+// Groups are deliberately uneven, as in PTHash: 60% of the keys go into the
+// first 30% of the groups. The big groups get placed while the table is still
+// mostly empty, leaving mostly small groups for when it's nearly full.
+static inline uint64_t cu_hm_frozen_group(uint64_t hash, uint64_t ngroups)
+{
+	uint64_t ndense = ngroups * 3 / 10;
+	uint32_t where = (uint32_t)(hash >> 32);
+	if (ndense == 0)
+		return cu_hm_frozen_reduce(where, ngroups);
+	if ((uint32_t)hash < UINT32_C(0x9999999A))
+		return cu_hm_frozen_reduce(where, ndense);
+	return ndense + cu_hm_frozen_reduce(where, ngroups - ndense);
+}
+
+// The bucket that a key with this hash is in, given its group's pilot.
+static inline uint64_t
+cu_hm_frozen_position(uint64_t hash, uint32_t pilot, uint64_t nel)
+{
+	uint64_t seed = (uint64_t)pilot * UINT64_C(0x9E3779B97F4A7C15);
+	return cu_hm_frozen_reduce(
+		(uint32_t)(cu_hm_mix64(hash, seed) >> 32), nel);
+}
+
+// Builds a frozen copy of `map`, allocated with `map`'s allocator.
+//
+// Keys aren't copied, `frozen` points to the same key storage as `map`. `map`
+// itself can be freed afterwards, as long as its keys stay around. To freeze
+// a `cu_hm_cpy`, freeze its `hm` and keep its `name_arena` until the frozen
+// map is freed.
+//
+// Building takes O(n log n) expected time, and reuses the hashes cached in
+// `map`.
+//
+// Returns 0 on success, -1 on failure.
+int cu_hm_freeze(cu_hm_frozen *frozen, const cu_hm *map);
+void cu_hm_frozen_free(cu_hm_frozen *frozen);
+
+static inline uint64_t cu_hm_frozen_hash(const cu_hm_frozen *map, cu_str key)
+{
+	return cu_str_hash(key, &map->key);
+}
+
+void *cu_hm_frozen_at_hashed(const cu_hm_frozen *map, cu_str key,
+	uint64_t hash);
+static inline void *cu_hm_frozen_at(const cu_hm_frozen *map, cu_str key)
+{
+	return cu_hm_frozen_at_hashed(map, key, cu_hm_frozen_hash(map, key));
+}
+static inline bool cu_hm_frozen_contains(const cu_hm_frozen *map, cu_str key)
+{
+	return cu_hm_frozen_at(map, key) != NULL;
+}
+
+static inline cu_hm_frozen_iter cu_hm_frozen_begin(const cu_hm_frozen *map)
+{
+	return (cu_hm_frozen_iter){
+		.hmap = map,
+		.index = 0,
+	};
+}
+static inline const cu_hm_bucket *cu_hm_frozen_next(cu_hm_frozen_iter *iter)
+{
+	if (iter->index >= iter->hmap->nel)
+		return NULL;
+	return iter->hmap->arr + iter->index++;
+}
+
+#endif // CU_HASHMAP_FROZEN_H
@@ -0,0 +1,87 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#ifndef CU_HASHMAP_RCU_H
+#define CU_HASHMAP_RCU_H
+
+#include <cu/hashmap.h>
+
+// A read-mostly `cu_hm` whose readers never lock or wait.
+//
+// Readers look keys up in an immutable snapshot of the map. Writers never
+// modify a snapshot; they build a new `cu_hm` and publish it by swapping a
+// pointer. Old snapshots are freed once no reader can still be using them.
+//
+// Each reader thread registers once to get its own `cu_hm_rcu_reader`. While
+// reading, a reader announces which epoch it started reading in with a plain
+// atomic store to its own cache line. Readers never do atomic
+// read-modify-writes and never wait on writers.
+//
+// Only one thread may write at a time, the writer side has no locking of its
+// own. Every write copies the whole map, so this is meant for maps that are
+// read constantly and rebuilt rarely.
+
+typedef struct cu_hm_rcu cu_hm_rcu;
+typedef struct cu_hm_rcu_reader cu_hm_rcu_reader;
+
+// Creates an empty map that at most `max_readers` threads can read at once.
+//
+// Returns NULL on failure.
+cu_hm_rcu *cu_hm_rcu_new(size_t max_readers, cu_alloc *alloc);
+
+// Must not be called while any reader is registered.
+void cu_hm_rcu_free(cu_hm_rcu *map);
+
+// Claims a reader slot for the calling thread.
+//
+// Returns NULL if all `max_readers` slots are taken.
+cu_hm_rcu_reader *cu_hm_rcu_register(cu_hm_rcu *map);
+void cu_hm_rcu_unregister(cu_hm_rcu_reader *reader);
+
+// Starts reading, returning the current snapshot of the map.
+//
+// The snapshot stays valid until cu_hm_rcu_read_unlock is called. It must
+// only be read from, with cu_hm_at, cu_hm_at_many, cu_hm_next and friends.
+cu_hm *cu_hm_rcu_read_lock(cu_hm_rcu_reader *reader);
+void cu_hm_rcu_read_unlock(cu_hm_rcu_reader *reader);
+
+// Looks `key` up in the current snapshot.
+void *cu_hm_rcu_at(cu_hm_rcu_reader *reader, cu_str key);
+
+// Writer functions
+
+// Makes `out` a private copy of the current snapshot, for the writer to
+// modify and publish.
+//
+// Returns 0 on success, -1 on failure.
+int cu_hm_rcu_clone(cu_hm_rcu *map, cu_hm *out);
+
+// Publishes `table` as the new snapshot, taking ownership of it.
+//
+// `table` must have been created with the same allocator as the map. The old
+// snapshot is freed once every reader has moved past it; snapshots that
+// readers are still using stay queued until a later publish or
+// cu_hm_rcu_synchronize.
+//
+// Returns 0 on success. On failure, -1 is returned and `table` isn't
+// published, and the caller still owns it.
+int cu_hm_rcu_publish(cu_hm_rcu *map, cu_hm *table);
+
+// Waits until every old snapshot has been freed.
+void cu_hm_rcu_synchronize(cu_hm_rcu *map);
+
+// Copies the map, inserts `key`, and publishes the copy.
+//
+// Returns 0 on success, -1 on failure.
+int cu_hm_rcu_insert(cu_hm_rcu *map, cu_str key, void *value);
+
+// Copies the map, erases `key`, and publishes the copy.
+//
+// Returns the value that was associated with `key`, or NULL if `key` wasn't
+// present or the copy couldn't be made.
+void *cu_hm_rcu_erase(cu_hm_rcu *map, cu_str key);
+
+#endif // CU_HASHMAP_RCU_H
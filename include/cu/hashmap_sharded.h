@@ -0,0 +1,96 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#ifndef CU_HASHMAP_SHARDED_H
+#define CU_HASHMAP_SHARDED_H
+
+#include <cu/hashmap.h>
+
+// A thread-safe hashmap, split into several independently-locked `cu_hm`s.
+//
+// Keys are assigned to shards by the high bits of their SipHash, and each
+// shard is protected by its own reader/writer lock. Lookups only take a
+// shard's lock for reading, so readers never block each other, and writers
+// only block the one shard they're writing to. Each shard resizes on its own.
+//
+// Lookups only hand out values, never buckets, since a bucket can be moved by
+// another thread as soon as its shard is unlocked. Iterating is the exception:
+// its buckets are only valid while the iterator holds their shard's lock.
+
+struct cu_hm_shard;
+
+typedef struct {
+	struct cu_hm_shard *shards;
+	void *shards_base; // the allocation `shards` is aligned within
+	uint64_t nshards;
+	unsigned shard_bits; // log2(nshards)
+	cu_alloc *alloc;
+	cu_siphash_key key;
+} cu_hm_sharded;
+
+// Holds the read lock of the shard it's currently in.
+typedef struct {
+	cu_hm_sharded *hmap;
+	uint64_t shard;
+	cu_hm_iter inner;
+	bool locked;
+} cu_hm_sharded_iter;
+
+// `nshards` gets rounded up to a power of two. A few times the number of
+// threads using the map is usually plenty.
+//
+// Returns 0 on success, -1 on failure.
+int cu_hm_sharded_new(cu_hm_sharded *map, uint64_t nshards, cu_alloc *alloc);
+
+// Must not be called while any other thread is using the map.
+void cu_hm_sharded_free(cu_hm_sharded *map);
+
+static inline uint64_t
+cu_hm_sharded_hash(const cu_hm_sharded *map, cu_str key)
+{
+	return cu_str_hash(key, &map->key);
+}
+
+void *cu_hm_sharded_at(cu_hm_sharded *map, cu_str key);
+static inline bool cu_hm_sharded_contains(cu_hm_sharded *map, cu_str key)
+{
+	return cu_hm_sharded_at(map, key) != NULL;
+}
+int cu_hm_sharded_insert(cu_hm_sharded *map, cu_str key, void *value);
+
+// Removes `key` from the map.
+//
+// Returns the value that was associated with `key`, or NULL if `key` wasn't
+// present.
+void *cu_hm_sharded_erase(cu_hm_sharded *map, cu_str key);
+
+// Reserves room for `nel` elements spread evenly across the shards.
+int cu_hm_sharded_reserve(cu_hm_sharded *map, uint64_t nel);
+
+// The number of elements in the map.
+//
+// Shards are counted one at a time, so this is only a snapshot if other
+// threads are writing to the map.
+uint64_t cu_hm_sharded_size(cu_hm_sharded *map);
+
+// Iterates over the map one shard at a time, holding each shard's read lock
+// while its buckets are being visited.
+//
+// Don't write to the map from the iterating thread, or it will deadlock.
+// If you stop iterating before cu_hm_sharded_next returns NULL, call
+// cu_hm_sharded_end to release the lock.
+static inline cu_hm_sharded_iter cu_hm_sharded_begin(cu_hm_sharded *map)
+{
+	return (cu_hm_sharded_iter){
+		.hmap = map,
+		.shard = 0,
+		.locked = false,
+	};
+}
+cu_hm_bucket *cu_hm_sharded_next(cu_hm_sharded_iter *iter);
+void cu_hm_sharded_end(cu_hm_sharded_iter *iter);
+
+#endif // CU_HASHMAP_SHARDED_H
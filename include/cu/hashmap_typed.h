@@ -0,0 +1,310 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#ifndef CU_HASHMAP_TYPED_H
+#define CU_HASHMAP_TYPED_H
+
+#include <cu/alloc.h>
+#include <cu/bitmanip.h>
+#include <cu/siphash.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Hashmaps keyed by a fixed-size type, generated by macros.
+//
+// Keys are stored inline in the buckets and compared with a memcmp of a
+// constant size, which compilers turn into plain integer comparisons for
+// small keys. A bucket is just a key and a value, so a map keyed by
+// `uint64_t` has buckets half the size of a `cu_hm_bucket`.
+//
+// Keys are compared and hashed byte-by-byte, so key types must not have any
+// padding bytes.
+//
+// The map uses linear probing and backward-shift deletion like `cu_hm`, but
+// since it doesn't cache hashes, resizing and erasing rehash the keys they
+// move. Empty buckets are marked with an all-zero key, and the all-zero key
+// itself is kept in a bucket of its own outside the table.
+//
+// Any insertion or erasure invalidates pointers to buckets and iterators.
+//
+// To make a map, put CU_HM_TYPED_DECLARE(name, key_type) in a header and
+// CU_HM_TYPED_DEFINE(name, key_type) in exactly one source file. This defines
+// `name`, `name##_bucket` and `name##_iter`, along with functions like
+// `name##_new` and `name##_insert`. See `cu_hm_u64` for an example.
+
+// How a typed map hashes its keys.
+typedef enum {
+	// Keyed SipHash over the key's bytes. Safe to use with keys that an
+	// attacker can choose.
+	CU_HM_FIXED_SIPHASH,
+	// A fast multiplicative mixer. It's seeded randomly, but isn't a
+	// cryptographic hash, so someone who can choose keys can force
+	// collisions. Only use it when keys can't be attacker-controlled.
+	CU_HM_FIXED_MIX,
+} cu_hm_fixed_hash;
+
+// Finalizer with good avalanche behaviour in all bits, including the low ones
+// that pick the bucket.
+static inline uint64_t cu_hm_mix64(uint64_t val, uint64_t seed)
+{
+	val ^= seed;
+	val ^= val >> 32;
+	val *= UINT64_C(0xD6E8FEB86659FD93);
+	val ^= val >> 32;
+	val *= UINT64_C(0xD6E8FEB86659FD93);
+	val ^= val >> 32;
+	return val;
+}
+
+static inline uint64_t cu_hm_fixed_hash_bytes(
+	const void *key_bytes,
+	size_t size,
+	const cu_siphash_key *key,
+	cu_hm_fixed_hash kind
+) {
+	if (kind == CU_HM_FIXED_SIPHASH)
+		return cu_siphash_hash(key, key_bytes, size);
+
+	const uint8_t *buf = key_bytes;
+	uint64_t hash = key->key[1] ^ size;
+	for (; size >= 8; size -= 8, buf += 8) {
+		uint64_t word;
+		memcpy(&word, buf, 8);
+		hash = cu_hm_mix64(hash ^ word, key->key[0]);
+	}
+	if (size != 0) {
+		uint64_t word = 0;
+		memcpy(&word, buf, size);
+		hash = cu_hm_mix64(hash ^ word, key->key[0]);
+	}
+	return hash;
+}
+
+#define CU_HM_TYPED_DECLARE(NAME, KEY_TYPE)\
+	typedef struct {\
+		KEY_TYPE key;\
+		void *value;\
+	} NAME##_bucket;\
+	\
+	typedef struct {\
+		NAME##_bucket *arr;\
+		uint64_t capacity;\
+		uint64_t nel; /* includes the zero key */\
+		cu_alloc *alloc;\
+		cu_siphash_key key;\
+		cu_hm_fixed_hash hash_kind;\
+		/* the all-zero key marks empty buckets, so it lives here */\
+		NAME##_bucket zero;\
+		bool has_zero;\
+	} NAME;\
+	\
+	typedef struct {\
+		NAME *hmap;\
+		uint64_t index;\
+	} NAME##_iter;\
+	\
+	/* Returns 0 on success, -1 on failure. */\
+	int NAME##_new(NAME *map, cu_alloc *alloc, cu_hm_fixed_hash hash_kind);\
+	void NAME##_free(NAME *map);\
+	uint64_t NAME##_hash(const NAME *map, KEY_TYPE key);\
+	void *NAME##_at(NAME *map, KEY_TYPE key);\
+	bool NAME##_contains(NAME *map, KEY_TYPE key);\
+	/* Returns the bucket for `key`, inserting it with a NULL value if */\
+	/* it isn't in the map yet. Returns NULL on allocation failure. */\
+	NAME##_bucket *\
+	NAME##_get_or_insert(NAME *map, KEY_TYPE key, bool *inserted);\
+	int NAME##_insert(NAME *map, KEY_TYPE key, void *value);\
+	int NAME##_reserve(NAME *map, uint64_t nel);\
+	/* Returns the value that was associated with `key`, or NULL. */\
+	void *NAME##_erase(NAME *map, KEY_TYPE key);\
+	NAME##_iter NAME##_begin(NAME *map);\
+	NAME##_bucket *NAME##_next(NAME##_iter *iter);
+
+#define CU_HM_TYPED_DEFINE(NAME, KEY_TYPE)\
+	static inline bool NAME##_key_eq(const KEY_TYPE *a, const KEY_TYPE *b)\
+	{\
+		return memcmp(a, b, sizeof(KEY_TYPE)) == 0;\
+	}\
+	static inline bool NAME##_key_is_zero(const KEY_TYPE *key)\
+	{\
+		static const KEY_TYPE zero;\
+		return NAME##_key_eq(key, &zero);\
+	}\
+	\
+	int NAME##_new(NAME *map, cu_alloc *alloc, cu_hm_fixed_hash hash_kind)\
+	{\
+		map->arr = NULL;\
+		map->capacity = 0;\
+		map->nel = 0;\
+		map->alloc = alloc;\
+		map->hash_kind = hash_kind;\
+		map->has_zero = false;\
+		return cu_siphash_init(&map->key);\
+	}\
+	\
+	void NAME##_free(NAME *map)\
+	{\
+		cu_freearray(map->arr, map->capacity, sizeof(NAME##_bucket),\
+			map->alloc);\
+	}\
+	\
+	uint64_t NAME##_hash(const NAME *map, KEY_TYPE key)\
+	{\
+		return cu_hm_fixed_hash_bytes(&key, sizeof(KEY_TYPE),\
+			&map->key, map->hash_kind);\
+	}\
+	\
+	/* Finds the bucket holding a nonzero `key`, or the empty bucket */\
+	/* where it would go. */\
+	static NAME##_bucket *\
+	NAME##_find_bucket(NAME *map, const KEY_TYPE *key)\
+	{\
+		uint64_t mask = map->capacity - 1;\
+		uint64_t index = NAME##_hash(map, *key) & mask;\
+		for (;; index = (index + 1) & mask) {\
+			NAME##_bucket *bucket = map->arr + index;\
+			if (NAME##_key_is_zero(&bucket->key)\
+				|| NAME##_key_eq(&bucket->key, key))\
+				return bucket;\
+		}\
+	}\
+	\
+	static NAME##_bucket *NAME##_lookup(NAME *map, const KEY_TYPE *key)\
+	{\
+		if (NAME##_key_is_zero(key))\
+			return map->has_zero ? &map->zero : NULL;\
+		if (map->capacity == 0)\
+			return NULL;\
+		NAME##_bucket *bucket = NAME##_find_bucket(map, key);\
+		return NAME##_key_is_zero(&bucket->key) ? NULL : bucket;\
+	}\
+	\
+	void *NAME##_at(NAME *map, KEY_TYPE key)\
+	{\
+		NAME##_bucket *bucket = NAME##_lookup(map, &key);\
+		return bucket == NULL ? NULL : bucket->value;\
+	}\
+	\
+	bool NAME##_contains(NAME *map, KEY_TYPE key)\
+	{\
+		return NAME##_lookup(map, &key) != NULL;\
+	}\
+	\
+	int NAME##_reserve(NAME *map, uint64_t nel)\
+	{\
+		if (nel <= map->capacity / 2)\
+			return 0;\
+		uint64_t new_capacity = cu_bit_ceil(nel * 2);\
+		if (new_capacity < 16)\
+			new_capacity = 16;\
+		NAME##_bucket *new_arr = cu_allocarray(new_capacity,\
+			sizeof(NAME##_bucket), map->alloc);\
+		if (new_arr == NULL)\
+			return -1;\
+		memset(new_arr, 0, new_capacity * sizeof(NAME##_bucket));\
+		\
+		NAME old = *map;\
+		map->arr = new_arr;\
+		map->capacity = new_capacity;\
+		for (uint64_t i = 0; i < old.capacity; ++i) {\
+			if (!NAME##_key_is_zero(&old.arr[i].key))\
+				*NAME##_find_bucket(map, &old.arr[i].key) =\
+					old.arr[i];\
+		}\
+		NAME##_free(&old);\
+		return 0;\
+	}\
+	\
+	NAME##_bucket *\
+	NAME##_get_or_insert(NAME *map, KEY_TYPE key, bool *inserted)\
+	{\
+		NAME##_bucket *bucket = NAME##_lookup(map, &key);\
+		if (inserted != NULL)\
+			*inserted = bucket == NULL;\
+		if (bucket != NULL)\
+			return bucket;\
+		\
+		if (NAME##_key_is_zero(&key)) {\
+			bucket = &map->zero;\
+			map->has_zero = true;\
+		}\
+		else {\
+			if (NAME##_reserve(map, map->nel + 1) != 0)\
+				return NULL;\
+			bucket = NAME##_find_bucket(map, &key);\
+		}\
+		bucket->key = key;\
+		bucket->value = NULL;\
+		++map->nel;\
+		return bucket;\
+	}\
+	\
+	int NAME##_insert(NAME *map, KEY_TYPE key, void *value)\
+	{\
+		NAME##_bucket *bucket = NAME##_get_or_insert(map, key, NULL);\
+		if (bucket == NULL)\
+			return -1;\
+		bucket->value = value;\
+		return 0;\
+	}\
+	\
+	void *NAME##_erase(NAME *map, KEY_TYPE key)\
+	{\
+		NAME##_bucket *bucket = NAME##_lookup(map, &key);\
+		if (bucket == NULL)\
+			return NULL;\
+		void *value = bucket->value;\
+		--map->nel;\
+		if (bucket == &map->zero) {\
+			map->has_zero = false;\
+			return value;\
+		}\
+		\
+		/* backward-shift deletion, see cu_hm_erase_at */\
+		uint64_t mask = map->capacity - 1;\
+		uint64_t hole = bucket - map->arr;\
+		for (uint64_t i = (hole + 1) & mask;\
+			!NAME##_key_is_zero(&map->arr[i].key);\
+			i = (i + 1) & mask\
+		) {\
+			uint64_t home =\
+				NAME##_hash(map, map->arr[i].key) & mask;\
+			if (((i - home) & mask) >= ((i - hole) & mask)) {\
+				map->arr[hole] = map->arr[i];\
+				hole = i;\
+			}\
+		}\
+		memset(map->arr + hole, 0, sizeof(NAME##_bucket));\
+		return value;\
+	}\
+	\
+	NAME##_iter NAME##_begin(NAME *map)\
+	{\
+		return (NAME##_iter){\
+			.hmap = map,\
+			.index = 0,\
+		};\
+	}\
+	\
+	/* index 0 is the zero key, the table starts at 1 */\
+	NAME##_bucket *NAME##_next(NAME##_iter *iter)\
+	{\
+		NAME *map = iter->hmap;\
+		if (iter->index == 0) {\
+			++iter->index;\
+			if (map->has_zero)\
+				return &map->zero;\
+		}\
+		while (iter->index <= map->capacity) {\
+			NAME##_bucket *bucket = map->arr + iter->index - 1;\
+			++iter->index;\
+			if (!NAME##_key_is_zero(&bucket->key))\
+				return bucket;\
+		}\
+		return NULL;\
+	}
+
+#endif // CU_HASHMAP_TYPED_H
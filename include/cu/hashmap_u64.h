@@ -0,0 +1,38 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#ifndef CU_HASHMAP_U64_H
+#define CU_HASHMAP_U64_H
+
+#include <cu/hashmap_typed.h>
+
+// A hashmap keyed by 64-bit integers, for when keys are IDs rather than
+// strings.
+//
+// Keys are stored in the buckets and compared as integers, nothing has to be
+// formatted into a `cu_str` first. Pass CU_HM_FIXED_MIX to cu_hm_u64_new to
+// hash with a fast mixer instead of SipHash when keys can't be chosen by an
+// attacker.
+//
+// See hashmap_typed.h for the details, the functions here are:
+//
+// int cu_hm_u64_new(cu_hm_u64 *map, cu_alloc *alloc,
+//	cu_hm_fixed_hash hash_kind);
+// void cu_hm_u64_free(cu_hm_u64 *map);
+// uint64_t cu_hm_u64_hash(const cu_hm_u64 *map, uint64_t key);
+// void *cu_hm_u64_at(cu_hm_u64 *map, uint64_t key);
+// bool cu_hm_u64_contains(cu_hm_u64 *map, uint64_t key);
+// cu_hm_u64_bucket *cu_hm_u64_get_or_insert(cu_hm_u64 *map, uint64_t key,
+//	bool *inserted);
+// int cu_hm_u64_insert(cu_hm_u64 *map, uint64_t key, void *value);
+// int cu_hm_u64_reserve(cu_hm_u64 *map, uint64_t nel);
+// void *cu_hm_u64_erase(cu_hm_u64 *map, uint64_t key);
+// cu_hm_u64_iter cu_hm_u64_begin(cu_hm_u64 *map);
+// cu_hm_u64_bucket *cu_hm_u64_next(cu_hm_u64_iter *iter);
+
+CU_HM_TYPED_DECLARE(cu_hm_u64, uint64_t)
+
+#endif // CU_HASHMAP_U64_H
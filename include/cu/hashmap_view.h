@@ -0,0 +1,79 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#ifndef CU_HASHMAP_VIEW_H
+#define CU_HASHMAP_VIEW_H
+
+#include <cu/hashmap_frozen.h>
+
+// Saving a `cu_hm` to a file, and looking keys up in the file directly.
+//
+// cu_hm_save writes the map out as a frozen table (see hashmap_frozen.h),
+// with keys stored as offsets into the file instead of pointers. Opening a
+// `cu_hm_view` maps the file read-only and answers lookups straight from
+// the mapping, so nothing is parsed or copied at startup, and processes
+// viewing the same file share its pages.
+//
+// Values are saved as integers, the `void *` values of the map are converted
+// with `(uintptr_t)`. This is meant for maps from strings to offsets or IDs,
+// pointers don't mean anything once they're written to a file.
+//
+// Files are written in the native byte order, and can only be viewed on
+// machines with the same byte order. Viewing a file that's been corrupted
+// never reads outside the mapping, but may return nonsense.
+
+typedef struct {
+	const uint8_t *data;
+	size_t size;
+	const uint32_t *pilots;
+	const struct cu_hm_view_slot *slots;
+	uint64_t nel;
+	uint64_t ngroups;
+	cu_siphash_key key;
+} cu_hm_view;
+
+typedef struct {
+	const cu_hm_view *view;
+	uint64_t index;
+} cu_hm_view_iter;
+
+// Writes `map` to the file at `path`, replacing anything already there.
+//
+// Returns 0 on success, -1 on failure.
+int cu_hm_save(const cu_hm *map, const char *path);
+
+// Maps the file at `path`, which must have been written by cu_hm_save.
+//
+// Returns 0 on success, -1 if the file can't be mapped or isn't a saved map.
+int cu_hm_view_open(cu_hm_view *view, const char *path);
+void cu_hm_view_close(cu_hm_view *view);
+
+// Looks `key` up, storing its value in `*value` if it's found.
+//
+// Returns whether `key` was found.
+bool cu_hm_view_at(const cu_hm_view *view, cu_str key, uint64_t *value);
+static inline bool cu_hm_view_contains(const cu_hm_view *view, cu_str key)
+{
+	uint64_t value;
+	return cu_hm_view_at(view, key, &value);
+}
+
+static inline cu_hm_view_iter cu_hm_view_begin(const cu_hm_view *view)
+{
+	return (cu_hm_view_iter){
+		.view = view,
+		.index = 0,
+	};
+}
+
+// Gets the next key and value in the view.
+//
+// `key` points into the read-only mapping, and must not be written to.
+//
+// Returns false once every key has been visited.
+bool cu_hm_view_next(cu_hm_view_iter *iter, cu_str *key, uint64_t *value);
+
+#endif // CU_HASHMAP_VIEW_H
@@ -0,0 +1,112 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#ifndef CU_HASHSET_H
+#define CU_HASHSET_H
+
+#include <cu/string.h>
+#include <cu/arena.h>
+
+// A set of strings, laid out like `cu_hm` minus the values.
+//
+// Uses linear probing with backward-shift deletion, and caches the SipHash
+// of every key, just like `cu_hm`. Keys aren't copied.
+//
+// The set operations build a new set in a single pass over their inputs. The
+// result gets the SipHash key of the first input, so when both inputs share
+// a key (see cu_hs_new_with_key), no key is ever rehashed.
+//
+// Any insertion or erasure invalidates pointers to buckets and iterators.
+
+typedef struct {
+	cu_str key;
+	uint64_t hash;
+} cu_hs_bucket;
+
+typedef struct {
+	cu_hs_bucket *arr;
+	uint64_t capacity;
+	uint64_t nel;
+	cu_alloc *alloc;
+	cu_siphash_key key;
+} cu_hs;
+
+typedef struct {
+	const cu_hs *set;
+	uint64_t index;
+} cu_hs_iter;
+
+// Returns 0 on success, -1 on failure.
+int cu_hs_new(cu_hs *set, cu_alloc *alloc);
+
+// Creates a set with a given SipHash key, so that sets can share one.
+void cu_hs_new_with_key(cu_hs *set, cu_alloc *alloc,
+	const cu_siphash_key *key);
+void cu_hs_free(cu_hs *set);
+
+static inline uint64_t cu_hs_hash(const cu_hs *set, cu_str key)
+{
+	return cu_str_hash(key, &set->key);
+}
+
+// Returns the bucket holding `key`, or NULL if it isn't in the set.
+const cu_hs_bucket *
+cu_hs_find_hashed(const cu_hs *set, cu_str key, uint64_t hash);
+
+static inline bool
+cu_hs_contains_hashed(const cu_hs *set, cu_str key, uint64_t hash)
+{
+	return cu_hs_find_hashed(set, key, hash) != NULL;
+}
+static inline bool cu_hs_contains(const cu_hs *set, cu_str key)
+{
+	return cu_hs_contains_hashed(set, key, cu_hs_hash(set, key));
+}
+
+// Adds `key` to the set.
+//
+// If `inserted != NULL`, `*inserted` is set to whether `key` was new.
+//
+// Returns 0 on success, -1 on failure.
+int cu_hs_insert_hashed(cu_hs *set, cu_str key, uint64_t hash,
+	bool *inserted);
+static inline int cu_hs_insert(cu_hs *set, cu_str key, bool *inserted)
+{
+	return cu_hs_insert_hashed(set, key, cu_hs_hash(set, key), inserted);
+}
+
+int cu_hs_reserve(cu_hs *set, uint64_t nel);
+
+// Removes `key` from the set.
+//
+// Returns whether `key` was in the set.
+bool cu_hs_erase_hashed(cu_hs *set, cu_str key, uint64_t hash);
+static inline bool cu_hs_erase(cu_hs *set, cu_str key)
+{
+	return cu_hs_erase_hashed(set, key, cu_hs_hash(set, key));
+}
+
+// These make `dst` a new set holding the union, intersection, or difference
+// (keys in `a` but not `b`) of `a` and `b`.
+//
+// `dst` uses the allocator and SipHash key of `a`, and must not be `a` or `b`.
+//
+// Return 0 on success. On failure, -1 is returned and `dst` doesn't need to
+// be freed.
+int cu_hs_union(cu_hs *dst, const cu_hs *a, const cu_hs *b);
+int cu_hs_intersection(cu_hs *dst, const cu_hs *a, const cu_hs *b);
+int cu_hs_difference(cu_hs *dst, const cu_hs *a, const cu_hs *b);
+
+static inline cu_hs_iter cu_hs_begin(const cu_hs *set)
+{
+	return (cu_hs_iter){
+		.set = set,
+		.index = 0,
+	};
+}
+const cu_hs_bucket *cu_hs_next(cu_hs_iter *iter);
+
+#endif // CU_HASHSET_H
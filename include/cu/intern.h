@@ -0,0 +1,70 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#ifndef CU_INTERN_H
+#define CU_INTERN_H
+
+#include <cu/hashmap.h>
+
+// Turns strings into dense 32-bit IDs.
+//
+// The first distinct string interned gets ID 0, the next one 1, and so on.
+// IDs never change, and getting the string back from an ID is an array
+// lookup. The strings are copied into an arena and stay valid until the
+// table is freed.
+//
+// Nothing can be removed from the table.
+
+typedef struct {
+	cu_hm map; // copies of the strings -> ID + 1
+	cu_str *strs; // indexed by ID
+	uint32_t nel;
+	uint32_t strs_capacity;
+	cu_arena *arena;
+	cu_alloc *alloc;
+} cu_intern;
+
+// Returns 0 on success, -1 on failure.
+int cu_intern_new(cu_intern *table, cu_alloc *alloc, size_t arena_blocksize);
+void cu_intern_free(cu_intern *table);
+
+// Stores the ID of `str` in `*id`, giving `str` the next free ID if it
+// hasn't been interned yet.
+//
+// Returns 0 on success, -1 on failure (including running out of IDs).
+int cu_intern_str(cu_intern *table, cu_str str, uint32_t *id);
+
+// Interns `n` strings at once, storing the ID of `strs[i]` in `ids[i]`.
+//
+// Strings that were already interned are looked up in batches with
+// cu_hm_at_many, so their cache misses overlap. New strings get their IDs in
+// the order they appear in `strs`.
+//
+// Returns 0 on success. On failure, -1 is returned, and the strings before
+// the one that failed have been interned.
+int cu_intern_many(cu_intern *table, const cu_str *strs, size_t n,
+	uint32_t *ids);
+
+// Stores the ID of `str` in `*id` if it's been interned.
+//
+// Returns whether `str` has been interned.
+static inline bool cu_intern_find(cu_intern *table, cu_str str, uint32_t *id)
+{
+	void *value = cu_hm_at(&table->map, str);
+	if (value == NULL)
+		return false;
+	*id = (uint32_t)((uintptr_t)value - 1);
+	return true;
+}
+
+// The string with the ID `id`.
+static inline cu_str cu_intern_get(const cu_intern *table, uint32_t id)
+{
+	assert(id < table->nel && "ID out of range");
+	return table->strs[id];
+}
+
+#endif // CU_INTERN_H
@@ -0,0 +1,43 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#ifndef CU_KEYSTORE_H
+#define CU_KEYSTORE_H
+
+#include <cu/hashset.h>
+
+// A deduplicated store of string copies, meant to be shared by several
+// `cu_hm_cpy` maps over the same keys (see cu_hm_cpy_new_shared).
+//
+// Every distinct string is copied into the store's arena once. The copy,
+// called a handle here, stays valid until the store is freed, and equal
+// strings always get the same handle. So two handles from one store are
+// equal exactly when their `buf`s are, no `memcmp` needed.
+//
+// Nothing is removed from the store until it's freed.
+
+typedef struct {
+	cu_hs set; // of the copies
+	cu_arena *arena;
+} cu_keystore;
+
+// Returns 0 on success, -1 on failure.
+int cu_keystore_new(cu_keystore *store, cu_alloc *alloc,
+	size_t arena_blocksize);
+void cu_keystore_free(cu_keystore *store);
+
+// Returns the handle for `key`, copying `key` into the store if it isn't
+// there yet.
+//
+// Returns CU_NIL_STR if allocation failed.
+cu_str cu_keystore_intern(cu_keystore *store, cu_str key);
+
+// Returns the handle for `key`, or CU_NIL_STR if it isn't in the store.
+//
+// A key that isn't in the store isn't in any map sharing it either.
+cu_str cu_keystore_find(const cu_keystore *store, cu_str key);
+
+#endif // CU_KEYSTORE_H
@@ -66,4 +66,99 @@ uint64_t cu_siphash_hash(
 	size_t size
 );
 
+// SipHash-2-4, the variant from the original paper, with more rounds and a
+// wider security margin than SipHash-1-3, at about 1.5x the cost.
+//
+// Unlike `cu_siphash_hash', this is guaranteed to stay SipHash-2-4.
+//
+// Always succeeds
+uint64_t cu_siphash24_hash(
+	const cu_siphash_key *key,
+	const uint8_t *buf,
+	size_t size
+);
+
+// SipHash with a 128-bit output, for fingerprints that have to stay unique
+// across far more messages than a 64-bit hash allows. The hash is stored in
+// `out`, first the low 64 bits and then the high ones.
+//
+// It's the same rounds as `cu_siphash_hash' plus one extra finalization, so
+// it costs little more than the 64-bit version.
+//
+// Always succeeds
+void cu_siphash128_hash(
+	const cu_siphash_key *key,
+	const uint8_t *buf,
+	size_t size,
+	uint64_t out[2]
+);
+
+// HalfSipHash, SipHash on 32-bit words, with a 32 or 64-bit output.
+//
+// It's meant for compact hashes, such as ones stored in on-disk indexes, and
+// for 32-bit CPUs. With only a 64-bit key it's a much weaker PRF than SipHash,
+// so prefer `cu_siphash_hash' for hashmaps on 64-bit CPUs.
+//
+// Only the first half of `key` (`key->key[0]`) is used.
+//
+// Always succeeds
+uint32_t cu_halfsiphash_hash(
+	const cu_siphash_key *key,
+	const uint8_t *buf,
+	size_t size
+);
+uint64_t cu_halfsiphash64_hash(
+	const cu_siphash_key *key,
+	const uint8_t *buf,
+	size_t size
+);
+
+// The state of a hash that's fed its message a piece at a time, for messages
+// that aren't contiguous in memory.
+typedef struct {
+	uint64_t v[4];
+	uint64_t tail; // the bytes past the last full word, little-endian
+	uint64_t len;
+} cu_siphash_state;
+
+// Starts hashing a new message under `key`.
+void cu_siphash_state_init(cu_siphash_state *state, const cu_siphash_key *key);
+
+// Appends `size` bytes to the message being hashed.
+void cu_siphash_update(
+	cu_siphash_state *state,
+	const uint8_t *buf,
+	size_t size
+);
+
+// Returns the hash of everything passed to `cu_siphash_update' so far, which
+// is the same as `cu_siphash_hash' of all of it at once.
+//
+// `state` isn't changed, so more can be appended afterwards.
+uint64_t cu_siphash_final(const cu_siphash_state *state);
+
+// Hashes 4 or 8 messages at once under the same key, storing the hash of the
+// `sizes[i]` bytes at `bufs[i]` in `out[i]`. The hashes are the same as
+// calling `cu_siphash_hash' on each message.
+//
+// On x86 CPUs with AVX2 or AVX-512, chosen at runtime, the messages are
+// hashed side by side in vector registers. This is fastest when they're of
+// similar lengths; lanes that finish early sit idle until the longest message
+// is done. Elsewhere, or if `CU_SIPHASH_NO_SIMD` is defined when building the
+// library, the messages are hashed one after another.
+//
+// Always succeeds
+void cu_siphash_hash_x4(
+	const cu_siphash_key *key,
+	const uint8_t *const bufs[4],
+	const size_t sizes[4],
+	uint64_t out[4]
+);
+void cu_siphash_hash_x8(
+	const cu_siphash_key *key,
+	const uint8_t *const bufs[8],
+	const size_t sizes[8],
+	uint64_t out[8]
+);
+
 #endif // CU_SIPHASH_H
@@ -13,6 +13,7 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <cu/alloc.h>
+#include <cu/arena.h>
 #include <cu/siphash.h>
 
 
@@ -61,6 +62,10 @@ static inline bool cu_str_eq(cu_str s1, cu_str s2)
 	if (s1.len != s2.len) {
 		return false;
 	}
+	// the same copy, e.g. two handles from a cu_keystore
+	if (s1.buf == s2.buf) {
+		return true;
+	}
 	if (memcmp(s1.buf, s2.buf, s1.len) == 0) {
 		return true;
 	}
@@ -102,6 +107,16 @@ static inline cu_str cu_str_rmsuffix(cu_str str, size_t n_to_remove)
 	str.len -= n_to_remove;
 	return str;
 }
+// Copies `str` into `arena`, returning CU_NIL_STR if the arena is out of
+// memory. The bytes of the copy aren't aligned to anything.
+static inline cu_str cu_str_arena_copy(cu_str str, cu_arena *arena)
+{
+	uint8_t *copy = cu_arena_aligned_alloc(str.len, 1, arena);
+	if (copy == NULL)
+		return CU_NIL_STR;
+	memcpy(copy, str.buf, str.len);
+	return (cu_str){.buf = copy, .len = str.len};
+}
 
 
 // cu_str_parse_* error codes
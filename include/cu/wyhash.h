@@ -0,0 +1,29 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#ifndef CU_WYHASH_H
+#define CU_WYHASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cu/siphash.h>
+
+// An implementation of wyhash (the "final4" version).
+//
+// It's several times faster than SipHash on short keys, since it mixes 16
+// bytes at a time with a single 64x64->128 bit multiply. It is NOT secure
+// against maliciously-chosen keys: don't use it for hashmaps that attackers
+// can submit keys to.
+//
+// It's keyed with a `cu_siphash_key`, so the same random key can be used with
+// either function. The first half of the key is wyhash's seed, and the second
+// half is mixed into the seed as well, so a key of `{seed, 0}` gives the same
+// hashes as the reference implementation with that seed.
+
+// Always succeeds
+uint64_t cu_wyhash(const cu_siphash_key *key, const uint8_t *buf, size_t size);
+
+#endif // CU_WYHASH_H
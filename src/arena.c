@@ -125,7 +125,7 @@ void *cu_arena_aligned_alloc(size_t amt, size_t align, cu_arena *arena)
 		new_bump &= ~(align - 1);
 		if ((uint8_t *)new_bump >= elem->buf_start) {
 			elem->bump = (uint8_t *)new_bump;
-			return arena->bump; // found some space!
+			return elem->bump; // found some space!
 		}
 	}
 	// no place in linked list! get a new node
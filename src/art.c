@@ -0,0 +1,595 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cu/art.h>
+#include <cu/bitmanip.h>
+
+#ifdef CU_ART_SSE2
+#	include <emmintrin.h>
+#endif
+
+enum node_type {
+	NODE4,
+	NODE16,
+	NODE48,
+	NODE256,
+};
+
+// Every node can hold the key that ends right after its prefix, and branches
+// on the byte after that.
+//
+// `prefix` always points into the copy of some key under the node, at the
+// node's depth, so the bytes in front of it are the path down to the node.
+struct cu_art_node {
+	cu_art_node *parent; // the next free node, while in a free list
+	const uint8_t *prefix;
+	uint32_t prefix_len;
+	uint16_t nchildren;
+	uint8_t type;
+	uint8_t parent_byte; // the byte this node is under in its parent
+	cu_str key; // of the value stored here, or CU_NIL_STR
+	void *value;
+};
+
+// keys are sorted, and children[i] is under keys[i]
+typedef struct {
+	cu_art_node hdr;
+	uint8_t keys[4];
+	cu_art_node *children[4];
+} node4;
+
+typedef struct {
+	cu_art_node hdr;
+	uint8_t keys[16];
+	cu_art_node *children[16];
+} node16;
+
+// the child under byte `b` is children[index[b] - 1], if index[b] != 0
+typedef struct {
+	cu_art_node hdr;
+	uint8_t index[256];
+	cu_art_node *children[48];
+} node48;
+
+typedef struct {
+	cu_art_node hdr;
+	cu_art_node *children[256];
+} node256;
+
+static const size_t NODE_SIZES[] = {
+	sizeof(node4), sizeof(node16), sizeof(node48), sizeof(node256),
+};
+static const uint16_t NODE_CAPACITIES[] = {4, 16, 48, 256};
+// A node is shrunk once it's down to this many children, which leaves some
+// slack so a node hovering around a boundary isn't resized on every change.
+// NODE4s are never shrunk.
+static const uint16_t NODE_SHRINK_AT[] = {0, 3, 12, 37};
+
+int cu_art_new(cu_art *tree, cu_alloc *alloc, size_t arena_blocksize)
+{
+	*tree = (cu_art){0};
+	tree->arena = cu_arena_new(arena_blocksize, alloc);
+	return tree->arena == NULL ? -1 : 0;
+}
+
+void cu_art_free(cu_art *tree)
+{
+	cu_arena_free(tree->arena);
+}
+
+static cu_art_node *alloc_node(cu_art *tree, enum node_type type)
+{
+	cu_art_node *node = tree->free_nodes[type];
+	if (node != NULL)
+		tree->free_nodes[type] = node->parent;
+	else
+		node = cu_arena_alloc(NODE_SIZES[type], tree->arena);
+	if (node == NULL)
+		return NULL;
+	memset(node, 0, NODE_SIZES[type]);
+	node->type = type;
+	return node;
+}
+
+static void release_node(cu_art *tree, cu_art_node *node)
+{
+	node->parent = tree->free_nodes[node->type];
+	tree->free_nodes[node->type] = node;
+}
+
+static cu_art_node **find_child16(node16 *node, uint8_t byte)
+{
+#ifdef CU_ART_SSE2
+	__m128i matches = _mm_cmpeq_epi8(_mm_set1_epi8((char)byte),
+		_mm_loadu_si128((const __m128i *)node->keys));
+	unsigned mask = (unsigned)_mm_movemask_epi8(matches)
+		& ((1u << node->hdr.nchildren) - 1);
+	if (mask == 0)
+		return NULL;
+	return node->children + cu_trailing_zeros(mask);
+#else
+	for (uint16_t i = 0; i < node->hdr.nchildren; ++i) {
+		if (node->keys[i] == byte)
+			return node->children + i;
+		if (node->keys[i] > byte)
+			break;
+	}
+	return NULL;
+#endif
+}
+
+// Returns the slot holding the child under `byte`, or NULL if there's none.
+static cu_art_node **find_child(cu_art_node *node, uint8_t byte)
+{
+	switch (node->type) {
+	case NODE4: {
+		node4 *n = (node4 *)node;
+		for (uint16_t i = 0; i < node->nchildren; ++i) {
+			if (n->keys[i] == byte)
+				return n->children + i;
+		}
+		return NULL;
+	}
+	case NODE16:
+		return find_child16((node16 *)node, byte);
+	case NODE48: {
+		node48 *n = (node48 *)node;
+		if (n->index[byte] == 0)
+			return NULL;
+		return n->children + n->index[byte] - 1;
+	}
+	default: {
+		node256 *n = (node256 *)node;
+		return n->children[byte] == NULL ? NULL : n->children + byte;
+	}
+	}
+}
+
+// Returns the child under the smallest byte > `byte`, or NULL if there's
+// none. `byte` can be -1 to get the first child.
+static const cu_art_node *child_after(const cu_art_node *node, int byte)
+{
+	switch (node->type) {
+	case NODE4:
+	case NODE16: {
+		// both start with the same layout up to their arrays' sizes
+		const uint8_t *keys = node->type == NODE4
+			? ((const node4 *)node)->keys
+			: ((const node16 *)node)->keys;
+		cu_art_node *const *children = node->type == NODE4
+			? ((const node4 *)node)->children
+			: ((const node16 *)node)->children;
+		for (uint16_t i = 0; i < node->nchildren; ++i) {
+			if (keys[i] > byte)
+				return children[i];
+		}
+		return NULL;
+	}
+	case NODE48: {
+		const node48 *n = (const node48 *)node;
+		for (int b = byte + 1; b < 256; ++b) {
+			if (n->index[b] != 0)
+				return n->children[n->index[b] - 1];
+		}
+		return NULL;
+	}
+	default: {
+		const node256 *n = (const node256 *)node;
+		for (int b = byte + 1; b < 256; ++b) {
+			if (n->children[b] != NULL)
+				return n->children[b];
+		}
+		return NULL;
+	}
+	}
+}
+
+// Adds `child` under `byte` to `node`, which must have room for it.
+static void add_child(cu_art_node *node, uint8_t byte, cu_art_node *child)
+{
+	assert(node->nchildren < NODE_CAPACITIES[node->type]);
+	child->parent = node;
+	child->parent_byte = byte;
+	switch (node->type) {
+	case NODE4:
+	case NODE16: {
+		uint8_t *keys = node->type == NODE4
+			? ((node4 *)node)->keys
+			: ((node16 *)node)->keys;
+		cu_art_node **children = node->type == NODE4
+			? ((node4 *)node)->children
+			: ((node16 *)node)->children;
+		uint16_t pos = 0;
+		while (pos < node->nchildren && keys[pos] < byte)
+			++pos;
+		memmove(keys + pos + 1, keys + pos, node->nchildren - pos);
+		memmove(children + pos + 1, children + pos,
+			(node->nchildren - pos) * sizeof(cu_art_node *));
+		keys[pos] = byte;
+		children[pos] = child;
+		break;
+	}
+	case NODE48: {
+		node48 *n = (node48 *)node;
+		// erased children leave holes anywhere
+		uint8_t slot = 0;
+		while (n->children[slot] != NULL)
+			++slot;
+		n->children[slot] = child;
+		n->index[byte] = slot + 1;
+		break;
+	}
+	default:
+		((node256 *)node)->children[byte] = child;
+		break;
+	}
+	++node->nchildren;
+}
+
+static void remove_child(cu_art_node *node, uint8_t byte)
+{
+	switch (node->type) {
+	case NODE4:
+	case NODE16: {
+		uint8_t *keys = node->type == NODE4
+			? ((node4 *)node)->keys
+			: ((node16 *)node)->keys;
+		cu_art_node **children = node->type == NODE4
+			? ((node4 *)node)->children
+			: ((node16 *)node)->children;
+		uint16_t pos = 0;
+		while (keys[pos] != byte)
+			++pos;
+		memmove(keys + pos, keys + pos + 1, node->nchildren - pos - 1);
+		memmove(children + pos, children + pos + 1,
+			(node->nchildren - pos - 1) * sizeof(cu_art_node *));
+		break;
+	}
+	case NODE48: {
+		node48 *n = (node48 *)node;
+		n->children[n->index[byte] - 1] = NULL;
+		n->index[byte] = 0;
+		break;
+	}
+	default:
+		((node256 *)node)->children[byte] = NULL;
+		break;
+	}
+	--node->nchildren;
+}
+
+// The slot in the tree pointing at `node`.
+static cu_art_node **slot_of(cu_art *tree, cu_art_node *node)
+{
+	if (node->parent == NULL)
+		return &tree->root;
+	return find_child(node->parent, node->parent_byte);
+}
+
+// Replaces `node` with a copy of type `type`, which must have room for all
+// of its children.
+//
+// Returns the copy, or NULL on failure.
+static cu_art_node *
+resize(cu_art *tree, cu_art_node *node, enum node_type type)
+{
+	cu_art_node *copy = alloc_node(tree, type);
+	if (copy == NULL)
+		return NULL;
+	*copy = *node;
+	copy->type = type;
+	copy->nchildren = 0;
+
+	const cu_art_node *child = child_after(node, -1);
+	while (child != NULL) {
+		const cu_art_node *next = child_after(node, child->parent_byte);
+		add_child(copy, child->parent_byte, (cu_art_node *)child);
+		child = next;
+	}
+	*slot_of(tree, node) = copy;
+	release_node(tree, node);
+	return copy;
+}
+
+// Returns the number of bytes of `node`'s prefix that match `key`, starting
+// at `depth`.
+static size_t prefix_match(const cu_art_node *node, cu_str key, size_t depth)
+{
+	size_t max = key.len - depth;
+	if (max > node->prefix_len)
+		max = node->prefix_len;
+	size_t i = 0;
+	while (i < max && node->prefix[i] == key.buf[depth + i])
+		++i;
+	return i;
+}
+
+// Whether all of `node`'s prefix matches `key`, starting at `depth`.
+static inline bool
+prefix_matches(const cu_art_node *node, cu_str key, size_t depth)
+{
+	return key.len - depth >= node->prefix_len && memcmp(node->prefix,
+		key.buf + depth, node->prefix_len) == 0;
+}
+
+// Makes a childless node holding `key`, with the rest of the key after
+// `depth` as its prefix.
+static cu_art_node *
+new_leaf(cu_art *tree, cu_str key, size_t depth, void *value)
+{
+	cu_art_node *leaf = alloc_node(tree, NODE4);
+	if (leaf == NULL)
+		return NULL;
+	cu_str copy = cu_str_arena_copy(key, tree->arena);
+	if (copy.buf == NULL) {
+		release_node(tree, leaf);
+		return NULL;
+	}
+	leaf->prefix = copy.buf + depth;
+	leaf->prefix_len = copy.len - depth;
+	leaf->key = copy;
+	leaf->value = value;
+	return leaf;
+}
+
+// Splits `node`'s prefix after `matched` bytes, where `key` branches off.
+static int split(cu_art *tree, cu_art_node **slot, cu_str key, size_t depth,
+	size_t matched, void *value)
+{
+	cu_art_node *node = *slot;
+	cu_art_node *branch = alloc_node(tree, NODE4);
+	if (branch == NULL)
+		return -1;
+	cu_art_node *leaf = NULL;
+	if (depth + matched == key.len) {
+		// `key` ends in the middle of the prefix
+		branch->key = cu_str_arena_copy(key, tree->arena);
+		branch->value = value;
+		if (branch->key.buf == NULL) {
+			release_node(tree, branch);
+			return -1;
+		}
+	} else {
+		leaf = new_leaf(tree, key, depth + matched + 1, value);
+		if (leaf == NULL) {
+			release_node(tree, branch);
+			return -1;
+		}
+	}
+
+	branch->prefix = node->prefix;
+	branch->prefix_len = matched;
+	branch->parent = node->parent;
+	branch->parent_byte = node->parent_byte;
+	uint8_t node_byte = node->prefix[matched];
+	node->prefix += matched + 1;
+	node->prefix_len -= matched + 1;
+	add_child(branch, node_byte, node);
+	if (leaf != NULL)
+		add_child(branch, key.buf[depth + matched], leaf);
+	*slot = branch;
+	++tree->nel;
+	return 0;
+}
+
+int cu_art_insert(cu_art *tree, cu_str key, void *value)
+{
+	if (tree->root == NULL) {
+		tree->root = new_leaf(tree, key, 0, value);
+		if (tree->root == NULL)
+			return -1;
+		++tree->nel;
+		return 0;
+	}
+
+	cu_art_node **slot = &tree->root;
+	size_t depth = 0;
+	for (;;) {
+		cu_art_node *node = *slot;
+		size_t matched = prefix_match(node, key, depth);
+		if (matched < node->prefix_len)
+			return split(tree, slot, key, depth, matched, value);
+		depth += matched;
+
+		if (depth == key.len) {
+			if (node->key.buf == NULL) {
+				node->key = cu_str_arena_copy(key,
+					tree->arena);
+				if (node->key.buf == NULL)
+					return -1;
+				++tree->nel;
+			}
+			node->value = value;
+			return 0;
+		}
+
+		cu_art_node **child = find_child(node, key.buf[depth]);
+		if (child != NULL) {
+			slot = child;
+			++depth;
+			continue;
+		}
+
+		cu_art_node *leaf = new_leaf(tree, key, depth + 1, value);
+		if (leaf == NULL)
+			return -1;
+		if (node->nchildren == NODE_CAPACITIES[node->type]) {
+			node = resize(tree, node, node->type + 1);
+			if (node == NULL) {
+				release_node(tree, leaf);
+				return -1;
+			}
+		}
+		add_child(node, key.buf[depth], leaf);
+		++tree->nel;
+		return 0;
+	}
+}
+
+// Returns the node holding `key`, or NULL if there's none.
+static cu_art_node *find_node(const cu_art *tree, cu_str key)
+{
+	cu_art_node *node = tree->root;
+	size_t depth = 0;
+	while (node != NULL) {
+		if (!prefix_matches(node, key, depth))
+			return NULL;
+		depth += node->prefix_len;
+		if (depth == key.len)
+			return node->key.buf == NULL ? NULL : node;
+		cu_art_node **child = find_child(node, key.buf[depth]);
+		if (child == NULL)
+			return NULL;
+		node = *child;
+		++depth;
+	}
+	return NULL;
+}
+
+void *cu_art_at(const cu_art *tree, cu_str key)
+{
+	const cu_art_node *node = find_node(tree, key);
+	return node == NULL ? NULL : node->value;
+}
+
+void *cu_art_erase(cu_art *tree, cu_str key)
+{
+	cu_art_node *node = find_node(tree, key);
+	if (node == NULL)
+		return NULL;
+	void *value = node->value;
+	node->key = CU_NIL_STR;
+	node->value = NULL;
+	--tree->nel;
+
+	// nodes left with nothing under them are removed
+	while (node->nchildren == 0 && node->key.buf == NULL) {
+		cu_art_node *parent = node->parent;
+		if (parent == NULL) {
+			tree->root = NULL;
+			release_node(tree, node);
+			return value;
+		}
+		remove_child(parent, node->parent_byte);
+		release_node(tree, node);
+		node = parent;
+	}
+
+	// A node with only one child and no key of its own is merged into the
+	// child. The child's prefix points into a key copy that also holds
+	// the node's prefix and the byte between them, right in front of it.
+	if (node->nchildren == 1 && node->key.buf == NULL) {
+		cu_art_node *child = (cu_art_node *)child_after(node, -1);
+		child->prefix -= node->prefix_len + 1;
+		child->prefix_len += node->prefix_len + 1;
+		child->parent = node->parent;
+		child->parent_byte = node->parent_byte;
+		*slot_of(tree, node) = child;
+		release_node(tree, node);
+	} else if (node->type != NODE4
+		&& node->nchildren <= NODE_SHRINK_AT[node->type]) {
+		// failing just leaves the node bigger than it needs to be
+		resize(tree, node, node->type - 1);
+	}
+	return value;
+}
+
+void *cu_art_longest_prefix(const cu_art *tree, cu_str str, cu_str *match)
+{
+	const cu_art_node *best = NULL;
+	cu_art_node *node = tree->root;
+	size_t depth = 0;
+	while (node != NULL && prefix_matches(node, str, depth)) {
+		depth += node->prefix_len;
+		if (node->key.buf != NULL)
+			best = node;
+		if (depth == str.len)
+			break;
+		cu_art_node **child = find_child(node, str.buf[depth]);
+		if (child == NULL)
+			break;
+		node = *child;
+		++depth;
+	}
+	if (best == NULL)
+		return NULL;
+	if (match != NULL)
+		*match = best->key;
+	return best->value;
+}
+
+cu_art_iter cu_art_begin(const cu_art *tree)
+{
+	return (cu_art_iter){
+		.next = tree->root,
+		.root = tree->root,
+	};
+}
+
+cu_art_iter cu_art_prefix(const cu_art *tree, cu_str prefix)
+{
+	cu_art_node *node = tree->root;
+	size_t depth = 0;
+	while (node != NULL) {
+		size_t matched = prefix_match(node, prefix, depth);
+		// every key under `node` starts with `prefix`
+		if (depth + matched == prefix.len) {
+			return (cu_art_iter){
+				.next = node,
+				.root = node,
+			};
+		}
+		if (matched < node->prefix_len)
+			break;
+		depth += matched;
+		cu_art_node **child = find_child(node, prefix.buf[depth]);
+		if (child == NULL)
+			break;
+		node = *child;
+		++depth;
+	}
+	return (cu_art_iter){
+		.next = NULL,
+		.root = NULL,
+	};
+}
+
+// The node after `node` in a pre-order walk of the subtree at `root`.
+//
+// A node's key is a prefix of every key under it, and children are visited
+// in the order of their bytes, so this gives the keys in sorted order.
+static const cu_art_node *
+successor(const cu_art_node *node, const cu_art_node *root)
+{
+	const cu_art_node *child = child_after(node, -1);
+	if (child != NULL)
+		return child;
+	while (node != root) {
+		const cu_art_node *parent = node->parent;
+		const cu_art_node *sibling =
+			child_after(parent, node->parent_byte);
+		if (sibling != NULL)
+			return sibling;
+		node = parent;
+	}
+	return NULL;
+}
+
+bool cu_art_next(cu_art_iter *iter, cu_str *key, void **value)
+{
+	while (iter->next != NULL) {
+		const cu_art_node *node = iter->next;
+		iter->next = successor(node, iter->root);
+		if (node->key.buf == NULL)
+			continue;
+		if (key != NULL)
+			*key = node->key;
+		if (value != NULL)
+			*value = node->value;
+		return true;
+	}
+	return false;
+}
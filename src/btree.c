@@ -0,0 +1,622 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cu/btree.h>
+
+// Every node is laid out as this header, followed by
+// - uint64_t prefixes[max_keys], the first 8 bytes of each key, big-endian
+//   and zero-padded, so comparing them gives the same order as the keys
+// - cu_str keys[max_keys]
+// - void *values[max_keys] in a leaf, or
+//   cu_btree_node *children[max_keys + 1] in an inner node
+//
+// In an inner node, keys[i] is the smallest key under children[i + 1], and
+// everything under children[i] is smaller than keys[i].
+struct cu_btree_node {
+	cu_btree_node *next; // the next leaf, only used by leaves
+	uint32_t nkeys;
+	bool leaf;
+};
+
+#define HEADER_SIZE ((sizeof(cu_btree_node) + 7) & ~(size_t)7)
+#define BYTES_PER_KEY (sizeof(uint64_t) + sizeof(cu_str) + sizeof(void *))
+
+// Nodes other than the root never have fewer keys than this.
+static inline uint32_t min_keys(const cu_btree *tree)
+{
+	return (tree->max_keys - 1) / 2;
+}
+
+static inline uint64_t *prefixes(const cu_btree_node *node)
+{
+	return (uint64_t *)((uint8_t *)node + HEADER_SIZE);
+}
+
+static inline cu_str *keys(const cu_btree *tree, const cu_btree_node *node)
+{
+	return (cu_str *)(prefixes(node) + tree->max_keys);
+}
+
+static inline void **
+values(const cu_btree *tree, const cu_btree_node *node)
+{
+	return (void **)(keys(tree, node) + tree->max_keys);
+}
+
+static inline cu_btree_node **
+children(const cu_btree *tree, const cu_btree_node *node)
+{
+	return (cu_btree_node **)(keys(tree, node) + tree->max_keys);
+}
+
+static inline uint64_t key_prefix(cu_str key)
+{
+	uint64_t prefix = 0;
+	size_t len = key.len < 8 ? key.len : 8;
+	for (size_t i = 0; i < len; ++i)
+		prefix |= (uint64_t)key.buf[i] << (56 - 8 * i);
+	return prefix;
+}
+
+// Compares two keys like cu_str_cmp, given their prefixes.
+static inline int
+key_cmp(uint64_t prefix1, cu_str key1, uint64_t prefix2, cu_str key2)
+{
+	if (prefix1 != prefix2)
+		return prefix1 < prefix2 ? -1 : 1;
+	// the prefixes are the whole keys, except for any trailing zeroes
+	if (key1.len <= 8 && key2.len <= 8)
+		return (key1.len > key2.len) - (key1.len < key2.len);
+	return cu_str_cmp(key1, key2);
+}
+
+// Returns the index of the first key in `node` that's >= `key`, or > `key`
+// if `upper` is set.
+static uint32_t search(const cu_btree *tree, const cu_btree_node *node,
+	uint64_t prefix, cu_str key, bool upper)
+{
+	const uint64_t *node_prefixes = prefixes(node);
+	const cu_str *node_keys = keys(tree, node);
+	uint32_t lo = 0;
+	uint32_t hi = node->nkeys;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		int cmp = key_cmp(node_prefixes[mid], node_keys[mid],
+			prefix, key);
+		if (cmp < 0 || (upper && cmp == 0))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+// Whether `node`'s key at `index` exists and equals `key`.
+static inline bool key_at(const cu_btree *tree, const cu_btree_node *node,
+	uint32_t index, uint64_t prefix, cu_str key)
+{
+	return index < node->nkeys && key_cmp(prefixes(node)[index],
+		keys(tree, node)[index], prefix, key) == 0;
+}
+
+static cu_btree_node *new_node(const cu_btree *tree, bool leaf)
+{
+	cu_btree_node *node = cu_malloc(tree->node_size, tree->alloc);
+	if (node == NULL)
+		return NULL;
+	node->next = NULL;
+	node->nkeys = 0;
+	node->leaf = leaf;
+	return node;
+}
+
+static void free_node(const cu_btree *tree, cu_btree_node *node)
+{
+	cu_free(node, tree->node_size, tree->alloc);
+}
+
+static void free_subtree(const cu_btree *tree, cu_btree_node *node)
+{
+	if (!node->leaf) {
+		cu_btree_node **node_children = children(tree, node);
+		for (uint32_t i = 0; i <= node->nkeys; ++i)
+			free_subtree(tree, node_children[i]);
+	}
+	free_node(tree, node);
+}
+
+int cu_btree_new(cu_btree *tree, cu_alloc *alloc, size_t node_size)
+{
+	if (node_size < HEADER_SIZE + sizeof(void *) + 3 * BYTES_PER_KEY)
+		return -1;
+	size_t max_keys = (node_size - HEADER_SIZE - sizeof(void *))
+		/ BYTES_PER_KEY;
+	*tree = (cu_btree){
+		.root = NULL,
+		.nel = 0,
+		.max_keys = max_keys > UINT32_MAX ? UINT32_MAX : max_keys,
+		.node_size = node_size,
+		.alloc = alloc,
+	};
+	return 0;
+}
+
+void cu_btree_free(cu_btree *tree)
+{
+	if (tree->root == NULL)
+		return;
+	if (tree->alloc != NULL && tree->alloc->free == NULL)
+		return;
+	free_subtree(tree, tree->root);
+}
+
+// Copies `n` entries of `src` starting at `src_index` to `dst` at
+// `dst_index`. For inner nodes, the children right of each key are copied.
+static void copy_entries(const cu_btree *tree, cu_btree_node *dst,
+	uint32_t dst_index, const cu_btree_node *src, uint32_t src_index,
+	uint32_t n)
+{
+	memmove(prefixes(dst) + dst_index, prefixes(src) + src_index,
+		n * sizeof(uint64_t));
+	memmove(keys(tree, dst) + dst_index, keys(tree, src) + src_index,
+		n * sizeof(cu_str));
+	if (dst->leaf) {
+		memmove(values(tree, dst) + dst_index,
+			values(tree, src) + src_index, n * sizeof(void *));
+	} else {
+		memmove(children(tree, dst) + dst_index + 1,
+			children(tree, src) + src_index + 1,
+			n * sizeof(cu_btree_node *));
+	}
+}
+
+// Sets the key at `index` of `node`.
+static inline void set_key(const cu_btree *tree, cu_btree_node *node,
+	uint32_t index, uint64_t prefix, cu_str key)
+{
+	prefixes(node)[index] = prefix;
+	keys(tree, node)[index] = key;
+}
+
+// Copies the key at `src_index` of `src` to `dst_index` of `dst`.
+static inline void move_key(const cu_btree *tree, cu_btree_node *dst,
+	uint32_t dst_index, const cu_btree_node *src, uint32_t src_index)
+{
+	set_key(tree, dst, dst_index, prefixes(src)[src_index],
+		keys(tree, src)[src_index]);
+}
+
+// Splits the full child at `index` of `parent`, which isn't full.
+//
+// Returns 0 on success, -1 on failure.
+static int
+split_child(const cu_btree *tree, cu_btree_node *parent, uint32_t index)
+{
+	cu_btree_node *child = children(tree, parent)[index];
+	cu_btree_node *sibling = new_node(tree, child->leaf);
+	if (sibling == NULL)
+		return -1;
+
+	uint32_t mid = tree->max_keys / 2;
+	if (child->leaf) {
+		// the sibling's first key is copied up
+		sibling->nkeys = child->nkeys - mid;
+		copy_entries(tree, sibling, 0, child, mid, sibling->nkeys);
+		sibling->next = child->next;
+		child->next = sibling;
+	} else {
+		// the middle key moves up
+		sibling->nkeys = child->nkeys - mid - 1;
+		children(tree, sibling)[0] = children(tree, child)[mid + 1];
+		copy_entries(tree, sibling, 0, child, mid + 1, sibling->nkeys);
+	}
+	child->nkeys = mid;
+
+	copy_entries(tree, parent, index + 1, parent, index,
+		parent->nkeys - index);
+	if (child->leaf)
+		move_key(tree, parent, index, sibling, 0);
+	else
+		move_key(tree, parent, index, child, mid);
+	children(tree, parent)[index + 1] = sibling;
+	++parent->nkeys;
+	return 0;
+}
+
+static const cu_btree_node *
+find_leaf(const cu_btree *tree, uint64_t prefix, cu_str key)
+{
+	const cu_btree_node *node = tree->root;
+	while (!node->leaf) {
+		uint32_t index = search(tree, node, prefix, key, true);
+		node = children(tree, node)[index];
+	}
+	return node;
+}
+
+void *cu_btree_at(const cu_btree *tree, cu_str key)
+{
+	if (tree->root == NULL)
+		return NULL;
+	uint64_t prefix = key_prefix(key);
+	const cu_btree_node *leaf = find_leaf(tree, prefix, key);
+	uint32_t index = search(tree, leaf, prefix, key, false);
+	if (!key_at(tree, leaf, index, prefix, key))
+		return NULL;
+	return values(tree, leaf)[index];
+}
+
+int cu_btree_insert(cu_btree *tree, cu_str key, void *value)
+{
+	if (tree->root == NULL) {
+		tree->root = new_node(tree, true);
+		if (tree->root == NULL)
+			return -1;
+	}
+	if (tree->root->nkeys == tree->max_keys) {
+		cu_btree_node *root = new_node(tree, false);
+		if (root == NULL)
+			return -1;
+		children(tree, root)[0] = tree->root;
+		if (split_child(tree, root, 0) != 0) {
+			free_node(tree, root);
+			return -1;
+		}
+		tree->root = root;
+	}
+
+	// Full nodes are split on the way down, so there's always room in the
+	// parent for a split.
+	uint64_t prefix = key_prefix(key);
+	cu_btree_node *node = tree->root;
+	while (!node->leaf) {
+		uint32_t index = search(tree, node, prefix, key, true);
+		cu_btree_node *child = children(tree, node)[index];
+		if (child->nkeys == tree->max_keys) {
+			if (split_child(tree, node, index) != 0)
+				return -1;
+			if (key_cmp(prefix, key, prefixes(node)[index],
+				keys(tree, node)[index]) >= 0)
+			{
+				++index;
+			}
+		}
+		node = children(tree, node)[index];
+	}
+
+	uint32_t index = search(tree, node, prefix, key, false);
+	if (key_at(tree, node, index, prefix, key)) {
+		values(tree, node)[index] = value;
+		return 0;
+	}
+	copy_entries(tree, node, index + 1, node, index, node->nkeys - index);
+	set_key(tree, node, index, prefix, key);
+	values(tree, node)[index] = value;
+	++node->nkeys;
+	++tree->nel;
+	return 0;
+}
+
+// Merges the child at `index + 1` of `parent` into the one at `index`.
+static void
+merge_children(const cu_btree *tree, cu_btree_node *parent, uint32_t index)
+{
+	cu_btree_node *left = children(tree, parent)[index];
+	cu_btree_node *right = children(tree, parent)[index + 1];
+	if (left->leaf) {
+		copy_entries(tree, left, left->nkeys, right, 0, right->nkeys);
+		left->nkeys += right->nkeys;
+		left->next = right->next;
+	} else {
+		// the separating key comes back down
+		move_key(tree, left, left->nkeys, parent, index);
+		children(tree, left)[left->nkeys + 1] =
+			children(tree, right)[0];
+		copy_entries(tree, left, left->nkeys + 1, right, 0,
+			right->nkeys);
+		left->nkeys += right->nkeys + 1;
+	}
+	copy_entries(tree, parent, index, parent, index + 1,
+		parent->nkeys - index - 1);
+	--parent->nkeys;
+	free_node(tree, right);
+}
+
+// Moves the last entry of the child left of `index` into the one at `index`.
+static void
+borrow_left(const cu_btree *tree, cu_btree_node *parent, uint32_t index)
+{
+	cu_btree_node *left = children(tree, parent)[index - 1];
+	cu_btree_node *child = children(tree, parent)[index];
+	if (child->leaf) {
+		copy_entries(tree, child, 1, child, 0, child->nkeys);
+		move_key(tree, child, 0, left, left->nkeys - 1);
+		values(tree, child)[0] = values(tree, left)[left->nkeys - 1];
+		move_key(tree, parent, index - 1, child, 0);
+	} else {
+		cu_btree_node **child_children = children(tree, child);
+		copy_entries(tree, child, 1, child, 0, child->nkeys);
+		child_children[1] = child_children[0];
+		move_key(tree, child, 0, parent, index - 1);
+		child_children[0] = children(tree, left)[left->nkeys];
+		move_key(tree, parent, index - 1, left, left->nkeys - 1);
+	}
+	++child->nkeys;
+	--left->nkeys;
+}
+
+// Moves the first entry of the child right of `index` into the one at
+// `index`.
+static void
+borrow_right(const cu_btree *tree, cu_btree_node *parent, uint32_t index)
+{
+	cu_btree_node *child = children(tree, parent)[index];
+	cu_btree_node *right = children(tree, parent)[index + 1];
+	if (child->leaf) {
+		move_key(tree, child, child->nkeys, right, 0);
+		values(tree, child)[child->nkeys] = values(tree, right)[0];
+		copy_entries(tree, right, 0, right, 1, right->nkeys - 1);
+		move_key(tree, parent, index, right, 0);
+	} else {
+		cu_btree_node **right_children = children(tree, right);
+		move_key(tree, child, child->nkeys, parent, index);
+		children(tree, child)[child->nkeys + 1] = right_children[0];
+		move_key(tree, parent, index, right, 0);
+		right_children[0] = right_children[1];
+		copy_entries(tree, right, 0, right, 1, right->nkeys - 1);
+	}
+	++child->nkeys;
+	--right->nkeys;
+}
+
+// Makes sure the child at `index` of `parent` has more than the minimum
+// number of keys, so one can be erased from under it.
+//
+// Returns the index of the child that now covers the same keys.
+static uint32_t
+fill_child(const cu_btree *tree, cu_btree_node *parent, uint32_t index)
+{
+	cu_btree_node **parent_children = children(tree, parent);
+	if (index > 0 && parent_children[index - 1]->nkeys > min_keys(tree)) {
+		borrow_left(tree, parent, index);
+		return index;
+	}
+	if (index < parent->nkeys
+		&& parent_children[index + 1]->nkeys > min_keys(tree))
+	{
+		borrow_right(tree, parent, index);
+		return index;
+	}
+	if (index < parent->nkeys) {
+		merge_children(tree, parent, index);
+		return index;
+	}
+	merge_children(tree, parent, index - 1);
+	return index - 1;
+}
+
+void *cu_btree_erase(cu_btree *tree, cu_str key)
+{
+	if (tree->root == NULL)
+		return NULL;
+
+	// Nodes with the minimum number of keys are filled up on the way down,
+	// so there's always a key to spare if one gets merged away below.
+	//
+	// Keys aren't copied, so the key can't be left behind as a separator
+	// once it's erased. There's at most one, right before the child the
+	// key is under, and it's only ever moved down by filling.
+	uint64_t prefix = key_prefix(key);
+	cu_btree_node *node = tree->root;
+	cu_btree_node *sep_node = NULL;
+	uint32_t sep_index = 0;
+	while (!node->leaf) {
+		uint32_t index = search(tree, node, prefix, key, true);
+		if (children(tree, node)[index]->nkeys <= min_keys(tree))
+			index = fill_child(tree, node, index);
+		if (index > 0 && key_at(tree, node, index - 1, prefix, key)) {
+			sep_node = node;
+			sep_index = index - 1;
+		}
+		cu_btree_node *child = children(tree, node)[index];
+		if (node == tree->root && node->nkeys == 0) {
+			// the root's last two children got merged
+			tree->root = child;
+			free_node(tree, node);
+		}
+		node = child;
+	}
+
+	uint32_t index = search(tree, node, prefix, key, false);
+	if (!key_at(tree, node, index, prefix, key))
+		return NULL;
+	void *value = values(tree, node)[index];
+	copy_entries(tree, node, index, node, index + 1,
+		node->nkeys - index - 1);
+	--node->nkeys;
+	--tree->nel;
+	// the separator was the smallest key under it, and now the next one is
+	if (sep_node != NULL)
+		move_key(tree, sep_node, sep_index, node, 0);
+	return value;
+}
+
+// The smallest key under `node`.
+static const cu_btree_node *
+first_leaf(const cu_btree *tree, const cu_btree_node *node)
+{
+	while (!node->leaf)
+		node = children(tree, node)[0];
+	return node;
+}
+
+int cu_btree_build(cu_btree *tree, cu_alloc *alloc, size_t node_size,
+	const cu_str *keys_in, void *const *values_in, size_t n)
+{
+	if (cu_btree_new(tree, alloc, node_size) != 0)
+		return -1;
+	for (size_t i = 1; i < n; ++i) {
+		if (cu_str_cmp(keys_in[i - 1], keys_in[i]) >= 0)
+			return -1;
+	}
+	if (n == 0)
+		return 0;
+
+	// Each level is spread evenly over as few nodes as possible, which
+	// leaves every node at least half full.
+	size_t max_keys = tree->max_keys;
+	size_t nleaves = (n + max_keys - 1) / max_keys;
+	cu_btree_node **level =
+		cu_allocarray(nleaves, sizeof(cu_btree_node *), alloc);
+	cu_btree_node **next_level =
+		cu_allocarray(nleaves, sizeof(cu_btree_node *), alloc);
+	if (level == NULL || next_level == NULL)
+		goto fail_arrays;
+
+	size_t pos = 0;
+	for (size_t i = 0; i < nleaves; ++i) {
+		size_t count = n / nleaves + (i < n % nleaves);
+		cu_btree_node *leaf = new_node(tree, true);
+		if (leaf == NULL) {
+			for (size_t j = 0; j < i; ++j)
+				free_node(tree, level[j]);
+			goto fail_arrays;
+		}
+		for (size_t j = 0; j < count; ++j, ++pos) {
+			set_key(tree, leaf, j, key_prefix(keys_in[pos]),
+				keys_in[pos]);
+			values(tree, leaf)[j] = values_in[pos];
+		}
+		leaf->nkeys = count;
+		if (i > 0)
+			level[i - 1]->next = leaf;
+		level[i] = leaf;
+	}
+
+	size_t nnodes = nleaves;
+	while (nnodes > 1) {
+		size_t nparents = (nnodes + max_keys) / (max_keys + 1);
+		size_t child = 0;
+		for (size_t i = 0; i < nparents; ++i) {
+			size_t count = nnodes / nparents
+				+ (i < nnodes % nparents);
+			cu_btree_node *parent = new_node(tree, false);
+			if (parent == NULL) {
+				// everything built so far is under these
+				for (size_t j = 0; j < i; ++j)
+					free_subtree(tree, next_level[j]);
+				for (size_t j = child; j < nnodes; ++j)
+					free_subtree(tree, level[j]);
+				goto fail_arrays;
+			}
+			cu_btree_node **parent_children =
+				children(tree, parent);
+			parent_children[0] = level[child++];
+			for (size_t j = 1; j < count; ++j, ++child) {
+				const cu_btree_node *leaf =
+					first_leaf(tree, level[child]);
+				move_key(tree, parent, j - 1, leaf, 0);
+				parent_children[j] = level[child];
+			}
+			parent->nkeys = count - 1;
+			next_level[i] = parent;
+		}
+		cu_btree_node **tmp = level;
+		level = next_level;
+		next_level = tmp;
+		nnodes = nparents;
+	}
+	tree->root = level[0];
+	tree->nel = n;
+	cu_freearray(level, nleaves, sizeof(cu_btree_node *), alloc);
+	cu_freearray(next_level, nleaves, sizeof(cu_btree_node *), alloc);
+	return 0;
+
+fail_arrays:
+	cu_freearray(level, nleaves, sizeof(cu_btree_node *), alloc);
+	cu_freearray(next_level, nleaves, sizeof(cu_btree_node *), alloc);
+	return -1;
+}
+
+cu_btree_iter cu_btree_begin(const cu_btree *tree)
+{
+	cu_btree_iter iter = {
+		.tree = tree,
+		.bound_kind = CU_BTREE_UNBOUNDED,
+	};
+	if (tree->root != NULL)
+		iter.leaf = first_leaf(tree, tree->root);
+	return iter;
+}
+
+cu_btree_iter cu_btree_lower_bound(const cu_btree *tree, cu_str key)
+{
+	cu_btree_iter iter = {
+		.tree = tree,
+		.bound_kind = CU_BTREE_UNBOUNDED,
+	};
+	if (tree->root == NULL)
+		return iter;
+	uint64_t prefix = key_prefix(key);
+	iter.leaf = find_leaf(tree, prefix, key);
+	iter.index = search(tree, iter.leaf, prefix, key, false);
+	return iter;
+}
+
+cu_btree_iter cu_btree_range(const cu_btree *tree, cu_str lo, cu_str hi)
+{
+	cu_btree_iter iter = cu_btree_lower_bound(tree, lo);
+	iter.bound_kind = CU_BTREE_BEFORE;
+	iter.bound = hi;
+	return iter;
+}
+
+cu_btree_iter cu_btree_prefix(const cu_btree *tree, cu_str prefix)
+{
+	cu_btree_iter iter = cu_btree_lower_bound(tree, prefix);
+	iter.bound_kind = CU_BTREE_PREFIX;
+	iter.bound = prefix;
+	return iter;
+}
+
+bool cu_btree_next(cu_btree_iter *iter, cu_str *key, void **value)
+{
+	const cu_btree *tree = iter->tree;
+	// only the root can be an empty leaf, and it's the only leaf then
+	while (iter->leaf != NULL && iter->index == iter->leaf->nkeys) {
+		iter->leaf = iter->leaf->next;
+		iter->index = 0;
+	}
+	if (iter->leaf == NULL)
+		return false;
+
+	cu_str cur = keys(tree, iter->leaf)[iter->index];
+	switch (iter->bound_kind) {
+	case CU_BTREE_UNBOUNDED:
+		break;
+	case CU_BTREE_BEFORE:
+		if (cu_str_cmp(cur, iter->bound) >= 0)
+			goto done;
+		break;
+	case CU_BTREE_PREFIX:
+		if (cur.len < iter->bound.len || memcmp(cur.buf,
+			iter->bound.buf, iter->bound.len) != 0)
+		{
+			goto done;
+		}
+		break;
+	}
+	if (key != NULL)
+		*key = cur;
+	if (value != NULL)
+		*value = values(tree, iter->leaf)[iter->index];
+	++iter->index;
+	return true;
+
+done:
+	iter->leaf = NULL;
+	return false;
+}
@@ -5,10 +5,130 @@
 // SPDX-License-Identifier: MPL-2.0
 
 #include <cu/hashmap.h>
+#include <cu/bitmanip.h>
 #include <assert.h>
+
+#ifdef CU_HM_SWISS_SSE2
+#	include <emmintrin.h>
+#endif
 #define FILL_FACTOR 2
 #define MIN_CAPACITY 16
 
+// number of keys cu_hm_at_many keeps in flight at once
+#define BATCH_SIZE 16
+
+#if defined(__GNUC__) || defined(__clang__)
+#	define PREFETCH(PTR) __builtin_prefetch((PTR))
+#elif defined(_MSC_VER)
+#	include <intrin.h>
+#	define PREFETCH(PTR) _mm_prefetch((const char *)(PTR), _MM_HINT_T0)
+#else
+#	define PREFETCH(PTR) ((void)(PTR))
+#endif
+
+#ifdef CU_HM_STATS
+#include <time.h>
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
+}
+#endif
+
+// The stats_* functions compile to nothing unless CU_HM_STATS is defined.
+
+static inline void stats_probe_len(cu_hm *map, uint64_t len)
+{
+#ifdef CU_HM_STATS
+	cu_hm_stats *stats = &map->stats;
+	++stats->probe_lengths[len < CU_HM_STATS_PROBE_LENGTHS
+		? len : CU_HM_STATS_PROBE_LENGTHS - 1];
+	stats->total_probe_length += len;
+	if (len > stats->max_probe_length)
+		stats->max_probe_length = len;
+	++stats->probes;
+#else
+	(void)map;
+	(void)len;
+#endif
+}
+
+static inline void stats_probe(cu_hm *map, const cu_hm_bucket *arr,
+	uint64_t capacity, const cu_hm_bucket *bucket, uint64_t hash)
+{
+	stats_probe_len(map,
+		((uint64_t)(bucket - arr) - hash) & (capacity - 1));
+}
+
+// `bytes` is negative when memory is freed
+static inline void stats_alloc_bytes(cu_hm *map, int64_t bytes)
+{
+#ifdef CU_HM_STATS
+	cu_hm_stats *stats = &map->stats;
+	stats->bytes_allocated += bytes;
+	if (stats->bytes_allocated > stats->peak_bytes_allocated)
+		stats->peak_bytes_allocated = stats->bytes_allocated;
+#else
+	(void)map;
+	(void)bytes;
+#endif
+}
+
+static inline void stats_alloc(cu_hm *map, int64_t nbuckets)
+{
+	stats_alloc_bytes(map, nbuckets * (int64_t)sizeof(cu_hm_bucket));
+}
+
+static inline uint64_t stats_resize_start(void)
+{
+#ifdef CU_HM_STATS
+	return now_ns();
+#else
+	return 0;
+#endif
+}
+
+static inline void stats_resize_end(cu_hm *map, uint64_t start,
+	uint64_t old_capacity, bool incremental)
+{
+#ifdef CU_HM_STATS
+	cu_hm_stats *stats = &map->stats;
+	cu_hm_resize_event event = {
+		.old_capacity = old_capacity,
+		.new_capacity = map->capacity,
+		.nel = map->nel,
+		.nanoseconds = now_ns() - start,
+		.incremental = incremental,
+	};
+	++stats->resizes;
+	stats->resize_nanoseconds += event.nanoseconds;
+	if (event.nanoseconds > stats->max_resize_nanoseconds)
+		stats->max_resize_nanoseconds = event.nanoseconds;
+	if (stats->on_resize != NULL)
+		stats->on_resize(&event, stats->on_resize_ctx);
+#else
+	(void)map;
+	(void)start;
+	(void)old_capacity;
+	(void)incremental;
+#endif
+}
+
+#ifdef CU_HM_STATS
+void cu_hm_stats_reset(cu_hm *map)
+{
+	cu_hm_stats *stats = &map->stats;
+	*stats = (cu_hm_stats){
+		.bytes_allocated = stats->bytes_allocated,
+		.peak_bytes_allocated = stats->peak_bytes_allocated,
+		.on_resize = stats->on_resize,
+		.on_resize_ctx = stats->on_resize_ctx,
+	};
+}
+#endif
+
 static inline uint64_t next_pwr_2(uint64_t val)
 {
 	--val;
@@ -22,106 +142,805 @@ static inline uint64_t next_pwr_2(uint64_t val)
 	return val;
 }
 
+// Swiss tables
+//
+// CU_HM_SWISS maps share everything but the probing with linear ones. Their
+// tables are `arr` plus `ctrl`, resized all at once, so `old_arr` is never
+// used.
+
+// control bytes
+//
+// full buckets store the low 7 bits of their hash, so the top bit tells
+// full buckets apart from empty or deleted ones
+#define CTRL_EMPTY ((uint8_t)0x80)
+#define CTRL_DELETED ((uint8_t)0xFE)
+
+static_assert(MIN_CAPACITY >= CU_HM_SWISS_GROUP,
+	"a table must hold at least one whole group");
+
+// Group matching
+//
+// Every match function returns a bitmask with one flag per control byte in
+// the group. The flag for byte `i` is bit `i << MASK_SHIFT`.
+#ifdef CU_HM_SWISS_SSE2
+
+#define MASK_SHIFT 0
+#define MASK_BITS 16
+
+typedef __m128i group;
+
+static inline group group_load(const uint8_t *ctrl)
+{
+	return _mm_loadu_si128((const __m128i *)ctrl);
+}
+static inline uint64_t group_match(group g, uint8_t tag)
+{
+	return (uint16_t)_mm_movemask_epi8(
+		_mm_cmpeq_epi8(g, _mm_set1_epi8((char)tag)));
+}
+static inline uint64_t group_match_empty(group g)
+{
+	return group_match(g, CTRL_EMPTY);
+}
+static inline uint64_t group_match_empty_or_deleted(group g)
+{
+	// only empty and deleted bytes have their top bit set
+	return (uint16_t)_mm_movemask_epi8(g);
+}
+
+#else // portable SWAR fallback
+
+#define MASK_SHIFT 3
+#define MASK_BITS 64
+#define LSBS UINT64_C(0x0101010101010101)
+#define MSBS UINT64_C(0x8080808080808080)
+
+typedef uint64_t group;
+
+static inline group group_load(const uint8_t *ctrl)
+{
+	// assembled byte-by-byte so byte `i` always lands in bits 8i..8i+7,
+	// compilers turn this into a single load on little-endian targets
+	uint64_t val = 0;
+	for (size_t i = 0; i < 8; ++i)
+		val |= (uint64_t)ctrl[i] << (i * 8);
+	return val;
+}
+static inline uint64_t group_match(group g, uint8_t tag)
+{
+	// sets the top bit of every zero byte of `x`
+	//
+	// this can give false positives in bytes above a true match, that's
+	// fine since every match gets its full hash checked anyways
+	uint64_t x = g ^ (LSBS * tag);
+	return (x - LSBS) & ~x & MSBS;
+}
+static inline uint64_t group_match_empty(group g)
+{
+	// empty is the only control byte with the top bit set and bit 1 clear
+	return g & (~g << 6) & MSBS;
+}
+static inline uint64_t group_match_empty_or_deleted(group g)
+{
+	return g & MSBS;
+}
+
+#endif // CU_HM_SWISS_SSE2
+
+static inline uint64_t mask_lowest(uint64_t mask)
+{
+	return cu_trailing_zeros(mask) >> MASK_SHIFT;
+}
+static inline uint64_t mask_leading(uint64_t mask)
+{
+	return (MASK_BITS - cu_bit_width(mask)) >> MASK_SHIFT;
+}
+
+static inline uint8_t swiss_tag(uint64_t hash)
+{
+	return hash & 0x7F;
+}
+static inline uint64_t swiss_pos(uint64_t hash)
+{
+	return hash >> 7;
+}
+
+static inline bool ctrl_is_full(uint8_t ctrl)
+{
+	return (ctrl & 0x80) == 0;
+}
+
+// Tables hold at most 7/8ths of their capacity.
+static inline uint64_t swiss_max_load(uint64_t capacity)
+{
+	return capacity - capacity / 8;
+}
+
+// The smallest capacity that fits `nel` elements.
+static inline uint64_t swiss_capacity_for(uint64_t nel)
+{
+	uint64_t capacity = MIN_CAPACITY;
+	while (swiss_max_load(capacity) < nel)
+		capacity *= 2;
+	return capacity;
+}
+
+// The first group of control bytes is mirrored after the end of the array, so
+// groups can be loaded starting from any bucket.
+static inline void
+set_ctrl(uint8_t *ctrl, uint64_t capacity, uint64_t index, uint8_t val)
+{
+	ctrl[index] = val;
+	if (index < CU_HM_SWISS_GROUP)
+		ctrl[capacity + index] = val;
+}
+
+// Frees the table, and counts it as freed.
+static void swiss_free_table(cu_hm *map)
+{
+	if (map->ctrl == NULL)
+		return;
+	cu_free(map->ctrl, map->capacity + CU_HM_SWISS_GROUP, map->alloc);
+	cu_freearray(map->arr, map->capacity, sizeof(cu_hm_bucket), map->alloc);
+	stats_alloc_bytes(map,
+		-(int64_t)(map->capacity + CU_HM_SWISS_GROUP));
+	stats_alloc(map, -(int64_t)map->capacity);
+}
+
+// Probes group-by-group with triangular steps, which visits every group
+// exactly once when the number of groups is a power of two.
+//
+// Returns the index of the first empty or deleted bucket for `hash`.
+static uint64_t
+swiss_find_slot(const uint8_t *ctrl, uint64_t capacity, uint64_t hash)
+{
+	uint64_t mask = capacity - 1;
+	uint64_t pos = swiss_pos(hash) & mask;
+	for (uint64_t stride = CU_HM_SWISS_GROUP; ;
+		stride += CU_HM_SWISS_GROUP
+	) {
+		assert(stride <= capacity + CU_HM_SWISS_GROUP);
+		uint64_t m =
+			group_match_empty_or_deleted(group_load(ctrl + pos));
+		if (m != 0)
+			return (pos + mask_lowest(m)) & mask;
+		pos = (pos + stride) & mask;
+	}
+}
+
+// Finds the bucket holding `key`, or returns NULL.
+static cu_hm_bucket *swiss_find(cu_hm *map, cu_str key, uint64_t hash)
+{
+	if (map->nel == 0)
+		return NULL;
+
+	uint64_t mask = map->capacity - 1;
+	uint64_t pos = swiss_pos(hash) & mask;
+	uint8_t tag = swiss_tag(hash);
+	cu_hm_bucket *found = NULL;
+	uint64_t stride = CU_HM_SWISS_GROUP;
+	for (;; stride += CU_HM_SWISS_GROUP) {
+		assert(stride <= map->capacity + CU_HM_SWISS_GROUP);
+		group g = group_load(map->ctrl + pos);
+		for (uint64_t m = group_match(g, tag); m != 0; m &= m - 1) {
+			cu_hm_bucket *bucket =
+				map->arr + ((pos + mask_lowest(m)) & mask);
+			if (bucket->hash == hash
+				&& cu_str_eq(bucket->key, key))
+			{
+				found = bucket;
+				goto done;
+			}
+		}
+		if (group_match_empty(g) != 0)
+			goto done;
+		pos = (pos + stride) & mask;
+	}
+done:
+	stats_probe_len(map, stride / CU_HM_SWISS_GROUP - 1);
+	return found;
+}
+
+// Takes the first free bucket for `hash`. The table must have room for it.
+static cu_hm_bucket *swiss_claim(cu_hm *map, uint64_t hash)
+{
+	uint64_t index = swiss_find_slot(map->ctrl, map->capacity, hash);
+	if (map->ctrl[index] == CTRL_EMPTY)
+		--map->growth_left;
+	set_ctrl(map->ctrl, map->capacity, index, swiss_tag(hash));
+	return map->arr + index;
+}
+
+static inline void swiss_prefetch_ctrl(const cu_hm *map, uint64_t hash)
+{
+	if (map->capacity != 0)
+		PREFETCH(map->ctrl + (swiss_pos(hash) & (map->capacity - 1)));
+}
+
+// Prefetches the first bucket in the home group that looks like a match.
+static inline void swiss_prefetch_bucket(const cu_hm *map, uint64_t hash)
+{
+	if (map->capacity == 0)
+		return;
+	uint64_t mask = map->capacity - 1;
+	uint64_t pos = swiss_pos(hash) & mask;
+	uint64_t m = group_match(group_load(map->ctrl + pos), swiss_tag(hash));
+	if (m != 0)
+		PREFETCH(map->arr + ((pos + mask_lowest(m)) & mask));
+}
+
+// Moves every bucket into a fresh table of `new_capacity` buckets, dropping
+// all deleted markers along the way.
+static int swiss_rehash(cu_hm *map, uint64_t new_capacity)
+{
+	uint64_t start = stats_resize_start();
+	uint64_t old_capacity = map->capacity;
+	uint8_t *ctrl = cu_malloc(new_capacity + CU_HM_SWISS_GROUP, map->alloc);
+	if (ctrl == NULL)
+		return -1;
+	cu_hm_bucket *arr =
+		cu_allocarray(new_capacity, sizeof(cu_hm_bucket), map->alloc);
+	if (arr == NULL) {
+		cu_free(ctrl, new_capacity + CU_HM_SWISS_GROUP, map->alloc);
+		return -1;
+	}
+	memset(ctrl, CTRL_EMPTY, new_capacity + CU_HM_SWISS_GROUP);
+	stats_alloc_bytes(map, new_capacity + CU_HM_SWISS_GROUP);
+	stats_alloc(map, new_capacity);
+
+	// hashes are cached in the buckets, so keys are never rehashed
+	for (uint64_t i = 0; i < map->capacity; ++i) {
+		if (!ctrl_is_full(map->ctrl[i]))
+			continue;
+		uint64_t hash = map->arr[i].hash;
+		uint64_t index = swiss_find_slot(ctrl, new_capacity, hash);
+		set_ctrl(ctrl, new_capacity, index, swiss_tag(hash));
+		arr[index] = map->arr[i];
+	}
+
+	swiss_free_table(map);
+	map->ctrl = ctrl;
+	map->arr = arr;
+	map->capacity = new_capacity;
+	map->growth_left = swiss_max_load(new_capacity) - map->nel;
+	stats_resize_end(map, start, old_capacity, false);
+	return 0;
+}
+
+static int swiss_reserve(cu_hm *map, uint64_t nel)
+{
+	if (nel <= map->nel + map->growth_left)
+		return 0;
+
+	// If deleted markers are what's using up the room, rehashing at the
+	// same size is enough. Otherwise the table has to grow.
+	uint64_t new_capacity = map->capacity;
+	if (new_capacity == 0 || nel > swiss_max_load(new_capacity) / 2) {
+		new_capacity = new_capacity * 2;
+		if (new_capacity < swiss_capacity_for(nel))
+			new_capacity = swiss_capacity_for(nel);
+	}
+	return swiss_rehash(map, new_capacity);
+}
+
+static int swiss_shrink_to_fit(cu_hm *map)
+{
+	if (map->nel == 0) {
+		swiss_free_table(map);
+		map->ctrl = NULL;
+		map->arr = NULL;
+		map->capacity = 0;
+		map->growth_left = 0;
+		return 0;
+	}
+	uint64_t new_capacity = swiss_capacity_for(map->nel);
+	if (new_capacity >= map->capacity)
+		return 0;
+	return swiss_rehash(map, new_capacity);
+}
+
+static void swiss_erase_at(cu_hm *map, uint64_t index)
+{
+	uint64_t mask = map->capacity - 1;
+
+	// If there was never a full group's worth of buckets in a row around
+	// this one, no probe sequence could have continued past it, so it can
+	// be marked empty instead of deleted.
+	uint64_t empty_before = group_match_empty(group_load(
+		map->ctrl + ((index - CU_HM_SWISS_GROUP) & mask)));
+	uint64_t empty_after = group_match_empty(group_load(map->ctrl + index));
+	bool was_never_full = empty_before != 0 && empty_after != 0 &&
+		mask_lowest(empty_after) + mask_leading(empty_before)
+			< CU_HM_SWISS_GROUP;
+
+	if (was_never_full) {
+		set_ctrl(map->ctrl, map->capacity, index, CTRL_EMPTY);
+		++map->growth_left;
+	} else {
+		set_ctrl(map->ctrl, map->capacity, index, CTRL_DELETED);
+	}
+}
+
 int cu_hm_new(cu_hm *map, cu_alloc *alloc)
+{
+	return cu_hm_new_hasher(map, alloc, CU_HM_SIPHASH13);
+}
+
+int cu_hm_new_hasher(cu_hm *map, cu_alloc *alloc, cu_hm_hasher hasher)
+{
+	return cu_hm_new_engine(map, alloc, hasher, CU_HM_LINEAR);
+}
+
+int cu_hm_new_engine(cu_hm *map, cu_alloc *alloc, cu_hm_hasher hasher,
+	cu_hm_engine engine)
 {
 	map->arr = NULL;
 	map->capacity = 0;
 	map->nel = 0;
 	map->alloc = alloc;
+	map->old_arr = NULL;
+	map->old_capacity = 0;
+	map->migrate_pos = 0;
+	map->incremental = false;
+	map->hasher = hasher;
+	map->engine = engine;
+	map->ctrl = NULL;
+	map->growth_left = 0;
+#ifdef CU_HM_STATS
+	map->stats = (cu_hm_stats){0};
+#endif
 	return cu_siphash_init(&map->key);
 
 }
 void cu_hm_free(cu_hm *map)
 {
-	cu_freearray(map->arr, map->nel, sizeof(cu_hm_bucket), map->alloc);
+	if (map->ctrl != NULL) {
+		cu_free(map->ctrl, map->capacity + CU_HM_SWISS_GROUP,
+			map->alloc);
+	}
+	cu_freearray(map->arr, map->capacity, sizeof(cu_hm_bucket), map->alloc);
+	cu_freearray(map->old_arr, map->old_capacity, sizeof(cu_hm_bucket),
+		map->alloc);
 }
 
-static cu_hm_bucket *cu_hm_find_bucket(cu_hm *map, cu_str str)
+int cu_hm_clone(cu_hm *dst, const cu_hm *src)
 {
-	if (map->capacity == 0)
+	*dst = *src;
+	dst->arr = NULL;
+	dst->old_arr = NULL;
+	if (src->capacity != 0) {
+		dst->arr = cu_allocarray(src->capacity, sizeof(cu_hm_bucket),
+			src->alloc);
+		if (dst->arr == NULL)
+			return -1;
+		memcpy(dst->arr, src->arr,
+			src->capacity * sizeof(cu_hm_bucket));
+	}
+	if (src->old_capacity != 0) {
+		dst->old_arr = cu_allocarray(src->old_capacity,
+			sizeof(cu_hm_bucket), src->alloc);
+		if (dst->old_arr == NULL) {
+			cu_freearray(dst->arr, dst->capacity,
+				sizeof(cu_hm_bucket), dst->alloc);
+			return -1;
+		}
+		memcpy(dst->old_arr, src->old_arr,
+			src->old_capacity * sizeof(cu_hm_bucket));
+	}
+	dst->ctrl = NULL;
+	if (src->ctrl != NULL) {
+		dst->ctrl = cu_malloc(src->capacity + CU_HM_SWISS_GROUP,
+			src->alloc);
+		if (dst->ctrl == NULL) {
+			cu_freearray(dst->arr, dst->capacity,
+				sizeof(cu_hm_bucket), dst->alloc);
+			return -1;
+		}
+		memcpy(dst->ctrl, src->ctrl,
+			src->capacity + CU_HM_SWISS_GROUP);
+	}
+#ifdef CU_HM_STATS
+	cu_hm_stats_reset(dst);
+#endif
+	return 0;
+}
+
+// Finds the bucket holding `str`, or the empty bucket where it would go.
+static cu_hm_bucket *
+cu_hm_find_bucket(cu_hm_bucket *arr, uint64_t capacity, cu_str str,
+	uint64_t hash)
+{
+	if (capacity == 0)
 		return NULL;
 
-	uint64_t index = cu_str_hash(str, &map->key) & (map->capacity - 1);
-	uint64_t inc = 0;
-	for (; ; index = (index + ++inc) & (map->capacity - 1)) {
-		assert(inc < map->capacity);
-		if (map->arr[index].key.buf == NULL)
-			return map->arr + index;
+	uint64_t mask = capacity - 1;
+	uint64_t index = hash & mask;
+	for (uint64_t inc = 0; ; ++inc, index = (index + 1) & mask) {
+		assert(inc < capacity);
+		cu_hm_bucket *bucket = arr + index;
+		if (bucket->key.buf == NULL)
+			return bucket;
 
-		if (cu_str_eq(map->arr[index].key, str))
-			return map->arr + index;
+		// most mismatches are rejected here without touching the key
+		if (bucket->hash == hash && cu_str_eq(bucket->key, str))
+			return bucket;
 	}
 }
 
-void *cu_hm_at(cu_hm *map, cu_str key)
+// Finds the bucket holding `str` in either table, or returns NULL.
+static cu_hm_bucket *cu_hm_lookup(cu_hm *map, cu_str str, uint64_t hash)
 {
-	cu_hm_bucket *el = cu_hm_find_bucket(map, key);
+	if (map->nel == 0)
+		return NULL;
+	if (map->engine == CU_HM_SWISS)
+		return swiss_find(map, str, hash);
+
+	cu_hm_bucket *el =
+		cu_hm_find_bucket(map->arr, map->capacity, str, hash);
 	if (el == NULL)
 		return NULL;
-	
-	if (el->key.buf == NULL) {
+	stats_probe(map, map->arr, map->capacity, el, hash);
+	if (el->key.buf != NULL)
+		return el;
+
+	if (map->old_arr == NULL)
+		return NULL;
+	el = cu_hm_find_bucket(map->old_arr, map->old_capacity, str, hash);
+	stats_probe(map, map->old_arr, map->old_capacity, el, hash);
+	if (el->key.buf != NULL)
+		return el;
+	return NULL;
+}
+
+void *cu_hm_at_hashed(cu_hm *map, cu_str key, uint64_t hash)
+{
+	cu_hm_bucket *el = cu_hm_lookup(map, key, hash);
+	if (el == NULL)
 		return NULL;
-	}
-	
 	return el->value;
 }
 
+static inline void
+cu_hm_prefetch_home(cu_hm_bucket *arr, uint64_t capacity, uint64_t hash)
+{
+	if (capacity != 0)
+		PREFETCH(arr + (hash & (capacity - 1)));
+}
 
-void cu_hm_insert_unsafe(cu_hm *map, cu_str key, void *value)
+// Prefetches the key of the home bucket if it looks like it'll be compared.
+static inline void
+cu_hm_prefetch_key(cu_hm_bucket *arr, uint64_t capacity, uint64_t hash)
 {
-	cu_hm_bucket *bucket = cu_hm_find_bucket(map, key);
-	bucket->key = key;
-	bucket->value = value;
-	++map->nel;
+	if (capacity == 0)
+		return;
+	cu_hm_bucket *home = arr + (hash & (capacity - 1));
+	if (home->hash == hash && home->key.buf != NULL)
+		PREFETCH(home->key.buf);
+}
+
+void cu_hm_at_many(cu_hm *map, const cu_str *keys, size_t n, void **values)
+{
+	uint64_t hashes[BATCH_SIZE];
+	for (size_t start = 0; start < n; start += BATCH_SIZE) {
+		size_t batch = n - start < BATCH_SIZE ? n - start : BATCH_SIZE;
+		const cu_str *batch_keys = keys + start;
+
+		// every stage touches a different cache line per key, so
+		// running each stage across the whole batch lets the misses
+		// overlap instead of happening one after another
+		for (size_t i = 0; i < batch; ++i) {
+			hashes[i] = cu_hm_hash(map, batch_keys[i]);
+			if (map->engine == CU_HM_SWISS) {
+				swiss_prefetch_ctrl(map, hashes[i]);
+				continue;
+			}
+			cu_hm_prefetch_home(map->arr, map->capacity, hashes[i]);
+			cu_hm_prefetch_home(map->old_arr, map->old_capacity,
+				hashes[i]);
+		}
+		for (size_t i = 0; i < batch; ++i) {
+			if (map->engine == CU_HM_SWISS)
+				swiss_prefetch_bucket(map, hashes[i]);
+			else
+				cu_hm_prefetch_key(map->arr, map->capacity,
+					hashes[i]);
+		}
+		for (size_t i = 0; i < batch; ++i) {
+			cu_hm_bucket *el =
+				cu_hm_lookup(map, batch_keys[i], hashes[i]);
+			values[start + i] = el == NULL ? NULL : el->value;
+		}
+	}
+}
+
+// Places a bucket that is known not to be in the table yet.
+// Only the cached hash is looked at, keys are never compared.
+static void
+cu_hm_move_unsafe(cu_hm_bucket *arr, uint64_t capacity,
+	const cu_hm_bucket *bucket)
+{
+	uint64_t mask = capacity - 1;
+	uint64_t index = bucket->hash & mask;
+	while (arr[index].key.buf != NULL)
+		index = (index + 1) & mask;
+	arr[index] = *bucket;
+}
+
+// Empties the bucket at `hole` using backward-shift deletion (Knuth's
+// Algorithm R).
+//
+// Walks the rest of the cluster, pulling back every element that is allowed
+// to sit in the hole, so no tombstones are ever left behind. Elements only
+// ever move into the hole, never before it.
+static void cu_hm_erase_at(cu_hm_bucket *arr, uint64_t capacity, uint64_t hole)
+{
+	uint64_t mask = capacity - 1;
+	for (uint64_t i = (hole + 1) & mask;
+		arr[i].key.buf != NULL;
+		i = (i + 1) & mask
+	) {
+		uint64_t home = arr[i].hash & mask;
+		// the element can move only if its home isn't cyclically
+		// within (hole, i]
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			arr[hole] = arr[i];
+			hole = i;
+		}
+	}
+	arr[hole] = (cu_hm_bucket){.key = CU_NIL_STR};
+}
+
+// Moves up to `nsteps` buckets' worth of the old table into the new one.
+//
+// Buckets are taken from the front of the old table. Since backward-shift
+// deletion never moves elements before the hole, everything before
+// `migrate_pos` stays empty, and the old table stays valid for lookups.
+static void cu_hm_migrate(cu_hm *map, uint64_t nsteps)
+{
+	if (map->old_arr == NULL)
+		return;
+
+	for (; nsteps > 0 && map->migrate_pos < map->old_capacity; --nsteps) {
+		cu_hm_bucket *bucket = map->old_arr + map->migrate_pos;
+		if (bucket->key.buf == NULL) {
+			++map->migrate_pos;
+			continue;
+		}
+		// another element may get shifted into this spot, so the
+		// position isn't advanced
+		cu_hm_move_unsafe(map->arr, map->capacity, bucket);
+		cu_hm_erase_at(map->old_arr, map->old_capacity,
+			map->migrate_pos);
+	}
+	if (map->migrate_pos == map->old_capacity) {
+		cu_freearray(map->old_arr, map->old_capacity,
+			sizeof(cu_hm_bucket), map->alloc);
+		stats_alloc(map, -(int64_t)map->old_capacity);
+		map->old_arr = NULL;
+		map->old_capacity = 0;
+		map->migrate_pos = 0;
+	}
+}
+
+void cu_hm_set_incremental(cu_hm *map, bool incremental)
+{
+	if (!incremental)
+		cu_hm_migrate(map, UINT64_MAX);
+	map->incremental = incremental;
+}
+
+// Moves everything into a new table of `new_capacity` buckets, or only
+// starts moving if `incremental` is set.
+static int
+cu_hm_resize(cu_hm *map, uint64_t new_capacity, bool incremental)
+{
+	uint64_t start = stats_resize_start();
+	uint64_t old_capacity = map->capacity;
+	cu_hm_bucket *new_arr =
+		cu_allocarray(new_capacity, sizeof(cu_hm_bucket), map->alloc);
+	if (new_arr == NULL)
+		return -1;
+	memset(new_arr, 0, new_capacity * sizeof(cu_hm_bucket));
+	stats_alloc(map, new_capacity);
+
+	// only one resize can be in progress at a time
+	cu_hm_migrate(map, UINT64_MAX);
+
+	if (incremental && map->nel != 0) {
+		// the old table gets moved over by later inserts and erases
+		map->old_arr = map->arr;
+		map->old_capacity = map->capacity;
+		map->migrate_pos = 0;
+		map->arr = new_arr;
+		map->capacity = new_capacity;
+		stats_resize_end(map, start, old_capacity, true);
+		return 0;
+	}
+
+	// hashes are cached, so growing never rehashes a key
+	for (uint64_t i = 0; i < map->capacity; ++i) {
+		if (map->arr[i].key.buf != NULL)
+			cu_hm_move_unsafe(new_arr, new_capacity, map->arr + i);
+	}
+
+	cu_freearray(map->arr, map->capacity, sizeof(cu_hm_bucket), map->alloc);
+	stats_alloc(map, -(int64_t)map->capacity);
+	map->arr = new_arr;
+	map->capacity = new_capacity;
+	stats_resize_end(map, start, old_capacity, false);
+	return 0;
 }
 
 int cu_hm_reserve(cu_hm *map, uint64_t nel)
 {
+	if (map->engine == CU_HM_SWISS)
+		return swiss_reserve(map, nel);
 	if (nel <= map->capacity / FILL_FACTOR) {
 		return 0;
 	}
 	uint64_t new_capacity = next_pwr_2(nel * FILL_FACTOR);
 	if (map->capacity == 0 && new_capacity < MIN_CAPACITY)
 		new_capacity = MIN_CAPACITY;
-	
-	cu_hm new_map = {
-		.arr = cu_allocarray(new_capacity, sizeof(cu_hm_bucket), map->alloc),
-		.capacity = new_capacity,
-		.nel = 0,
-		.alloc = map->alloc,
-		.key = map->key,
-	};
-	if (new_map.arr == NULL)
+	return cu_hm_resize(map, new_capacity, map->incremental);
+}
+
+int cu_hm_shrink_to_fit(cu_hm *map)
+{
+	if (map->engine == CU_HM_SWISS)
+		return swiss_shrink_to_fit(map);
+	cu_hm_migrate(map, UINT64_MAX);
+	if (map->nel == 0) {
+		cu_freearray(map->arr, map->capacity, sizeof(cu_hm_bucket),
+			map->alloc);
+		stats_alloc(map, -(int64_t)map->capacity);
+		map->arr = NULL;
+		map->capacity = 0;
+		return 0;
+	}
+	uint64_t new_capacity = next_pwr_2(map->nel * FILL_FACTOR);
+	if (new_capacity < MIN_CAPACITY)
+		new_capacity = MIN_CAPACITY;
+	if (new_capacity >= map->capacity)
+		return 0;
+	return cu_hm_resize(map, new_capacity, false);
+}
+
+// Returns the bucket holding `key` in the current table, putting it there
+// with a NULL value if it isn't there yet. The table must have room for it.
+static cu_hm_bucket *cu_hm_place(cu_hm *map, cu_str key, uint64_t hash)
+{
+	cu_hm_bucket *bucket;
+	if (map->engine == CU_HM_SWISS) {
+		bucket = swiss_find(map, key, hash);
+		if (bucket != NULL)
+			return bucket;
+		bucket = swiss_claim(map, hash);
+	} else {
+		bucket = cu_hm_find_bucket(map->arr, map->capacity, key, hash);
+		stats_probe(map, map->arr, map->capacity, bucket, hash);
+		if (bucket->key.buf != NULL)
+			return bucket;
+	}
+	bucket->key = key;
+	bucket->value = NULL;
+	bucket->hash = hash;
+	++map->nel;
+	return bucket;
+}
+
+int cu_hm_build(cu_hm *map, cu_alloc *alloc, const cu_str *keys,
+	void *const *values, size_t n)
+{
+	return cu_hm_build_hasher(map, alloc, keys, values, n,
+		CU_HM_SIPHASH13);
+}
+
+int cu_hm_build_hasher(cu_hm *map, cu_alloc *alloc, const cu_str *keys,
+	void *const *values, size_t n, cu_hm_hasher hasher)
+{
+	return cu_hm_build_engine(map, alloc, keys, values, n, hasher,
+		CU_HM_LINEAR);
+}
+
+int cu_hm_build_engine(cu_hm *map, cu_alloc *alloc, const cu_str *keys,
+	void *const *values, size_t n, cu_hm_hasher hasher,
+	cu_hm_engine engine)
+{
+	if (cu_hm_new_engine(map, alloc, hasher, engine) != 0
+		|| cu_hm_reserve(map, n) != 0)
+	{
 		return -1;
-	memset(new_map.arr, 0, new_capacity * sizeof(cu_hm_bucket));
-	
-	cu_hm_iter it = cu_hm_begin(map);
-	cu_hm_bucket *cur = NULL;
-	while ((cur = cu_hm_next(&it)) != NULL) {
-		cu_hm_insert_unsafe(&new_map, cur->key, cur->value);
 	}
 
-	cu_freearray(map->arr, map->capacity, sizeof(cu_hm_bucket), map->alloc);
-	*map = new_map;
+	// The table is big enough for every key even if none are duplicates,
+	// so keys go straight into their buckets. Like cu_hm_at_many, this
+	// hashes a batch of keys and prefetches their buckets before placing
+	// any of them.
+	uint64_t hashes[BATCH_SIZE];
+	for (size_t start = 0; start < n; start += BATCH_SIZE) {
+		size_t batch = n - start < BATCH_SIZE ? n - start : BATCH_SIZE;
+		for (size_t i = 0; i < batch; ++i) {
+			hashes[i] = cu_hm_hash(map, keys[start + i]);
+			if (map->engine == CU_HM_SWISS)
+				swiss_prefetch_ctrl(map, hashes[i]);
+			else
+				cu_hm_prefetch_home(map->arr, map->capacity,
+					hashes[i]);
+		}
+		for (size_t i = 0; i < batch; ++i) {
+			cu_hm_bucket *bucket =
+				cu_hm_place(map, keys[start + i], hashes[i]);
+			bucket->value = values[start + i];
+		}
+	}
 	return 0;
 }
 
-int cu_hm_insert(cu_hm *map, cu_str key, void *value)
+cu_hm_bucket *
+cu_hm_get_or_insert_hashed(cu_hm *map, cu_str key, uint64_t hash,
+	bool *inserted)
 {
+	cu_hm_migrate(map, CU_HM_MIGRATE_STEPS);
+
+	cu_hm_bucket *bucket = cu_hm_lookup(map, key, hash);
+	if (inserted != NULL)
+		*inserted = bucket == NULL;
+	if (bucket != NULL)
+		return bucket;
+
 	if (cu_hm_reserve(map, map->nel + 1) != 0)
+		return NULL;
+	return cu_hm_place(map, key, hash);
+}
+
+int cu_hm_insert_hashed(cu_hm *map, cu_str key, uint64_t hash, void *value)
+{
+	cu_hm_bucket *bucket = cu_hm_get_or_insert_hashed(map, key, hash, NULL);
+	if (bucket == NULL)
 		return -1;
-	cu_hm_insert_unsafe(map, key, value);
+	bucket->value = value;
 	return 0;
+}
+
+void *cu_hm_erase_hashed(cu_hm *map, cu_str key, uint64_t hash)
+{
+	cu_hm_migrate(map, CU_HM_MIGRATE_STEPS);
 
+	cu_hm_bucket *bucket = cu_hm_lookup(map, key, hash);
+	if (bucket == NULL)
+		return NULL;
+	void *value = bucket->value;
+
+	if (map->engine == CU_HM_SWISS)
+		swiss_erase_at(map, bucket - map->arr);
+	else if (bucket >= map->arr && bucket < map->arr + map->capacity)
+		cu_hm_erase_at(map->arr, map->capacity, bucket - map->arr);
+	else
+		cu_hm_erase_at(map->old_arr, map->old_capacity,
+			bucket - map->old_arr);
+	--map->nel;
+	return value;
 }
 
 cu_hm_bucket *cu_hm_next(cu_hm_iter *iter)
 {
-	if (iter->hmap->nel == 0) {
+	cu_hm *map = iter->hmap;
+	if (map->nel == 0) {
+		return NULL;
+	}
+	if (map->engine == CU_HM_SWISS) {
+		// only the control bytes tell which buckets are full
+		while (iter->index < map->capacity) {
+			uint64_t index = iter->index++;
+			if (ctrl_is_full(map->ctrl[index]))
+				return map->arr + index;
+		}
 		return NULL;
 	}
-	while (iter->index < iter->hmap->capacity) {
-		cu_hm_bucket *elem = iter->hmap->arr + iter->index;
+	while (iter->index < map->capacity + map->old_capacity) {
+		cu_hm_bucket *elem = iter->index < map->capacity
+			? map->arr + iter->index
+			: map->old_arr + (iter->index - map->capacity);
 		++iter->index;
 		if (elem->key.buf != NULL)
 			return elem;
@@ -0,0 +1,203 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cu/hashmap_chain.h>
+#include <cu/bitmanip.h>
+
+#define MIN_CAPACITY 16
+
+static cu_slist *alloc_buckets(uint64_t capacity, cu_alloc *alloc)
+{
+	cu_slist *arr = cu_allocarray(capacity, sizeof(cu_slist), alloc);
+	if (arr == NULL)
+		return NULL;
+	for (uint64_t i = 0; i < capacity; ++i)
+		cu_slist_init_head(arr + i);
+	return arr;
+}
+
+static inline cu_hm_chain_node *node_of(cu_slist *link)
+{
+	return cu_container_of(link, cu_hm_chain_node, link);
+}
+
+int cu_hm_chain_new(cu_hm_chain *map, cu_alloc *alloc)
+{
+	*map = (cu_hm_chain){
+		.capacity = MIN_CAPACITY,
+		.max_load = 1,
+		.alloc = alloc,
+	};
+	if (cu_siphash_init(&map->key) != 0)
+		return -1;
+	map->arr = alloc_buckets(MIN_CAPACITY, alloc);
+	return map->arr == NULL ? -1 : 0;
+}
+
+void cu_hm_chain_free(cu_hm_chain *map)
+{
+	cu_freearray(map->arr, map->capacity, sizeof(cu_slist), map->alloc);
+	cu_freearray(map->old_arr, map->old_capacity, sizeof(cu_slist),
+		map->alloc);
+}
+
+// Returns the link before the node holding `key` in the bucket at `head`,
+// so the node can be unlinked, or NULL if it isn't there.
+static cu_slist *find_prev(cu_slist *head, cu_str key, uint64_t hash)
+{
+	cu_slist *prev = head;
+	for (cu_slist *cur = head->next; cur != head; cur = cur->next) {
+		cu_hm_chain_node *node = node_of(cur);
+		if (node->hash == hash && cu_str_eq(node->key, key))
+			return prev;
+		prev = cur;
+	}
+	return NULL;
+}
+
+// Same as find_prev, but checks both bucket arrays.
+static cu_slist *lookup_prev(cu_hm_chain *map, cu_str key, uint64_t hash)
+{
+	cu_slist *prev = find_prev(
+		map->arr + (hash & (map->capacity - 1)), key, hash);
+	if (prev != NULL || map->old_arr == NULL)
+		return prev;
+	uint64_t index = hash & (map->old_capacity - 1);
+	if (index < map->migrate_pos)
+		return NULL;
+	return find_prev(map->old_arr + index, key, hash);
+}
+
+// Moves up to `nsteps` of the old array's buckets into the new one.
+static void migrate(cu_hm_chain *map, uint64_t nsteps)
+{
+	if (map->old_arr == NULL)
+		return;
+
+	uint64_t mask = map->capacity - 1;
+	for (; nsteps > 0 && map->migrate_pos < map->old_capacity; --nsteps) {
+		cu_slist *head = map->old_arr + map->migrate_pos;
+		while (!cu_list_empty(head)) {
+			cu_slist *link = head->next;
+			cu_slist_del_next(head);
+			uint64_t index = node_of(link)->hash & mask;
+			cu_slist_add(link, map->arr + index);
+		}
+		++map->migrate_pos;
+	}
+	if (map->migrate_pos == map->old_capacity) {
+		cu_freearray(map->old_arr, map->old_capacity,
+			sizeof(cu_slist), map->alloc);
+		map->old_arr = NULL;
+		map->old_capacity = 0;
+		map->migrate_pos = 0;
+	}
+}
+
+void cu_hm_chain_set_incremental(cu_hm_chain *map, bool incremental)
+{
+	if (!incremental)
+		migrate(map, UINT64_MAX);
+	map->incremental = incremental;
+}
+
+void cu_hm_chain_set_max_load(cu_hm_chain *map, uint64_t max_load)
+{
+	assert(max_load > 0 && "The map can't hold anything at a load of 0");
+	map->max_load = max_load;
+}
+
+int cu_hm_chain_reserve(cu_hm_chain *map, uint64_t nel)
+{
+	if (nel <= map->capacity * map->max_load)
+		return 0;
+	uint64_t new_capacity =
+		cu_bit_ceil((nel + map->max_load - 1) / map->max_load);
+	cu_slist *new_arr = alloc_buckets(new_capacity, map->alloc);
+	if (new_arr == NULL)
+		return -1;
+
+	// only one resize can be in progress at a time
+	migrate(map, UINT64_MAX);
+
+	map->old_arr = map->arr;
+	map->old_capacity = map->capacity;
+	map->migrate_pos = 0;
+	map->arr = new_arr;
+	map->capacity = new_capacity;
+	if (!map->incremental || map->nel == 0)
+		migrate(map, UINT64_MAX);
+	return 0;
+}
+
+cu_hm_chain_node *
+cu_hm_chain_at_hashed(cu_hm_chain *map, cu_str key, uint64_t hash)
+{
+	cu_slist *prev = lookup_prev(map, key, hash);
+	return prev == NULL ? NULL : node_of(prev->next);
+}
+
+cu_hm_chain_node *cu_hm_chain_insert_hashed(cu_hm_chain *map,
+	cu_hm_chain_node *node, cu_str key, uint64_t hash)
+{
+	migrate(map, CU_HM_MIGRATE_STEPS);
+
+	cu_slist *prev = lookup_prev(map, key, hash);
+	if (prev != NULL)
+		return node_of(prev->next);
+
+	// the old buckets still work if this fails, they just fill up more
+	cu_hm_chain_reserve(map, map->nel + 1);
+	node->key = key;
+	node->hash = hash;
+	cu_slist_add(&node->link, map->arr + (hash & (map->capacity - 1)));
+	++map->nel;
+	return node;
+}
+
+cu_hm_chain_node *
+cu_hm_chain_erase_hashed(cu_hm_chain *map, cu_str key, uint64_t hash)
+{
+	migrate(map, CU_HM_MIGRATE_STEPS);
+
+	cu_slist *prev = lookup_prev(map, key, hash);
+	if (prev == NULL)
+		return NULL;
+	cu_hm_chain_node *node = node_of(prev->next);
+	cu_slist_del_next(prev);
+	--map->nel;
+	return node;
+}
+
+void cu_hm_chain_erase_node(cu_hm_chain *map, cu_hm_chain_node *node)
+{
+	// keys are unique, so the node found by its key is `node` itself
+	cu_hm_chain_node *erased =
+		cu_hm_chain_erase_hashed(map, node->key, node->hash);
+	assert(erased == node && "Node isn't in the map");
+	(void)erased;
+}
+
+static inline cu_slist *bucket_at(cu_hm_chain *map, uint64_t index)
+{
+	return index < map->capacity
+		? map->arr + index
+		: map->old_arr + (index - map->capacity);
+}
+
+cu_hm_chain_node *cu_hm_chain_next(cu_hm_chain_iter *iter)
+{
+	cu_hm_chain *map = iter->hmap;
+	while (iter->index < map->capacity + map->old_capacity) {
+		cu_slist *head = bucket_at(map, iter->index);
+		iter->pos = iter->pos == NULL ? head->next : iter->pos->next;
+		if (iter->pos != head)
+			return node_of(iter->pos);
+		iter->pos = NULL;
+		++iter->index;
+	}
+	return NULL;
+}
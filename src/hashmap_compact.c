@@ -0,0 +1,184 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cu/hashmap_compact.h>
+#include <cu/bitmanip.h>
+#include <stdalign.h>
+#define FILL_FACTOR 2
+#define MIN_CAPACITY 16
+
+int cu_hm_compact_new(cu_hm_compact *map, cu_alloc *alloc,
+	size_t arena_blocksize)
+{
+	*map = (cu_hm_compact){
+		.alloc = alloc,
+	};
+	if (cu_siphash_init(&map->key) != 0)
+		return -1;
+	map->name_arena = cu_arena_new(arena_blocksize, alloc);
+	return map->name_arena == NULL ? -1 : 0;
+}
+
+void cu_hm_compact_free(cu_hm_compact *map)
+{
+	cu_freearray(map->arr, map->capacity, sizeof(cu_hm_compact_bucket),
+		map->alloc);
+	cu_arena_free(map->name_arena);
+}
+
+// Whether `bucket` holds `key`. Short keys are compared without leaving the
+// bucket, and a key is never compared against one of the other kind.
+static inline bool
+holds_key(const cu_hm_compact_bucket *bucket, cu_str key, uint64_t hash)
+{
+	if (bucket->hash != hash)
+		return false;
+	if (key.len <= CU_HM_COMPACT_INLINE) {
+		return bucket->tag == key.len + 1
+			&& memcmp(bucket->key, key.buf, key.len) == 0;
+	}
+	return bucket->tag == CU_HM_COMPACT_SPILLED
+		&& cu_str_eq(cu_hm_compact_key(bucket), key);
+}
+
+// Finds the bucket holding `key`, or the empty bucket where it would go.
+static cu_hm_compact_bucket *
+find_bucket(cu_hm_compact *map, cu_str key, uint64_t hash)
+{
+	uint64_t mask = map->capacity - 1;
+	for (uint64_t index = hash & mask; ; index = (index + 1) & mask) {
+		cu_hm_compact_bucket *bucket = map->arr + index;
+		if (bucket->tag == 0 || holds_key(bucket, key, hash))
+			return bucket;
+	}
+}
+
+void *cu_hm_compact_at_hashed(cu_hm_compact *map, cu_str key, uint64_t hash)
+{
+	if (map->nel == 0)
+		return NULL;
+	cu_hm_compact_bucket *bucket = find_bucket(map, key, hash);
+	return bucket->tag == 0 ? NULL : bucket->value;
+}
+
+int cu_hm_compact_reserve(cu_hm_compact *map, uint64_t nel)
+{
+	if (nel <= map->capacity / FILL_FACTOR)
+		return 0;
+	uint64_t new_capacity = cu_bit_ceil(nel * FILL_FACTOR);
+	if (new_capacity < MIN_CAPACITY)
+		new_capacity = MIN_CAPACITY;
+	cu_hm_compact_bucket *new_arr = cu_allocarray(new_capacity,
+		sizeof(cu_hm_compact_bucket), map->alloc);
+	if (new_arr == NULL)
+		return -1;
+	memset(new_arr, 0, new_capacity * sizeof(cu_hm_compact_bucket));
+
+	// keys are distinct and their bytes move along with the buckets
+	uint64_t mask = new_capacity - 1;
+	for (uint64_t i = 0; i < map->capacity; ++i) {
+		if (map->arr[i].tag == 0)
+			continue;
+		uint64_t index = map->arr[i].hash & mask;
+		while (new_arr[index].tag != 0)
+			index = (index + 1) & mask;
+		new_arr[index] = map->arr[i];
+	}
+	cu_freearray(map->arr, map->capacity, sizeof(cu_hm_compact_bucket),
+		map->alloc);
+	map->arr = new_arr;
+	map->capacity = new_capacity;
+	return 0;
+}
+
+// Stores a copy of `key` in the empty `bucket`.
+//
+// Returns 0 on success, -1 on failure.
+static int
+store_key(cu_hm_compact *map, cu_hm_compact_bucket *bucket, cu_str key)
+{
+	if (key.len <= CU_HM_COMPACT_INLINE) {
+		memcpy(bucket->key, key.buf, key.len);
+		bucket->tag = (uint8_t)(key.len + 1);
+		return 0;
+	}
+	uint8_t *copy = cu_arena_aligned_alloc(sizeof(size_t) + key.len,
+		alignof(size_t), map->name_arena);
+	if (copy == NULL)
+		return -1;
+	memcpy(copy, &key.len, sizeof(size_t));
+	memcpy(copy + sizeof(size_t), key.buf, key.len);
+	memcpy(bucket->key, &copy, sizeof(copy));
+	bucket->tag = CU_HM_COMPACT_SPILLED;
+	return 0;
+}
+
+cu_hm_compact_bucket *
+cu_hm_compact_get_or_insert_hashed(cu_hm_compact *map, cu_str key,
+	uint64_t hash, bool *inserted)
+{
+	if (inserted != NULL)
+		*inserted = false;
+	cu_hm_compact_bucket *bucket = NULL;
+	if (map->capacity != 0) {
+		bucket = find_bucket(map, key, hash);
+		if (bucket->tag != 0)
+			return bucket;
+	}
+	if (map->nel + 1 > map->capacity / FILL_FACTOR) {
+		if (cu_hm_compact_reserve(map, map->nel + 1) != 0)
+			return NULL;
+		bucket = find_bucket(map, key, hash);
+	}
+
+	if (store_key(map, bucket, key) != 0)
+		return NULL;
+	bucket->hash = hash;
+	bucket->value = NULL;
+	++map->nel;
+	if (inserted != NULL)
+		*inserted = true;
+	return bucket;
+}
+
+void *
+cu_hm_compact_erase_hashed(cu_hm_compact *map, cu_str key, uint64_t hash)
+{
+	if (map->nel == 0)
+		return NULL;
+	cu_hm_compact_bucket *bucket = find_bucket(map, key, hash);
+	if (bucket->tag == 0)
+		return NULL;
+	void *value = bucket->value;
+
+	// backward-shift deletion, see cu_hm_erase_at
+	uint64_t mask = map->capacity - 1;
+	uint64_t hole = bucket - map->arr;
+	for (uint64_t i = (hole + 1) & mask;
+		map->arr[i].tag != 0;
+		i = (i + 1) & mask
+	) {
+		uint64_t home = map->arr[i].hash & mask;
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			map->arr[hole] = map->arr[i];
+			hole = i;
+		}
+	}
+	map->arr[hole] = (cu_hm_compact_bucket){.tag = 0};
+	--map->nel;
+	return value;
+}
+
+cu_hm_compact_bucket *cu_hm_compact_next(cu_hm_compact_iter *iter)
+{
+	cu_hm_compact *map = iter->hmap;
+	while (iter->index < map->capacity) {
+		cu_hm_compact_bucket *bucket = map->arr + iter->index++;
+		if (bucket->tag != 0)
+			return bucket;
+	}
+	return NULL;
+}
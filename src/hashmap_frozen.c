@@ -0,0 +1,214 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cu/hashmap_frozen.h>
+
+// average number of keys per group. Smaller groups are quicker to place but
+// need more pilots, 3 keys per group costs 4/3 bytes per key.
+#define GROUP_SIZE 3
+
+// attempts at building with a fresh SipHash key before giving up
+#define MAX_ATTEMPTS 4
+
+void *cu_hm_frozen_at_hashed(const cu_hm_frozen *map, cu_str key,
+	uint64_t hash)
+{
+	if (map->nel == 0)
+		return NULL;
+	uint64_t group = cu_hm_frozen_group(hash, map->ngroups);
+	uint32_t pilot = map->pilots[group];
+	const cu_hm_bucket *bucket =
+		map->arr + cu_hm_frozen_position(hash, pilot, map->nel);
+	if (bucket->hash == hash && cu_str_eq(bucket->key, key))
+		return bucket->value;
+	return NULL;
+}
+
+void cu_hm_frozen_free(cu_hm_frozen *frozen)
+{
+	cu_freearray(frozen->arr, frozen->nel, sizeof(cu_hm_bucket),
+		frozen->alloc);
+	cu_freearray(frozen->pilots, frozen->ngroups, sizeof(uint32_t),
+		frozen->alloc);
+}
+
+// Scratch space for building, everything has one entry per key unless noted.
+struct build {
+	cu_hm_bucket *buckets; // the keys, sorted by group
+	uint64_t *group_start; // ngroups + 1 entries, into `buckets`
+	uint64_t *order; // ngroups entries, groups from largest to smallest
+	uint64_t *positions; // big enough for the largest group
+	bool *taken;
+};
+
+// Finds a pilot that puts every key in the group into a free bucket.
+//
+// Returns false if no pilot works, which only happens if two keys in the
+// group have the same hash.
+static bool place_group(cu_hm_frozen *frozen, struct build *b, uint64_t group)
+{
+	cu_hm_bucket *members = b->buckets + b->group_start[group];
+	uint64_t size = b->group_start[group + 1] - b->group_start[group];
+	for (uint64_t i = 0; i < size; ++i) {
+		for (uint64_t j = 0; j < i; ++j) {
+			if (members[i].hash == members[j].hash)
+				return false;
+		}
+	}
+
+	for (uint64_t pilot = 0; pilot <= UINT32_MAX; ++pilot) {
+		uint64_t placed = 0;
+		for (; placed < size; ++placed) {
+			uint64_t pos = cu_hm_frozen_position(
+				members[placed].hash, (uint32_t)pilot,
+				frozen->nel);
+			if (b->taken[pos])
+				break;
+			b->taken[pos] = true;
+			b->positions[placed] = pos;
+		}
+		if (placed == size) {
+			for (uint64_t i = 0; i < size; ++i)
+				frozen->arr[b->positions[i]] = members[i];
+			frozen->pilots[group] = (uint32_t)pilot;
+			return true;
+		}
+		for (uint64_t i = 0; i < placed; ++i)
+			b->taken[b->positions[i]] = false;
+	}
+	return false;
+}
+
+// Sorts the keys into groups, then places the groups from largest to
+// smallest, since big groups are hardest to fit once the table fills up.
+static int try_build(cu_hm_frozen *frozen, struct build *b,
+	const cu_hm_bucket *keys)
+{
+	uint64_t nel = frozen->nel;
+	uint64_t ngroups = frozen->ngroups;
+	memset(b->group_start, 0, (ngroups + 1) * sizeof(uint64_t));
+	memset(b->taken, 0, nel * sizeof(bool));
+
+	for (uint64_t i = 0; i < nel; ++i) {
+		uint64_t g = cu_hm_frozen_group(keys[i].hash, ngroups);
+		++b->group_start[g + 1];
+	}
+	uint64_t max_size = 0;
+	for (uint64_t g = 0; g < ngroups; ++g) {
+		if (b->group_start[g + 1] > max_size)
+			max_size = b->group_start[g + 1];
+		b->group_start[g + 1] += b->group_start[g];
+	}
+	// group_start[g] is used as a cursor and ends up at the start of
+	// group g + 1, so it's shifted back afterwards
+	for (uint64_t i = 0; i < nel; ++i) {
+		uint64_t g = cu_hm_frozen_group(keys[i].hash, ngroups);
+		b->buckets[b->group_start[g]++] = keys[i];
+	}
+	memmove(b->group_start + 1, b->group_start,
+		ngroups * sizeof(uint64_t));
+	b->group_start[0] = 0;
+
+	// counting sort of the groups by size, largest first
+	uint64_t *size_start = b->positions;
+	memset(size_start, 0, (max_size + 2) * sizeof(uint64_t));
+	for (uint64_t g = 0; g < ngroups; ++g) {
+		uint64_t size = b->group_start[g + 1] - b->group_start[g];
+		++size_start[max_size - size + 1];
+	}
+	for (uint64_t s = 0; s <= max_size; ++s)
+		size_start[s + 1] += size_start[s];
+	for (uint64_t g = 0; g < ngroups; ++g) {
+		uint64_t size = b->group_start[g + 1] - b->group_start[g];
+		b->order[size_start[max_size - size]++] = g;
+	}
+
+	for (uint64_t i = 0; i < ngroups; ++i) {
+		if (!place_group(frozen, b, b->order[i]))
+			return -1;
+	}
+	return 0;
+}
+
+int cu_hm_freeze(cu_hm_frozen *frozen, const cu_hm *map)
+{
+	uint64_t nel = map->nel;
+	*frozen = (cu_hm_frozen){
+		.nel = nel,
+		.ngroups = (nel + GROUP_SIZE - 1) / GROUP_SIZE,
+		.alloc = map->alloc,
+		.key = map->key,
+	};
+	if (nel == 0)
+		return 0;
+	// positions are picked from 32 bits of the hash
+	if (nel > UINT32_MAX)
+		return -1;
+
+	uint64_t ngroups = frozen->ngroups;
+	// the largest group can't be bigger than `nel`, and the size sort
+	// needs room for every size up to the largest one
+	uint64_t npositions = nel + 2;
+	struct build b = {
+		.buckets = cu_allocarray(nel, sizeof(cu_hm_bucket), map->alloc),
+		.group_start = cu_allocarray(ngroups + 1, sizeof(uint64_t),
+			map->alloc),
+		.order = cu_allocarray(ngroups, sizeof(uint64_t), map->alloc),
+		.positions = cu_allocarray(npositions, sizeof(uint64_t),
+			map->alloc),
+		.taken = cu_allocarray(nel, sizeof(bool), map->alloc),
+	};
+	cu_hm_bucket *keys =
+		cu_allocarray(nel, sizeof(cu_hm_bucket), map->alloc);
+	frozen->arr = cu_allocarray(nel, sizeof(cu_hm_bucket), map->alloc);
+	frozen->pilots = cu_allocarray(ngroups, sizeof(uint32_t), map->alloc);
+
+	int retval = -1;
+	if (b.buckets == NULL || b.group_start == NULL || b.order == NULL
+		|| b.positions == NULL || b.taken == NULL || keys == NULL
+		|| frozen->arr == NULL || frozen->pilots == NULL
+	)
+		goto cleanup;
+
+	uint64_t i = 0;
+	cu_hm_iter iter = cu_hm_begin((cu_hm *)map);
+	cu_hm_bucket *bucket;
+	while ((bucket = cu_hm_next(&iter)) != NULL)
+		keys[i++] = *bucket;
+
+	// The cached hashes can be used as-is the first time around, unless
+	// the map hashed with something other than the SipHash-1-3 used here.
+	// If two keys' hashes collide completely, the only way out is a new
+	// key.
+	for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+		if (attempt != 0 && cu_siphash_init(&frozen->key) != 0)
+			break;
+		if (attempt != 0 || map->hasher != CU_HM_SIPHASH13) {
+			for (i = 0; i < nel; ++i) {
+				keys[i].hash =
+					cu_str_hash(keys[i].key, &frozen->key);
+			}
+		}
+		if (try_build(frozen, &b, keys) == 0) {
+			retval = 0;
+			break;
+		}
+	}
+
+cleanup:
+	cu_freearray(b.buckets, nel, sizeof(cu_hm_bucket), map->alloc);
+	cu_freearray(b.group_start, ngroups + 1, sizeof(uint64_t), map->alloc);
+	cu_freearray(b.order, ngroups, sizeof(uint64_t), map->alloc);
+	cu_freearray(b.positions, npositions, sizeof(uint64_t), map->alloc);
+	cu_freearray(b.taken, nel, sizeof(bool), map->alloc);
+	cu_freearray(keys, nel, sizeof(cu_hm_bucket), map->alloc);
+	if (retval != 0) {
+		cu_hm_frozen_free(frozen);
+		frozen->arr = NULL;
+		frozen->pilots = NULL;
+	}
+	return retval;
+}
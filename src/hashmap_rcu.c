@@ -0,0 +1,245 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cu/hashmap_rcu.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#	include <windows.h>
+#	define yield_thread() SwitchToThread()
+#else
+#	include <sched.h>
+#	define yield_thread() sched_yield()
+#endif
+
+#define CACHE_LINE 64
+
+// Epochs start at 1, a reader slot holding 0 isn't reading.
+#define EPOCH_IDLE 0
+
+struct snapshot {
+	cu_hm hm;
+	// the last epoch in which readers could have picked this snapshot up
+	uint64_t retired_epoch;
+	struct snapshot *next_retired;
+};
+
+// Each reader gets a cache line to itself, since the array of them is aligned
+// to a cache line, so announcing an epoch never bounces a line between
+// readers.
+struct cu_hm_rcu_reader {
+	union {
+		struct {
+			_Atomic uint64_t epoch;
+			atomic_bool in_use;
+			cu_hm_rcu *map;
+		};
+		uint8_t pad[CACHE_LINE];
+	};
+};
+
+struct cu_hm_rcu {
+	_Atomic(struct snapshot *) current;
+	_Atomic uint64_t epoch;
+	// only touched by the writer
+	struct snapshot *retired;
+	cu_hm_rcu_reader *readers;
+	void *readers_base; // the allocation `readers` is aligned within
+	size_t max_readers;
+	cu_alloc *alloc;
+};
+
+static void free_snapshot(cu_hm_rcu *map, struct snapshot *snap)
+{
+	cu_hm_free(&snap->hm);
+	cu_free(snap, sizeof(struct snapshot), map->alloc);
+}
+
+cu_hm_rcu *cu_hm_rcu_new(size_t max_readers, cu_alloc *alloc)
+{
+	cu_hm_rcu *map = cu_malloc(sizeof(cu_hm_rcu), alloc);
+	if (map == NULL)
+		return NULL;
+	map->readers = cu_malloc_aligned(max_readers * sizeof(cu_hm_rcu_reader),
+		CACHE_LINE, &map->readers_base, alloc);
+	struct snapshot *snap = cu_malloc(sizeof(struct snapshot), alloc);
+	if (map->readers == NULL || snap == NULL
+		|| cu_hm_new(&snap->hm, alloc) != 0
+	) {
+		if (map->readers != NULL) {
+			cu_free_aligned(map->readers_base,
+				max_readers * sizeof(cu_hm_rcu_reader),
+				CACHE_LINE, alloc);
+		}
+		cu_free(snap, sizeof(struct snapshot), alloc);
+		cu_free(map, sizeof(cu_hm_rcu), alloc);
+		return NULL;
+	}
+	for (size_t i = 0; i < max_readers; ++i) {
+		atomic_init(&map->readers[i].epoch, EPOCH_IDLE);
+		atomic_init(&map->readers[i].in_use, false);
+		map->readers[i].map = map;
+	}
+	atomic_init(&map->current, snap);
+	atomic_init(&map->epoch, 1);
+	map->retired = NULL;
+	map->max_readers = max_readers;
+	map->alloc = alloc;
+	return map;
+}
+
+void cu_hm_rcu_free(cu_hm_rcu *map)
+{
+	struct snapshot *snap = map->retired;
+	while (snap != NULL) {
+		struct snapshot *next = snap->next_retired;
+		free_snapshot(map, snap);
+		snap = next;
+	}
+	free_snapshot(map, atomic_load(&map->current));
+	cu_free_aligned(map->readers_base,
+		map->max_readers * sizeof(cu_hm_rcu_reader), CACHE_LINE,
+		map->alloc);
+	cu_free(map, sizeof(cu_hm_rcu), map->alloc);
+}
+
+cu_hm_rcu_reader *cu_hm_rcu_register(cu_hm_rcu *map)
+{
+	for (size_t i = 0; i < map->max_readers; ++i) {
+		bool expected = false;
+		if (atomic_compare_exchange_strong(
+			&map->readers[i].in_use, &expected, true))
+			return map->readers + i;
+	}
+	return NULL;
+}
+
+void cu_hm_rcu_unregister(cu_hm_rcu_reader *reader)
+{
+	atomic_store_explicit(&reader->epoch, EPOCH_IDLE, memory_order_release);
+	atomic_store_explicit(&reader->in_use, false, memory_order_release);
+}
+
+cu_hm *cu_hm_rcu_read_lock(cu_hm_rcu_reader *reader)
+{
+	cu_hm_rcu *map = reader->map;
+	uint64_t epoch =
+		atomic_load_explicit(&map->epoch, memory_order_acquire);
+	atomic_store_explicit(&reader->epoch, epoch, memory_order_relaxed);
+	// Pairs with the fence in reclaim(). Either the writer sees this
+	// reader's epoch, or this reader sees the writer's newest snapshot.
+	atomic_thread_fence(memory_order_seq_cst);
+	struct snapshot *snap =
+		atomic_load_explicit(&map->current, memory_order_acquire);
+	return &snap->hm;
+}
+
+void cu_hm_rcu_read_unlock(cu_hm_rcu_reader *reader)
+{
+	atomic_store_explicit(&reader->epoch, EPOCH_IDLE, memory_order_release);
+}
+
+void *cu_hm_rcu_at(cu_hm_rcu_reader *reader, cu_str key)
+{
+	void *value = cu_hm_at(cu_hm_rcu_read_lock(reader), key);
+	cu_hm_rcu_read_unlock(reader);
+	return value;
+}
+
+// Frees every retired snapshot that no reader can still be using.
+//
+// Returns true if nothing is left to free.
+static bool reclaim(cu_hm_rcu *map)
+{
+	atomic_thread_fence(memory_order_seq_cst);
+	uint64_t oldest = UINT64_MAX;
+	for (size_t i = 0; i < map->max_readers; ++i) {
+		uint64_t epoch = atomic_load_explicit(
+			&map->readers[i].epoch, memory_order_acquire);
+		if (epoch != EPOCH_IDLE && epoch < oldest)
+			oldest = epoch;
+	}
+
+	struct snapshot **link = &map->retired;
+	while (*link != NULL) {
+		struct snapshot *snap = *link;
+		if (snap->retired_epoch < oldest) {
+			*link = snap->next_retired;
+			free_snapshot(map, snap);
+		}
+		else {
+			link = &snap->next_retired;
+		}
+	}
+	return map->retired == NULL;
+}
+
+int cu_hm_rcu_clone(cu_hm_rcu *map, cu_hm *out)
+{
+	// only the writer ever frees snapshots, so it can read the current one
+	// without announcing itself
+	struct snapshot *snap =
+		atomic_load_explicit(&map->current, memory_order_relaxed);
+	return cu_hm_clone(out, &snap->hm);
+}
+
+int cu_hm_rcu_publish(cu_hm_rcu *map, cu_hm *table)
+{
+	assert(table->alloc == map->alloc && "Snapshot from another allocator");
+	struct snapshot *snap = cu_malloc(sizeof(struct snapshot), map->alloc);
+	if (snap == NULL)
+		return -1;
+	snap->hm = *table;
+
+	struct snapshot *old =
+		atomic_load_explicit(&map->current, memory_order_relaxed);
+	atomic_store_explicit(&map->current, snap, memory_order_release);
+
+	// readers that announce the next epoch are guaranteed to see the new
+	// snapshot, anyone that announced this one might not
+	uint64_t epoch =
+		atomic_load_explicit(&map->epoch, memory_order_relaxed);
+	old->retired_epoch = epoch;
+	atomic_store_explicit(&map->epoch, epoch + 1, memory_order_release);
+
+	old->next_retired = map->retired;
+	map->retired = old;
+	reclaim(map);
+	return 0;
+}
+
+void cu_hm_rcu_synchronize(cu_hm_rcu *map)
+{
+	while (!reclaim(map))
+		yield_thread();
+}
+
+int cu_hm_rcu_insert(cu_hm_rcu *map, cu_str key, void *value)
+{
+	cu_hm copy;
+	if (cu_hm_rcu_clone(map, &copy) != 0)
+		return -1;
+	if (cu_hm_insert(&copy, key, value) != 0
+		|| cu_hm_rcu_publish(map, &copy) != 0
+	) {
+		cu_hm_free(&copy);
+		return -1;
+	}
+	return 0;
+}
+
+void *cu_hm_rcu_erase(cu_hm_rcu *map, cu_str key)
+{
+	cu_hm copy;
+	if (cu_hm_rcu_clone(map, &copy) != 0)
+		return NULL;
+	void *value = cu_hm_erase(&copy, key);
+	if (value == NULL || cu_hm_rcu_publish(map, &copy) != 0) {
+		cu_hm_free(&copy);
+		return NULL;
+	}
+	return value;
+}
@@ -0,0 +1,235 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cu/hashmap_sharded.h>
+#include <cu/bitmanip.h>
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+typedef SRWLOCK rwlock;
+
+static inline int rwlock_init(rwlock *lock)
+{
+	InitializeSRWLock(lock);
+	return 0;
+}
+static inline void rwlock_destroy(rwlock *lock)
+{
+	(void)lock;
+}
+static inline void rwlock_rdlock(rwlock *lock)
+{
+	AcquireSRWLockShared(lock);
+}
+static inline void rwlock_rdunlock(rwlock *lock)
+{
+	ReleaseSRWLockShared(lock);
+}
+static inline void rwlock_wrlock(rwlock *lock)
+{
+	AcquireSRWLockExclusive(lock);
+}
+static inline void rwlock_wrunlock(rwlock *lock)
+{
+	ReleaseSRWLockExclusive(lock);
+}
+
+#else
+
+#include <pthread.h>
+
+typedef pthread_rwlock_t rwlock;
+
+static inline int rwlock_init(rwlock *lock)
+{
+	return pthread_rwlock_init(lock, NULL) == 0 ? 0 : -1;
+}
+static inline void rwlock_destroy(rwlock *lock)
+{
+	pthread_rwlock_destroy(lock);
+}
+static inline void rwlock_rdlock(rwlock *lock)
+{
+	pthread_rwlock_rdlock(lock);
+}
+static inline void rwlock_rdunlock(rwlock *lock)
+{
+	pthread_rwlock_unlock(lock);
+}
+static inline void rwlock_wrlock(rwlock *lock)
+{
+	pthread_rwlock_wrlock(lock);
+}
+static inline void rwlock_wrunlock(rwlock *lock)
+{
+	pthread_rwlock_unlock(lock);
+}
+
+#endif // _WIN32
+
+#define CACHE_LINE 64
+
+struct cu_hm_shard {
+	rwlock lock;
+	cu_hm hm;
+};
+
+// shards start on cache line boundaries and are spaced out to whole cache
+// lines, so threads working on neighbouring shards don't fight over the same
+// line
+#define SHARD_STRIDE (\
+	(sizeof(struct cu_hm_shard) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE\
+)
+
+static inline struct cu_hm_shard *get_shard(cu_hm_sharded *map, uint64_t i)
+{
+	uint8_t *shards = (uint8_t *)map->shards;
+	return (struct cu_hm_shard *)(shards + i * SHARD_STRIDE);
+}
+
+// The shard comes from the top bits of the hash, while each shard's `cu_hm`
+// indexes its buckets with the bottom bits, so the two don't interfere.
+static inline struct cu_hm_shard *
+shard_for(cu_hm_sharded *map, uint64_t hash)
+{
+	if (map->shard_bits == 0)
+		return get_shard(map, 0);
+	return get_shard(map, hash >> (64 - map->shard_bits));
+}
+
+int cu_hm_sharded_new(cu_hm_sharded *map, uint64_t nshards, cu_alloc *alloc)
+{
+	if (nshards == 0)
+		nshards = 1;
+	nshards = cu_bit_ceil(nshards);
+	map->nshards = nshards;
+	map->shard_bits = cu_trailing_zeros(nshards);
+	map->alloc = alloc;
+	if (cu_siphash_init(&map->key) != 0)
+		return -1;
+
+	map->shards = cu_malloc_aligned(nshards * SHARD_STRIDE, CACHE_LINE,
+		&map->shards_base, alloc);
+	if (map->shards == NULL)
+		return -1;
+	for (uint64_t i = 0; i < nshards; ++i) {
+		struct cu_hm_shard *shard = get_shard(map, i);
+		if (rwlock_init(&shard->lock) != 0) {
+			// the allocation still has to be freed at its full size
+			for (uint64_t j = 0; j < i; ++j) {
+				cu_hm_free(&get_shard(map, j)->hm);
+				rwlock_destroy(&get_shard(map, j)->lock);
+			}
+			cu_free_aligned(map->shards_base,
+				nshards * SHARD_STRIDE, CACHE_LINE, alloc);
+			return -1;
+		}
+		// cu_hm_new only fails when getting a key, and every shard
+		// shares the map's key anyways, so the hash can be passed
+		// straight through to the shard
+		cu_hm_new(&shard->hm, alloc);
+		shard->hm.key = map->key;
+	}
+	return 0;
+}
+
+void cu_hm_sharded_free(cu_hm_sharded *map)
+{
+	for (uint64_t i = 0; i < map->nshards; ++i) {
+		struct cu_hm_shard *shard = get_shard(map, i);
+		cu_hm_free(&shard->hm);
+		rwlock_destroy(&shard->lock);
+	}
+	cu_free_aligned(map->shards_base, map->nshards * SHARD_STRIDE,
+		CACHE_LINE, map->alloc);
+}
+
+void *cu_hm_sharded_at(cu_hm_sharded *map, cu_str key)
+{
+	uint64_t hash = cu_hm_sharded_hash(map, key);
+	struct cu_hm_shard *shard = shard_for(map, hash);
+	rwlock_rdlock(&shard->lock);
+	void *value = cu_hm_at_hashed(&shard->hm, key, hash);
+	rwlock_rdunlock(&shard->lock);
+	return value;
+}
+
+int cu_hm_sharded_insert(cu_hm_sharded *map, cu_str key, void *value)
+{
+	uint64_t hash = cu_hm_sharded_hash(map, key);
+	struct cu_hm_shard *shard = shard_for(map, hash);
+	rwlock_wrlock(&shard->lock);
+	int retval = cu_hm_insert_hashed(&shard->hm, key, hash, value);
+	rwlock_wrunlock(&shard->lock);
+	return retval;
+}
+
+void *cu_hm_sharded_erase(cu_hm_sharded *map, cu_str key)
+{
+	uint64_t hash = cu_hm_sharded_hash(map, key);
+	struct cu_hm_shard *shard = shard_for(map, hash);
+	rwlock_wrlock(&shard->lock);
+	void *value = cu_hm_erase_hashed(&shard->hm, key, hash);
+	rwlock_wrunlock(&shard->lock);
+	return value;
+}
+
+int cu_hm_sharded_reserve(cu_hm_sharded *map, uint64_t nel)
+{
+	uint64_t per_shard = (nel + map->nshards - 1) / map->nshards;
+	int retval = 0;
+	for (uint64_t i = 0; i < map->nshards; ++i) {
+		struct cu_hm_shard *shard = get_shard(map, i);
+		rwlock_wrlock(&shard->lock);
+		if (cu_hm_reserve(&shard->hm, per_shard) != 0)
+			retval = -1;
+		rwlock_wrunlock(&shard->lock);
+	}
+	return retval;
+}
+
+uint64_t cu_hm_sharded_size(cu_hm_sharded *map)
+{
+	uint64_t nel = 0;
+	for (uint64_t i = 0; i < map->nshards; ++i) {
+		struct cu_hm_shard *shard = get_shard(map, i);
+		rwlock_rdlock(&shard->lock);
+		nel += shard->hm.nel;
+		rwlock_rdunlock(&shard->lock);
+	}
+	return nel;
+}
+
+cu_hm_bucket *cu_hm_sharded_next(cu_hm_sharded_iter *iter)
+{
+	cu_hm_sharded *map = iter->hmap;
+	while (iter->shard < map->nshards) {
+		struct cu_hm_shard *shard = get_shard(map, iter->shard);
+		if (!iter->locked) {
+			rwlock_rdlock(&shard->lock);
+			iter->locked = true;
+			iter->inner = cu_hm_begin(&shard->hm);
+		}
+		cu_hm_bucket *bucket = cu_hm_next(&iter->inner);
+		if (bucket != NULL)
+			return bucket;
+		rwlock_rdunlock(&shard->lock);
+		iter->locked = false;
+		++iter->shard;
+	}
+	return NULL;
+}
+
+void cu_hm_sharded_end(cu_hm_sharded_iter *iter)
+{
+	if (!iter->locked)
+		return;
+	rwlock_rdunlock(&get_shard(iter->hmap, iter->shard)->lock);
+	iter->locked = false;
+	iter->shard = iter->hmap->nshards;
+}
@@ -0,0 +1,261 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cu/hashmap_view.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+static const uint8_t *map_file(const char *path, size_t *size)
+{
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+	LARGE_INTEGER file_size;
+	const uint8_t *data = NULL;
+	if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0
+		&& (uint64_t)file_size.QuadPart <= SIZE_MAX
+	) {
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY,
+			0, 0, NULL);
+		if (mapping != NULL) {
+			data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+		}
+		*size = (size_t)file_size.QuadPart;
+	}
+	CloseHandle(file);
+	return data;
+}
+
+static void unmap_file(const uint8_t *data, size_t size)
+{
+	(void)size;
+	UnmapViewOfFile(data);
+}
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint8_t *map_file(const char *path, size_t *size)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	struct stat st;
+	const uint8_t *data = NULL;
+	if (fstat(fd, &st) == 0 && st.st_size > 0
+		&& (uint64_t)st.st_size <= SIZE_MAX
+	) {
+		void *mem = mmap(NULL, (size_t)st.st_size, PROT_READ,
+			MAP_SHARED, fd, 0);
+		if (mem != MAP_FAILED)
+			data = mem;
+		*size = (size_t)st.st_size;
+	}
+	// the mapping keeps the file alive on its own
+	close(fd);
+	return data;
+}
+
+static void unmap_file(const uint8_t *data, size_t size)
+{
+	munmap((void *)data, size);
+}
+
+#endif // _WIN32
+
+#define MAGIC "cuhmview"
+#define VERSION 1
+// reads back differently on machines with a different byte order
+#define BYTE_ORDER_MARK UINT64_C(0x0102030405060708)
+
+// The file is laid out as:
+// - the header
+// - the pilots of the frozen table, padded to a multiple of 8 bytes
+// - the slots of the frozen table
+// - the bytes of all the keys
+struct file_header {
+	uint8_t magic[8];
+	uint64_t byte_order;
+	uint64_t version;
+	uint64_t nel;
+	uint64_t ngroups;
+	uint64_t key[2];
+};
+
+struct cu_hm_view_slot {
+	uint64_t hash;
+	uint64_t key_offset; // from the start of the file
+	uint64_t key_len;
+	uint64_t value;
+};
+
+static inline uint64_t slots_offset(uint64_t ngroups)
+{
+	uint64_t pilots_end = sizeof(struct file_header)
+		+ ngroups * sizeof(uint32_t);
+	return (pilots_end + 7) / 8 * 8;
+}
+
+static int write_table(const cu_hm_frozen *frozen, FILE *file)
+{
+	struct file_header header = {
+		.byte_order = BYTE_ORDER_MARK,
+		.version = VERSION,
+		.nel = frozen->nel,
+		.ngroups = frozen->ngroups,
+		.key = {frozen->key.key[0], frozen->key.key[1]},
+	};
+	memcpy(header.magic, MAGIC, sizeof(header.magic));
+	if (fwrite(&header, sizeof(header), 1, file) != 1)
+		return -1;
+	// an empty map has no pilots, and fwrite can't be given NULL
+	if (frozen->ngroups != 0 && fwrite(frozen->pilots, sizeof(uint32_t),
+		frozen->ngroups, file) != frozen->ngroups)
+		return -1;
+	uint64_t slots_start = slots_offset(frozen->ngroups);
+	uint64_t padding = slots_start - sizeof(struct file_header)
+		- frozen->ngroups * sizeof(uint32_t);
+	static const uint8_t zeroes[8] = {0};
+	if (fwrite(zeroes, 1, padding, file) != padding)
+		return -1;
+
+	uint64_t key_offset = slots_start
+		+ frozen->nel * sizeof(struct cu_hm_view_slot);
+	for (uint64_t i = 0; i < frozen->nel; ++i) {
+		const cu_hm_bucket *bucket = frozen->arr + i;
+		struct cu_hm_view_slot slot = {
+			.hash = bucket->hash,
+			.key_offset = key_offset,
+			.key_len = bucket->key.len,
+			.value = (uintptr_t)bucket->value,
+		};
+		if (fwrite(&slot, sizeof(slot), 1, file) != 1)
+			return -1;
+		key_offset += bucket->key.len;
+	}
+	for (uint64_t i = 0; i < frozen->nel; ++i) {
+		cu_str key = frozen->arr[i].key;
+		if (fwrite(key.buf, 1, key.len, file) != key.len)
+			return -1;
+	}
+	return 0;
+}
+
+int cu_hm_save(const cu_hm *map, const char *path)
+{
+	cu_hm_frozen frozen;
+	if (cu_hm_freeze(&frozen, map) != 0)
+		return -1;
+	FILE *file = fopen(path, "wb");
+	int retval = -1;
+	if (file != NULL) {
+		retval = write_table(&frozen, file);
+		if (fclose(file) != 0)
+			retval = -1;
+	}
+	cu_hm_frozen_free(&frozen);
+	return retval;
+}
+
+int cu_hm_view_open(cu_hm_view *view, const char *path)
+{
+	size_t size = 0;
+	const uint8_t *data = map_file(path, &size);
+	if (data == NULL)
+		return -1;
+
+	struct file_header header;
+	if (size < sizeof(header))
+		goto invalid;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0
+		|| header.byte_order != BYTE_ORDER_MARK
+		|| header.version != VERSION
+		|| header.nel > UINT32_MAX
+		|| header.ngroups > header.nel
+		|| (header.nel != 0 && header.ngroups == 0)
+	)
+		goto invalid;
+	uint64_t slots_start = slots_offset(header.ngroups);
+	uint64_t slots_end = slots_start
+		+ header.nel * sizeof(struct cu_hm_view_slot);
+	if (slots_end > size)
+		goto invalid;
+
+	*view = (cu_hm_view){
+		.data = data,
+		.size = size,
+		.pilots = (const uint32_t *)(data + sizeof(header)),
+		.slots = (const struct cu_hm_view_slot *)(data + slots_start),
+		.nel = header.nel,
+		.ngroups = header.ngroups,
+		.key = {{header.key[0], header.key[1]}},
+	};
+	return 0;
+
+invalid:
+	unmap_file(data, size);
+	return -1;
+}
+
+void cu_hm_view_close(cu_hm_view *view)
+{
+	unmap_file(view->data, view->size);
+}
+
+// Returns NIL if the slot's key doesn't fit in the file.
+static inline cu_str slot_key(const cu_hm_view *view,
+	const struct cu_hm_view_slot *slot)
+{
+	if (slot->key_offset > view->size
+		|| slot->key_len > view->size - slot->key_offset)
+		return CU_NIL_STR;
+	return (cu_str){
+		.buf = (uint8_t *)view->data + slot->key_offset,
+		.len = slot->key_len,
+	};
+}
+
+bool cu_hm_view_at(const cu_hm_view *view, cu_str key, uint64_t *value)
+{
+	if (view->nel == 0)
+		return false;
+	uint64_t hash = cu_str_hash(key, &view->key);
+	uint64_t group = cu_hm_frozen_group(hash, view->ngroups);
+	const struct cu_hm_view_slot *slot = view->slots
+		+ cu_hm_frozen_position(hash, view->pilots[group], view->nel);
+	if (slot->hash != hash)
+		return false;
+	cu_str slot_str = slot_key(view, slot);
+	if (cu_str_isnil(slot_str) || !cu_str_eq(slot_str, key))
+		return false;
+	*value = slot->value;
+	return true;
+}
+
+bool cu_hm_view_next(cu_hm_view_iter *iter, cu_str *key, uint64_t *value)
+{
+	const cu_hm_view *view = iter->view;
+	while (iter->index < view->nel) {
+		const struct cu_hm_view_slot *slot =
+			view->slots + iter->index++;
+		*key = slot_key(view, slot);
+		if (cu_str_isnil(*key))
+			continue;
+		*value = slot->value;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,214 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cu/hashset.h>
+#include <cu/bitmanip.h>
+#define FILL_FACTOR 2
+#define MIN_CAPACITY 16
+
+int cu_hs_new(cu_hs *set, cu_alloc *alloc)
+{
+	*set = (cu_hs){
+		.alloc = alloc,
+	};
+	return cu_siphash_init(&set->key);
+}
+
+void cu_hs_new_with_key(cu_hs *set, cu_alloc *alloc,
+	const cu_siphash_key *key)
+{
+	*set = (cu_hs){
+		.alloc = alloc,
+		.key = *key,
+	};
+}
+
+void cu_hs_free(cu_hs *set)
+{
+	cu_freearray(set->arr, set->capacity, sizeof(cu_hs_bucket), set->alloc);
+}
+
+// Finds the bucket holding `key`, or the empty bucket where it would go.
+static cu_hs_bucket *find_bucket(const cu_hs *set, cu_str key, uint64_t hash)
+{
+	uint64_t mask = set->capacity - 1;
+	for (uint64_t index = hash & mask; ; index = (index + 1) & mask) {
+		cu_hs_bucket *bucket = set->arr + index;
+		if (bucket->key.buf == NULL)
+			return bucket;
+		if (bucket->hash == hash && cu_str_eq(bucket->key, key))
+			return bucket;
+	}
+}
+
+// Places a key that is known not to be in the set yet, without growing.
+static void place_unsafe(cu_hs *set, cu_str key, uint64_t hash)
+{
+	uint64_t mask = set->capacity - 1;
+	uint64_t index = hash & mask;
+	while (set->arr[index].key.buf != NULL)
+		index = (index + 1) & mask;
+	set->arr[index] = (cu_hs_bucket){
+		.key = key,
+		.hash = hash,
+	};
+	++set->nel;
+}
+
+const cu_hs_bucket *
+cu_hs_find_hashed(const cu_hs *set, cu_str key, uint64_t hash)
+{
+	if (set->nel == 0)
+		return NULL;
+	const cu_hs_bucket *bucket = find_bucket(set, key, hash);
+	return bucket->key.buf == NULL ? NULL : bucket;
+}
+
+int cu_hs_reserve(cu_hs *set, uint64_t nel)
+{
+	if (nel <= set->capacity / FILL_FACTOR)
+		return 0;
+	uint64_t new_capacity = cu_bit_ceil(nel * FILL_FACTOR);
+	if (new_capacity < MIN_CAPACITY)
+		new_capacity = MIN_CAPACITY;
+	cu_hs_bucket *new_arr =
+		cu_allocarray(new_capacity, sizeof(cu_hs_bucket), set->alloc);
+	if (new_arr == NULL)
+		return -1;
+	memset(new_arr, 0, new_capacity * sizeof(cu_hs_bucket));
+
+	cu_hs old = *set;
+	set->arr = new_arr;
+	set->capacity = new_capacity;
+	set->nel = 0;
+	for (uint64_t i = 0; i < old.capacity; ++i) {
+		if (old.arr[i].key.buf != NULL)
+			place_unsafe(set, old.arr[i].key, old.arr[i].hash);
+	}
+	cu_hs_free(&old);
+	return 0;
+}
+
+int cu_hs_insert_hashed(cu_hs *set, cu_str key, uint64_t hash,
+	bool *inserted)
+{
+	bool is_new = !cu_hs_contains_hashed(set, key, hash);
+	if (inserted != NULL)
+		*inserted = is_new;
+	if (!is_new)
+		return 0;
+	if (cu_hs_reserve(set, set->nel + 1) != 0)
+		return -1;
+	place_unsafe(set, key, hash);
+	return 0;
+}
+
+bool cu_hs_erase_hashed(cu_hs *set, cu_str key, uint64_t hash)
+{
+	if (set->nel == 0)
+		return false;
+	cu_hs_bucket *bucket = find_bucket(set, key, hash);
+	if (bucket->key.buf == NULL)
+		return false;
+
+	// backward-shift deletion, see cu_hm_erase_at
+	uint64_t mask = set->capacity - 1;
+	uint64_t hole = bucket - set->arr;
+	for (uint64_t i = (hole + 1) & mask;
+		set->arr[i].key.buf != NULL;
+		i = (i + 1) & mask
+	) {
+		uint64_t home = set->arr[i].hash & mask;
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			set->arr[hole] = set->arr[i];
+			hole = i;
+		}
+	}
+	set->arr[hole] = (cu_hs_bucket){.key = CU_NIL_STR};
+	--set->nel;
+	return true;
+}
+
+// The hash of a key from `from` in the set `to`, reusing the cached hash if
+// both sets have the same SipHash key.
+static inline uint64_t
+hash_in(const cu_hs *to, const cu_hs *from, const cu_hs_bucket *bucket)
+{
+	if (memcmp(&to->key, &from->key, sizeof(cu_siphash_key)) == 0)
+		return bucket->hash;
+	return cu_hs_hash(to, bucket->key);
+}
+
+int cu_hs_union(cu_hs *dst, const cu_hs *a, const cu_hs *b)
+{
+	cu_hs_new_with_key(dst, a->alloc, &a->key);
+	// room for both, in case they're disjoint, so `dst` never grows
+	if (cu_hs_reserve(dst, a->nel + b->nel) != 0)
+		return -1;
+
+	// keys in `a` are distinct, so they can be placed without comparing
+	cu_hs_iter iter = cu_hs_begin(a);
+	const cu_hs_bucket *bucket;
+	while ((bucket = cu_hs_next(&iter)) != NULL)
+		place_unsafe(dst, bucket->key, bucket->hash);
+
+	iter = cu_hs_begin(b);
+	while ((bucket = cu_hs_next(&iter)) != NULL) {
+		uint64_t hash = hash_in(dst, b, bucket);
+		if (cu_hs_insert_hashed(dst, bucket->key, hash, NULL) != 0) {
+			cu_hs_free(dst);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int cu_hs_intersection(cu_hs *dst, const cu_hs *a, const cu_hs *b)
+{
+	cu_hs_new_with_key(dst, a->alloc, &a->key);
+	// only the smaller set has to be walked
+	const cu_hs *smaller = a->nel <= b->nel ? a : b;
+	const cu_hs *larger = smaller == a ? b : a;
+	if (cu_hs_reserve(dst, smaller->nel) != 0)
+		return -1;
+
+	cu_hs_iter iter = cu_hs_begin(smaller);
+	const cu_hs_bucket *bucket;
+	while ((bucket = cu_hs_next(&iter)) != NULL) {
+		uint64_t hash = hash_in(larger, smaller, bucket);
+		if (!cu_hs_contains_hashed(larger, bucket->key, hash))
+			continue;
+		place_unsafe(dst, bucket->key, hash_in(dst, smaller, bucket));
+	}
+	return 0;
+}
+
+int cu_hs_difference(cu_hs *dst, const cu_hs *a, const cu_hs *b)
+{
+	cu_hs_new_with_key(dst, a->alloc, &a->key);
+	if (cu_hs_reserve(dst, a->nel) != 0)
+		return -1;
+
+	cu_hs_iter iter = cu_hs_begin(a);
+	const cu_hs_bucket *bucket;
+	while ((bucket = cu_hs_next(&iter)) != NULL) {
+		uint64_t hash = hash_in(b, a, bucket);
+		if (!cu_hs_contains_hashed(b, bucket->key, hash))
+			place_unsafe(dst, bucket->key, bucket->hash);
+	}
+	return 0;
+}
+
+const cu_hs_bucket *cu_hs_next(cu_hs_iter *iter)
+{
+	const cu_hs *set = iter->set;
+	while (iter->index < set->capacity) {
+		const cu_hs_bucket *bucket = set->arr + iter->index++;
+		if (bucket->key.buf != NULL)
+			return bucket;
+	}
+	return NULL;
+}
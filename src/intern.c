@@ -0,0 +1,101 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cu/intern.h>
+
+#define MIN_CAPACITY 16
+
+// strings looked up at once by cu_intern_many
+#define BATCH_SIZE 64
+
+int cu_intern_new(cu_intern *table, cu_alloc *alloc, size_t arena_blocksize)
+{
+	*table = (cu_intern){
+		.alloc = alloc,
+	};
+	if (cu_hm_new(&table->map, alloc) != 0)
+		return -1;
+	table->arena = cu_arena_new(arena_blocksize, alloc);
+	return table->arena == NULL ? -1 : 0;
+}
+
+void cu_intern_free(cu_intern *table)
+{
+	cu_hm_free(&table->map);
+	cu_freearray(table->strs, table->strs_capacity, sizeof(cu_str),
+		table->alloc);
+	cu_arena_free(table->arena);
+}
+
+// Makes room in `strs` for one more ID.
+static int grow_strs(cu_intern *table)
+{
+	if (table->nel < table->strs_capacity)
+		return 0;
+	// the last ID is kept free so that ID + 1 fits in 32 bits too
+	if (table->strs_capacity == UINT32_MAX)
+		return -1;
+	uint64_t new_capacity = table->strs_capacity == 0
+		? MIN_CAPACITY
+		: (uint64_t)table->strs_capacity * 2;
+	if (new_capacity > UINT32_MAX)
+		new_capacity = UINT32_MAX;
+	if (cu_try_reallocarray((void **)&table->strs, new_capacity,
+		table->strs_capacity, sizeof(cu_str), table->alloc) != 0
+	) {
+		return -1;
+	}
+	table->strs_capacity = (uint32_t)new_capacity;
+	return 0;
+}
+
+int cu_intern_str(cu_intern *table, cu_str str, uint32_t *id)
+{
+	if (grow_strs(table) != 0)
+		return -1;
+	uint64_t hash = cu_hm_hash(&table->map, str);
+	bool inserted = false;
+	cu_hm_bucket *bucket =
+		cu_hm_get_or_insert_hashed(&table->map, str, hash, &inserted);
+	if (bucket == NULL)
+		return -1;
+	if (!inserted) {
+		*id = (uint32_t)((uintptr_t)bucket->value - 1);
+		return 0;
+	}
+
+	cu_str copy = cu_str_arena_copy(str, table->arena);
+	if (cu_str_isnil(copy)) {
+		cu_hm_erase_hashed(&table->map, str, hash);
+		return -1;
+	}
+	bucket->key = copy;
+	bucket->value = (void *)(uintptr_t)(table->nel + 1);
+	table->strs[table->nel] = bucket->key;
+	*id = table->nel++;
+	return 0;
+}
+
+int cu_intern_many(cu_intern *table, const cu_str *strs, size_t n,
+	uint32_t *ids)
+{
+	void *values[BATCH_SIZE];
+	for (size_t start = 0; start < n; start += BATCH_SIZE) {
+		size_t batch = n - start < BATCH_SIZE ? n - start : BATCH_SIZE;
+		cu_hm_at_many(&table->map, strs + start, batch, values);
+		for (size_t i = 0; i < batch; ++i) {
+			if (values[i] != NULL) {
+				ids[start + i] =
+					(uint32_t)((uintptr_t)values[i] - 1);
+			} else if (cu_intern_str(table, strs[start + i],
+				ids + start + i) != 0
+			) {
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,50 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cu/keystore.h>
+
+int cu_keystore_new(cu_keystore *store, cu_alloc *alloc,
+	size_t arena_blocksize)
+{
+	if (cu_hs_new(&store->set, alloc) != 0)
+		return -1;
+	store->arena = cu_arena_new(arena_blocksize, alloc);
+	return store->arena == NULL ? -1 : 0;
+}
+
+void cu_keystore_free(cu_keystore *store)
+{
+	cu_hs_free(&store->set);
+	cu_arena_free(store->arena);
+}
+
+cu_str cu_keystore_intern(cu_keystore *store, cu_str key)
+{
+	uint64_t hash = cu_hs_hash(&store->set, key);
+	const cu_hs_bucket *bucket =
+		cu_hs_find_hashed(&store->set, key, hash);
+	if (bucket != NULL)
+		return bucket->key;
+
+	// room in the set is made first, so a failed insert can't leave an
+	// unused copy behind in the arena
+	if (cu_hs_reserve(&store->set, store->set.nel + 1) != 0)
+		return CU_NIL_STR;
+	cu_str handle = cu_str_arena_copy(key, store->arena);
+	if (cu_str_isnil(handle))
+		return CU_NIL_STR;
+	int retval = cu_hs_insert_hashed(&store->set, handle, hash, NULL);
+	assert(retval == 0 && "Reserved space but still failed to insert");
+	(void)retval;
+	return handle;
+}
+
+cu_str cu_keystore_find(const cu_keystore *store, cu_str key)
+{
+	const cu_hs_bucket *bucket = cu_hs_find_hashed(
+		&store->set, key, cu_hs_hash(&store->set, key));
+	return bucket == NULL ? CU_NIL_STR : bucket->key;
+}
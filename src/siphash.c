@@ -10,6 +10,21 @@
 #include <limits.h>
 #include <string.h>
 
+// GCC and Clang can compile AVX2 and AVX-512 functions into a library built
+// for plain x86, and check at runtime whether the CPU has them
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)\
+	&& !defined(CU_SIPHASH_NO_SIMD)
+#	define CU_SIPHASH_X86
+#	include <immintrin.h>
+#endif
+
+// On little-endian targets a message word is just an unaligned load. MSVC
+// only targets little-endian platforms and doesn't define __BYTE_ORDER__.
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)\
+	|| defined(_MSC_VER)
+#	define CU_SIPHASH_LITTLE_ENDIAN
+#endif
+
 const uint64_t SIPHASH_CONSTS[4] = {
 	UINT64_C(0x736f6d6570736575),
 	UINT64_C(0x646f72616e646f6d),
@@ -52,6 +67,11 @@ static void get_state(
 
 static inline uint64_t parse_little_endian(const uint8_t *buf)
 {
+#ifdef CU_SIPHASH_LITTLE_ENDIAN
+	uint64_t word;
+	memcpy(&word, buf, sizeof(word));
+	return word;
+#else
 	uint64_t outval = 0;
 	outval |= (uint64_t)buf[0];
 	outval |= (uint64_t)buf[1] << 8;
@@ -62,6 +82,23 @@ static inline uint64_t parse_little_endian(const uint8_t *buf)
 	outval |= (uint64_t)buf[6] << 48;
 	outval |= (uint64_t)buf[7] << 56;
 	return outval;
+#endif
+}
+
+static inline uint64_t parse_little_endian32(const uint8_t *buf)
+{
+#ifdef CU_SIPHASH_LITTLE_ENDIAN
+	uint32_t word;
+	memcpy(&word, buf, sizeof(word));
+	return word;
+#else
+	uint64_t outval = 0;
+	outval |= (uint64_t)buf[0];
+	outval |= (uint64_t)buf[1] << 8;
+	outval |= (uint64_t)buf[2] << 16;
+	outval |= (uint64_t)buf[3] << 24;
+	return outval;
+#endif
 }
 
 static inline uint64_t rotl(uint64_t val, unsigned amount)
@@ -90,45 +127,505 @@ static inline void SipRound(uint64_t *state)
         state[2] = rotl(state[2], 32);
 }
 
-static inline void process_msg_word(uint64_t *state, uint64_t word) {
+static inline void
+process_msg_word_rounds(uint64_t *state, uint64_t word, size_t c)
+{
 	state[3] ^= word; 
-	for (size_t j = 0; j < SIPHASH_C; ++j) {
+	for (size_t j = 0; j < c; ++j) {
 		SipRound(state);
 	}
 	state[0] ^= word;
 }
 
-static inline uint64_t pad_u64(const uint8_t *buf, size_t nbytes)
+static inline void process_msg_word(uint64_t *state, uint64_t word) {
+	process_msg_word_rounds(state, word, SIPHASH_C);
+}
+
+// The bytes of a `len` byte message past its last full word, zero-padded.
+//
+// Nothing outside the message is read, so when there's an earlier word to
+// overlap with, the last 8 bytes are loaded at once and the ones already
+// hashed are shifted out. Shorter messages use two overlapping 4-byte loads,
+// or the first, middle and last bytes.
+static inline uint64_t get_tail(const uint8_t *buf, size_t len)
 {
-	assert(nbytes < 8);
-	uint8_t tmp_buf[8] = {0};
-	memcpy(tmp_buf, buf, nbytes);
-	return parse_little_endian(tmp_buf);
+	size_t nbytes = len % 8;
+	const uint8_t *tail = buf + len - nbytes;
+	if (nbytes == 0)
+		return 0;
+	if (len >= 8)
+		return parse_little_endian(buf + len - 8) >> (64 - nbytes * 8);
+	if (nbytes >= 4) {
+		return parse_little_endian32(tail)
+			| parse_little_endian32(tail + nbytes - 4)
+				<< ((nbytes - 4) * 8);
+	}
+	return (uint64_t)tail[0]
+		| (uint64_t)tail[nbytes / 2] << (nbytes / 2 * 8)
+		| (uint64_t)tail[nbytes - 1] << ((nbytes - 1) * 8);
 }
 
 static inline uint64_t get_last(const uint8_t *buf, size_t len)
 {
-	size_t lastind = (len / 8) * 8;
-	uint64_t val = pad_u64(buf + lastind, len - lastind);
+	uint64_t val = get_tail(buf, len);
 	val |= ((uint64_t)len & 0xFF) << 56;
 	return val;
 }
 
+// Feeds the whole message into `state`, including the final word.
+static inline void absorb(
+	uint64_t *state,
+	const uint8_t *buf,
+	size_t size,
+	size_t c
+) {
+	for (size_t i = 0; i < size / 8; ++i) {
+		process_msg_word_rounds(state, parse_little_endian(buf + i * 8),
+			c);
+	}
+	process_msg_word_rounds(state, get_last(buf, size), c);
+}
+
+static inline uint64_t finalize(uint64_t *state, uint64_t fin, size_t d)
+{
+	state[2] ^= fin;
+	for (size_t i = 0; i < d; ++i) {
+		SipRound(state);
+	}
+	return state[0] ^ state[1] ^ state[2] ^ state[3];
+}
+
+// SipHash-c-d, with the round counts inlined by each caller
+static inline uint64_t siphash(
+	const cu_siphash_key *key,
+	const uint8_t *buf,
+	size_t size,
+	size_t c,
+	size_t d
+) {
+	uint64_t state[4];
+	get_state(state, key);
+	absorb(state, buf, size, c);
+	return finalize(state, 0xFF, d);
+}
+
 uint64_t cu_siphash_hash(
 	const cu_siphash_key *key,
 	const uint8_t *buf,
 	size_t size
+) {
+	return siphash(key, buf, size, SIPHASH_C, SIPHASH_D);
+}
+
+uint64_t cu_siphash24_hash(
+	const cu_siphash_key *key,
+	const uint8_t *buf,
+	size_t size
+) {
+	return siphash(key, buf, size, 2, 4);
+}
+
+// The 128-bit output only changes the constants mixed into the state and
+// adds a second round of finalization, so it costs `SIPHASH_D` more rounds.
+void cu_siphash128_hash(
+	const cu_siphash_key *key,
+	const uint8_t *buf,
+	size_t size,
+	uint64_t out[2]
 ) {
 	uint64_t state[4];
 	get_state(state, key);
-	for (size_t i = 0; i < size / 8; ++i) {
-		process_msg_word(state, parse_little_endian(buf + i * 8));
+	state[1] ^= 0xEE;
+	absorb(state, buf, size, SIPHASH_C);
+	out[0] = finalize(state, 0xEE, SIPHASH_D);
+	state[1] ^= 0xDD;
+	out[1] = finalize(state, 0, SIPHASH_D);
+}
+
+// HalfSipHash is SipHash scaled down to 32-bit words, with its own rotation
+// amounts and constants, keyed with the first half of a `cu_siphash_key`.
+
+static inline uint32_t rotl32(uint32_t val, unsigned amount)
+{
+	return (val << amount) | (val >> (32 - amount));
+}
+
+static inline void HalfSipRound(uint32_t *state)
+{
+	state[0] += state[1];
+	state[1] = rotl32(state[1], 5);
+	state[1] ^= state[0];
+	state[0] = rotl32(state[0], 16);
+
+	state[2] += state[3];
+	state[3] = rotl32(state[3], 8);
+	state[3] ^= state[2];
+
+	state[0] += state[3];
+	state[3] = rotl32(state[3], 7);
+	state[3] ^= state[0];
+
+	state[2] += state[1];
+	state[1] = rotl32(state[1], 13);
+	state[1] ^= state[2];
+	state[2] = rotl32(state[2], 16);
+}
+
+static inline void half_process_msg_word(uint32_t *state, uint32_t word)
+{
+	state[3] ^= word;
+	for (size_t j = 0; j < SIPHASH_C; ++j) {
+		HalfSipRound(state);
 	}
-	process_msg_word(state, get_last(buf, size));
-	state[2] ^= 0xFF;
+	state[0] ^= word;
+}
+
+// Like `get_last', with 4-byte words.
+static inline uint32_t half_get_last(const uint8_t *buf, size_t len)
+{
+	size_t nbytes = len % 4;
+	const uint8_t *tail = buf + len - nbytes;
+	uint32_t val = 0;
+	if (nbytes != 0 && len >= 4) {
+		val = (uint32_t)(parse_little_endian32(buf + len - 4)
+			>> (32 - nbytes * 8));
+	} else if (nbytes != 0) {
+		val = (uint32_t)tail[0]
+			| (uint32_t)tail[nbytes / 2] << (nbytes / 2 * 8)
+			| (uint32_t)tail[nbytes - 1] << ((nbytes - 1) * 8);
+	}
+	return val | ((uint32_t)len & 0xFF) << 24;
+}
+
+static inline uint32_t half_finalize(uint32_t *state, uint32_t fin)
+{
+	state[2] ^= fin;
 	for (size_t i = 0; i < SIPHASH_D; ++i) {
-		SipRound(state);
+		HalfSipRound(state);
 	}
-	return state[0] ^ state[1] ^ state[2] ^ state[3];
+	return state[1] ^ state[3];
+}
+
+static inline void half_absorb(
+	uint32_t *state,
+	const cu_siphash_key *key,
+	const uint8_t *buf,
+	size_t size,
+	uint32_t init
+) {
+	uint32_t k0 = (uint32_t)key->key[0];
+	uint32_t k1 = (uint32_t)(key->key[0] >> 32);
+	state[0] = k0;
+	state[1] = k1 ^ init;
+	state[2] = UINT32_C(0x6c796765) ^ k0;
+	state[3] = UINT32_C(0x74656462) ^ k1;
+	for (size_t i = 0; i < size / 4; ++i) {
+		half_process_msg_word(state,
+			(uint32_t)parse_little_endian32(buf + i * 4));
+	}
+	half_process_msg_word(state, half_get_last(buf, size));
 }
 
+uint32_t cu_halfsiphash_hash(
+	const cu_siphash_key *key,
+	const uint8_t *buf,
+	size_t size
+) {
+	uint32_t state[4];
+	half_absorb(state, key, buf, size, 0);
+	return half_finalize(state, 0xFF);
+}
+
+uint64_t cu_halfsiphash64_hash(
+	const cu_siphash_key *key,
+	const uint8_t *buf,
+	size_t size
+) {
+	uint32_t state[4];
+	half_absorb(state, key, buf, size, 0xEE);
+	uint64_t lo = half_finalize(state, 0xEE);
+	state[1] ^= 0xDD;
+	uint64_t hi = half_finalize(state, 0);
+	return lo | hi << 32;
+}
+
+
+void cu_siphash_state_init(cu_siphash_state *state, const cu_siphash_key *key)
+{
+	get_state(state->v, key);
+	state->tail = 0;
+	state->len = 0;
+}
+
+void cu_siphash_update(
+	cu_siphash_state *state,
+	const uint8_t *buf,
+	size_t size
+) {
+	size_t pending = state->len % 8;
+	state->len += size;
+
+	// topping up the word left over from last time
+	if (pending != 0) {
+		for (; pending < 8 && size > 0; ++pending, ++buf, --size)
+			state->tail |= (uint64_t)*buf << (pending * 8);
+		if (pending < 8)
+			return;
+		process_msg_word(state->v, state->tail);
+		state->tail = 0;
+	}
+
+	for (; size >= 8; size -= 8, buf += 8)
+		process_msg_word(state->v, parse_little_endian(buf));
+	for (size_t i = 0; i < size; ++i)
+		state->tail |= (uint64_t)buf[i] << (i * 8);
+}
+
+uint64_t cu_siphash_final(const cu_siphash_state *state)
+{
+	uint64_t v[4];
+	memcpy(v, state->v, sizeof(v));
+	process_msg_word(v, state->tail | (state->len & 0xFF) << 56);
+	return finalize(v, 0xFF, SIPHASH_D);
+}
+
+#ifdef CU_SIPHASH_X86
+
+// Each vector holds one of v0..v3 for every message being hashed.
+//
+// Lanes run in lockstep, so once a message's words have run out, the state
+// from before each further word is blended back into its lane.
+
+// The `i`th word fed into the state for one lane, given the lane's final word
+// that holds the leftover bytes and the length. Lanes that are already done
+// get 0, which is ignored.
+static inline uint64_t lane_word(
+	const uint8_t *buf,
+	uint64_t nwords,
+	uint64_t last,
+	uint64_t i
+) {
+	if (i + 1 < nwords)
+		return parse_little_endian(buf + i * 8);
+	return i + 1 == nwords ? last : 0;
+}
+
+#define CU_AVX2 __attribute__((target("avx2")))
+#define CU_AVX512 __attribute__((target("avx512f")))
+
+#define ROTL_AVX2(v, n) _mm256_or_si256(\
+	_mm256_slli_epi64((v), (n)), _mm256_srli_epi64((v), 64 - (n)))
+#define SWAP_HALVES_AVX2(v) _mm256_shuffle_epi32((v), _MM_SHUFFLE(2, 3, 0, 1))
+
+CU_AVX2 static inline void SipRound_avx2(__m256i *v)
+{
+	v[0] = _mm256_add_epi64(v[0], v[1]);
+	v[1] = ROTL_AVX2(v[1], 13);
+	v[1] = _mm256_xor_si256(v[1], v[0]);
+	v[0] = SWAP_HALVES_AVX2(v[0]);
+
+	v[2] = _mm256_add_epi64(v[2], v[3]);
+	v[3] = ROTL_AVX2(v[3], 16);
+	v[3] = _mm256_xor_si256(v[3], v[2]);
+
+	v[0] = _mm256_add_epi64(v[0], v[3]);
+	v[3] = ROTL_AVX2(v[3], 21);
+	v[3] = _mm256_xor_si256(v[3], v[0]);
+
+	v[2] = _mm256_add_epi64(v[2], v[1]);
+	v[1] = ROTL_AVX2(v[1], 17);
+	v[1] = _mm256_xor_si256(v[1], v[2]);
+	v[2] = SWAP_HALVES_AVX2(v[2]);
+}
+
+CU_AVX2 static inline void compress_avx2(__m256i *v, __m256i m)
+{
+	v[3] = _mm256_xor_si256(v[3], m);
+	for (size_t j = 0; j < SIPHASH_C; ++j)
+		SipRound_avx2(v);
+	v[0] = _mm256_xor_si256(v[0], m);
+}
+
+CU_AVX2 static void hash_x4_avx2(
+	const cu_siphash_key *key,
+	const uint8_t *const bufs[4],
+	const size_t sizes[4],
+	uint64_t out[4]
+) {
+	uint64_t init[4];
+	get_state(init, key);
+	__m256i v[4];
+	for (size_t j = 0; j < 4; ++j)
+		v[j] = _mm256_set1_epi64x((long long)init[j]);
+
+	// the final words need a few branches, which are kept out of the loop
+	uint64_t nwords[4];
+	uint64_t last[4];
+	uint64_t min_words = UINT64_MAX;
+	uint64_t max_words = 0;
+	for (size_t l = 0; l < 4; ++l) {
+		nwords[l] = sizes[l] / 8 + 1;
+		last[l] = get_last(bufs[l], sizes[l]);
+		min_words = nwords[l] < min_words ? nwords[l] : min_words;
+		max_words = nwords[l] > max_words ? nwords[l] : max_words;
+	}
+	__m256i lane_words = _mm256_loadu_si256((const __m256i *)nwords);
+
+	// the words every lane has, then the ones some lanes sit out
+	uint64_t i = 0;
+	for (; i + 1 < min_words; ++i) {
+		compress_avx2(v, _mm256_set_epi64x(
+			(long long)parse_little_endian(bufs[3] + i * 8),
+			(long long)parse_little_endian(bufs[2] + i * 8),
+			(long long)parse_little_endian(bufs[1] + i * 8),
+			(long long)parse_little_endian(bufs[0] + i * 8)));
+	}
+	for (; i < max_words; ++i) {
+		uint64_t w[4];
+		for (size_t l = 0; l < 4; ++l)
+			w[l] = lane_word(bufs[l], nwords[l], last[l], i);
+		__m256i old[4] = {v[0], v[1], v[2], v[3]};
+		compress_avx2(v, _mm256_set_epi64x((long long)w[3],
+			(long long)w[2], (long long)w[1], (long long)w[0]));
+		if (i >= min_words) {
+			__m256i active = _mm256_cmpgt_epi64(lane_words,
+				_mm256_set1_epi64x((long long)i));
+			for (size_t j = 0; j < 4; ++j)
+				v[j] = _mm256_blendv_epi8(old[j], v[j], active);
+		}
+	}
+
+	v[2] = _mm256_xor_si256(v[2], _mm256_set1_epi64x(0xFF));
+	for (size_t j = 0; j < SIPHASH_D; ++j)
+		SipRound_avx2(v);
+	__m256i hash = _mm256_xor_si256(_mm256_xor_si256(v[0], v[1]),
+		_mm256_xor_si256(v[2], v[3]));
+	_mm256_storeu_si256((__m256i *)out, hash);
+}
+
+CU_AVX512 static inline void SipRound_avx512(__m512i *v)
+{
+	v[0] = _mm512_add_epi64(v[0], v[1]);
+	v[1] = _mm512_rol_epi64(v[1], 13);
+	v[1] = _mm512_xor_si512(v[1], v[0]);
+	v[0] = _mm512_rol_epi64(v[0], 32);
+
+	v[2] = _mm512_add_epi64(v[2], v[3]);
+	v[3] = _mm512_rol_epi64(v[3], 16);
+	v[3] = _mm512_xor_si512(v[3], v[2]);
+
+	v[0] = _mm512_add_epi64(v[0], v[3]);
+	v[3] = _mm512_rol_epi64(v[3], 21);
+	v[3] = _mm512_xor_si512(v[3], v[0]);
+
+	v[2] = _mm512_add_epi64(v[2], v[1]);
+	v[1] = _mm512_rol_epi64(v[1], 17);
+	v[1] = _mm512_xor_si512(v[1], v[2]);
+	v[2] = _mm512_rol_epi64(v[2], 32);
+}
+
+CU_AVX512 static inline void compress_avx512(__m512i *v, __m512i m)
+{
+	v[3] = _mm512_xor_si512(v[3], m);
+	for (size_t j = 0; j < SIPHASH_C; ++j)
+		SipRound_avx512(v);
+	v[0] = _mm512_xor_si512(v[0], m);
+}
+
+CU_AVX512 static void hash_x8_avx512(
+	const cu_siphash_key *key,
+	const uint8_t *const bufs[8],
+	const size_t sizes[8],
+	uint64_t out[8]
+) {
+	uint64_t init[4];
+	get_state(init, key);
+	__m512i v[4];
+	for (size_t j = 0; j < 4; ++j)
+		v[j] = _mm512_set1_epi64((long long)init[j]);
+
+	// the final words need a few branches, which are kept out of the loop
+	uint64_t nwords[8];
+	uint64_t last[8];
+	uint64_t min_words = UINT64_MAX;
+	uint64_t max_words = 0;
+	for (size_t l = 0; l < 8; ++l) {
+		nwords[l] = sizes[l] / 8 + 1;
+		last[l] = get_last(bufs[l], sizes[l]);
+		min_words = nwords[l] < min_words ? nwords[l] : min_words;
+		max_words = nwords[l] > max_words ? nwords[l] : max_words;
+	}
+	__m512i lane_words = _mm512_loadu_si512(nwords);
+
+	// the words every lane has, then the ones some lanes sit out
+	uint64_t i = 0;
+	for (; i + 1 < min_words; ++i) {
+		compress_avx512(v, _mm512_set_epi64(
+			(long long)parse_little_endian(bufs[7] + i * 8),
+			(long long)parse_little_endian(bufs[6] + i * 8),
+			(long long)parse_little_endian(bufs[5] + i * 8),
+			(long long)parse_little_endian(bufs[4] + i * 8),
+			(long long)parse_little_endian(bufs[3] + i * 8),
+			(long long)parse_little_endian(bufs[2] + i * 8),
+			(long long)parse_little_endian(bufs[1] + i * 8),
+			(long long)parse_little_endian(bufs[0] + i * 8)));
+	}
+	for (; i < max_words; ++i) {
+		uint64_t w[8];
+		for (size_t l = 0; l < 8; ++l)
+			w[l] = lane_word(bufs[l], nwords[l], last[l], i);
+		__m512i old[4] = {v[0], v[1], v[2], v[3]};
+		compress_avx512(v, _mm512_set_epi64((long long)w[7],
+			(long long)w[6], (long long)w[5], (long long)w[4],
+			(long long)w[3], (long long)w[2], (long long)w[1],
+			(long long)w[0]));
+		if (i >= min_words) {
+			__mmask8 active = _mm512_cmpgt_epu64_mask(lane_words,
+				_mm512_set1_epi64((long long)i));
+			for (size_t j = 0; j < 4; ++j)
+				v[j] = _mm512_mask_mov_epi64(old[j], active,
+					v[j]);
+		}
+	}
+
+	v[2] = _mm512_xor_si512(v[2], _mm512_set1_epi64(0xFF));
+	for (size_t j = 0; j < SIPHASH_D; ++j)
+		SipRound_avx512(v);
+	__m512i hash = _mm512_xor_si512(_mm512_xor_si512(v[0], v[1]),
+		_mm512_xor_si512(v[2], v[3]));
+	_mm512_storeu_si512(out, hash);
+}
+
+#endif // CU_SIPHASH_X86
+
+void cu_siphash_hash_x4(
+	const cu_siphash_key *key,
+	const uint8_t *const bufs[4],
+	const size_t sizes[4],
+	uint64_t out[4]
+) {
+#ifdef CU_SIPHASH_X86
+	if (__builtin_cpu_supports("avx2")) {
+		hash_x4_avx2(key, bufs, sizes, out);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < 4; ++i)
+		out[i] = cu_siphash_hash(key, bufs[i], sizes[i]);
+}
+
+void cu_siphash_hash_x8(
+	const cu_siphash_key *key,
+	const uint8_t *const bufs[8],
+	const size_t sizes[8],
+	uint64_t out[8]
+) {
+#ifdef CU_SIPHASH_X86
+	if (__builtin_cpu_supports("avx512f")) {
+		hash_x8_avx512(key, bufs, sizes, out);
+		return;
+	}
+#endif
+	cu_siphash_hash_x4(key, bufs, sizes, out);
+	cu_siphash_hash_x4(key, bufs + 4, sizes + 4, out + 4);
+}
@@ -0,0 +1,154 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+// Based on https://github.com/wangyi-fudan/wyhash, which is in the public
+// domain.
+
+#include <cu/wyhash.h>
+#include <string.h>
+
+#if defined(_MSC_VER) && defined(_M_X64) && !defined(__SIZEOF_INT128__)
+#	include <intrin.h>
+#endif
+
+static const uint64_t WYHASH_SECRET[4] = {
+	UINT64_C(0x2d358dccaa6c78a5),
+	UINT64_C(0x8bb84b93962eacc9),
+	UINT64_C(0x4b33a62ed433d4a3),
+	UINT64_C(0x4d5a2da51de1aa47),
+};
+
+// Multiplies `*a` and `*b`, leaving the low half of the product in `*a` and
+// the high half in `*b`, using only 64-bit multiplies.
+static inline void mum_portable(uint64_t *a, uint64_t *b)
+{
+	uint64_t ha = *a >> 32;
+	uint64_t hb = *b >> 32;
+	uint64_t la = (uint32_t)*a;
+	uint64_t lb = (uint32_t)*b;
+	uint64_t rh = ha * hb;
+	uint64_t rm0 = ha * lb;
+	uint64_t rm1 = hb * la;
+	uint64_t rl = la * lb;
+	uint64_t t = rl + (rm0 << 32);
+	uint64_t carry = t < rl;
+	uint64_t lo = t + (rm1 << 32);
+	carry += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+}
+
+static inline void mum(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+	// __extension__ keeps -Wpedantic quiet about __int128
+	__extension__ typedef unsigned __int128 u128;
+	u128 r = (u128)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	*a = _umul128(*a, *b, b);
+#else
+	mum_portable(a, b);
+#endif
+}
+
+static inline uint64_t mix(uint64_t a, uint64_t b)
+{
+	mum(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t read64(const uint8_t *buf)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint64_t val;
+	memcpy(&val, buf, sizeof(val));
+	return val;
+#else
+	uint64_t val = 0;
+	for (size_t i = 0; i < 8; ++i)
+		val |= (uint64_t)buf[i] << (i * 8);
+	return val;
+#endif
+}
+
+static inline uint64_t read32(const uint8_t *buf)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint32_t val;
+	memcpy(&val, buf, sizeof(val));
+	return val;
+#else
+	uint64_t val = 0;
+	for (size_t i = 0; i < 4; ++i)
+		val |= (uint64_t)buf[i] << (i * 8);
+	return val;
+#endif
+}
+
+// 1 to 3 bytes, reading the first, middle and last ones
+static inline uint64_t read_small(const uint8_t *buf, size_t size)
+{
+	return ((uint64_t)buf[0] << 16) | ((uint64_t)buf[size >> 1] << 8)
+		| buf[size - 1];
+}
+
+uint64_t cu_wyhash(const cu_siphash_key *key, const uint8_t *buf, size_t size)
+{
+	const uint64_t *secret = WYHASH_SECRET;
+	uint64_t seed = key->key[0];
+	seed ^= mix(seed ^ secret[0], secret[1] ^ key->key[1]);
+
+	uint64_t a;
+	uint64_t b;
+	if (size <= 16) {
+		if (size >= 4) {
+			// two overlapping pairs of 4-byte reads cover 4 to 16
+			// bytes without branching on the exact length
+			size_t mid = (size >> 3) << 2;
+			a = (read32(buf) << 32) | read32(buf + mid);
+			b = (read32(buf + size - 4) << 32)
+				| read32(buf + size - 4 - mid);
+		} else if (size > 0) {
+			a = read_small(buf, size);
+			b = 0;
+		} else {
+			a = 0;
+			b = 0;
+		}
+	} else {
+		size_t left = size;
+		if (left > 48) {
+			uint64_t see1 = seed;
+			uint64_t see2 = seed;
+			do {
+				seed = mix(read64(buf) ^ secret[1],
+					read64(buf + 8) ^ seed);
+				see1 = mix(read64(buf + 16) ^ secret[2],
+					read64(buf + 24) ^ see1);
+				see2 = mix(read64(buf + 32) ^ secret[3],
+					read64(buf + 40) ^ see2);
+				buf += 48;
+				left -= 48;
+			} while (left > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (left > 16) {
+			seed = mix(read64(buf) ^ secret[1],
+				read64(buf + 8) ^ seed);
+			buf += 16;
+			left -= 16;
+		}
+		// the last 16 bytes, overlapping what was already mixed in
+		a = read64(buf + left - 16);
+		b = read64(buf + left - 8);
+	}
+	a ^= secret[1];
+	b ^= seed;
+	mum(&a, &b);
+	return mix(a ^ secret[0] ^ size, b ^ secret[1]);
+}
@@ -0,0 +1,24 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+// The "key%zu" keys shared by the string map and set tests.
+// Define NUM_KEYS before including this to use more or fewer of them.
+
+#include <stdio.h>
+#include <cu/string.h>
+
+#ifndef NUM_KEYS
+#define NUM_KEYS 1024
+#endif
+// room for "key" and any size_t
+#define KEY_LEN (sizeof "key" + 20)
+static char KEY_STORAGE[NUM_KEYS][KEY_LEN];
+
+static cu_str get_key(size_t i)
+{
+	snprintf(KEY_STORAGE[i], KEY_LEN, "key%zu", i);
+	return cu_str_from_cstr(KEY_STORAGE[i]);
+}
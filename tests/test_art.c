@@ -0,0 +1,243 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <stdint.h>
+#include <stdio.h>
+#include <cu/art.h>
+#include <cu/dbgassert.h>
+
+#define NUM_KEYS 2048
+#define KEY_LEN 32
+static char KEY_STORAGE[NUM_KEYS][KEY_LEN];
+static size_t KEY_LENS[NUM_KEYS];
+
+// Keys with long shared prefixes, keys that are prefixes of other keys, and
+// enough different bytes after "b" to need the largest nodes.
+static cu_str get_key(size_t i)
+{
+	if (i < 256) {
+		KEY_STORAGE[i][0] = 'b';
+		KEY_STORAGE[i][1] = (char)i;
+		KEY_LENS[i] = 2;
+	} else if (i < 512) {
+		KEY_LENS[i] = (size_t)snprintf(KEY_STORAGE[i], KEY_LEN,
+			"/api/v%zu", (i - 256) % 32);
+		if (i >= 256 + 32) {
+			KEY_LENS[i] = (size_t)snprintf(KEY_STORAGE[i], KEY_LEN,
+				"/api/v%zu/items/%zu", (i - 256) % 32, i);
+		}
+	} else {
+		KEY_LENS[i] = (size_t)snprintf(KEY_STORAGE[i], KEY_LEN,
+			"/static/%zx", (i * 2654435761u) & 0xFFFFF);
+	}
+	return (cu_str){.buf = (uint8_t *)KEY_STORAGE[i], .len = KEY_LENS[i]};
+}
+
+// Checks that iterating gives strictly ascending keys, each mapped to its
+// own storage, and returns how many there were.
+static size_t check_sorted(cu_art_iter iter)
+{
+	cu_str key;
+	cu_str prev = CU_NIL_STR;
+	void *value;
+	size_t count = 0;
+	while (cu_art_next(&iter, &key, &value)) {
+		cu_str expected = {.buf = value, .len = key.len};
+		dbgassert(cu_str_eq(key, expected));
+		if (!cu_str_isnil(prev))
+			dbgassert(cu_str_cmp(prev, key) < 0);
+		prev = key;
+		++count;
+	}
+	dbgassert(!cu_art_next(&iter, &key, &value));
+	return count;
+}
+
+static void test_insert_erase(void)
+{
+	cu_art tree;
+	dbgassert(cu_art_new(&tree, NULL, 4096) == 0);
+	dbgassert(cu_art_at(&tree, get_key(0)) == NULL);
+	dbgassert(cu_art_erase(&tree, get_key(0)) == NULL);
+	dbgassert(check_sorted(cu_art_begin(&tree)) == 0);
+
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		cu_str key = get_key(i);
+		dbgassert(cu_art_insert(&tree, key, KEY_STORAGE[i]) == 0);
+		dbgassert(cu_art_at(&tree, key) == KEY_STORAGE[i]);
+	}
+	dbgassert(tree.nel == NUM_KEYS);
+	dbgassert(check_sorted(cu_art_begin(&tree)) == NUM_KEYS);
+
+	// the tree keeps its own copies
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		char saved[KEY_LEN];
+		memcpy(saved, KEY_STORAGE[i], KEY_LEN);
+		memset(KEY_STORAGE[i], 'x', KEY_LEN);
+		cu_str key = {.buf = (uint8_t *)saved, .len = KEY_LENS[i]};
+		void *value = cu_art_at(&tree, key);
+		memcpy(KEY_STORAGE[i], saved, KEY_LEN);
+		dbgassert(value == KEY_STORAGE[i]);
+	}
+
+	// erasing every other key
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		cu_str key = get_key(i);
+		dbgassert(cu_art_erase(&tree, key) == KEY_STORAGE[i]);
+		dbgassert(cu_art_erase(&tree, key) == NULL);
+	}
+	dbgassert(tree.nel == NUM_KEYS / 2);
+	dbgassert(check_sorted(cu_art_begin(&tree)) == NUM_KEYS / 2);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		void *value = cu_art_at(&tree, get_key(i));
+		dbgassert(value == (i % 2 == 0 ? NULL : KEY_STORAGE[i]));
+	}
+
+	// and all the rest, leaving the tree empty
+	for (size_t i = 1; i < NUM_KEYS; i += 2) {
+		dbgassert(cu_art_erase(&tree, get_key(i)) == KEY_STORAGE[i]);
+	}
+	dbgassert(tree.nel == 0 && tree.root == NULL);
+	dbgassert(check_sorted(cu_art_begin(&tree)) == 0);
+
+	// the freed nodes are reused
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_art_insert(&tree, get_key(i), KEY_STORAGE[i])
+			== 0);
+	}
+	for (size_t i = 0; i < NUM_KEYS; ++i)
+		dbgassert(cu_art_at(&tree, get_key(i)) == KEY_STORAGE[i]);
+	cu_art_free(&tree);
+}
+
+static void test_longest_prefix(void)
+{
+	cu_art tree;
+	dbgassert(cu_art_new(&tree, NULL, 256) == 0);
+	static char *routes[] = {
+		"/", "/api", "/api/v1", "/api/v1/users", "/api/v2", "/static/",
+	};
+	enum { NROUTES = sizeof(routes) / sizeof(routes[0]) };
+	cu_str match;
+	dbgassert(cu_art_longest_prefix(&tree, cu_str_from_cstr("/api"),
+		&match) == NULL);
+	for (size_t i = 0; i < NROUTES; ++i) {
+		dbgassert(cu_art_insert(&tree, cu_str_from_cstr(routes[i]),
+			routes[i]) == 0);
+	}
+
+	static const struct {
+		char *url;
+		char *route;
+	} cases[] = {
+		{"/", "/"},
+		{"/index.html", "/"},
+		{"/ap", "/"},
+		{"/api", "/api"},
+		{"/api/", "/api"},
+		{"/api/v1", "/api/v1"},
+		{"/api/v1/users/42", "/api/v1/users"},
+		{"/api/v1/user", "/api/v1"},
+		{"/api/v3", "/api"},
+		{"/static/app.js", "/static/"},
+		{"/static", "/"},
+	};
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		void *value = cu_art_longest_prefix(&tree,
+			cu_str_from_cstr(cases[i].url), &match);
+		dbgassert(value != NULL && strcmp(value, cases[i].route) == 0);
+		dbgassert(cu_str_eq(match, cu_str_from_cstr(cases[i].route)));
+	}
+	dbgassert(cu_art_longest_prefix(&tree, cu_str_from_cstr("api"), NULL)
+		== NULL);
+	dbgassert(cu_art_longest_prefix(&tree, cu_str_from_cstr(""), NULL)
+		== NULL);
+
+	// the empty key is a prefix of everything
+	dbgassert(cu_art_insert(&tree, cu_str_from_cstr(""), routes) == 0);
+	dbgassert(cu_art_longest_prefix(&tree, cu_str_from_cstr("api"), NULL)
+		== routes);
+	dbgassert(cu_art_erase(&tree, cu_str_from_cstr("/api")) == routes[1]);
+	dbgassert(cu_art_longest_prefix(&tree, cu_str_from_cstr("/api/v3"),
+		NULL) == routes[0]);
+	cu_art_free(&tree);
+}
+
+static void test_prefix_iteration(void)
+{
+	cu_art tree;
+	dbgassert(cu_art_new(&tree, NULL, 4096) == 0);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_art_insert(&tree, get_key(i), KEY_STORAGE[i])
+			== 0);
+	}
+
+	// counting by hand what the iterators should give
+	static char *prefixes[] = {
+		"", "b", "/", "/api/v1", "/api/v1/", "/api/v1/items/2",
+		"/static/1", "/nope", "/api/v1/items/999999",
+	};
+	for (size_t p = 0; p < sizeof(prefixes) / sizeof(prefixes[0]); ++p) {
+		cu_str prefix = cu_str_from_cstr(prefixes[p]);
+		size_t expected = 0;
+		cu_art_iter all = cu_art_begin(&tree);
+		cu_str key;
+		while (cu_art_next(&all, &key, NULL)) {
+			if (key.len >= prefix.len
+				&& memcmp(key.buf, prefix.buf, prefix.len) == 0)
+			{
+				++expected;
+			}
+		}
+		dbgassert(check_sorted(cu_art_prefix(&tree, prefix))
+			== expected);
+	}
+	cu_art_free(&tree);
+}
+
+// Nodes shrink as children are erased. The root here outgrows one node of
+// each smaller size on the way up, and each time it shrinks, it takes the
+// next size down out of the free lists and leaves its old node there instead.
+static void test_shrink(void)
+{
+	cu_art tree;
+	dbgassert(cu_art_new(&tree, NULL, 4096) == 0);
+	for (size_t i = 0; i < 256; ++i) {
+		dbgassert(cu_art_insert(&tree, get_key(i), KEY_STORAGE[i])
+			== 0);
+	}
+	dbgassert(tree.free_nodes[3] == NULL);
+
+	for (size_t i = 255; i >= 3; --i) {
+		dbgassert(cu_art_erase(&tree, get_key(i)) == KEY_STORAGE[i]);
+		dbgassert((tree.free_nodes[3] == NULL) == (i > 37));
+		dbgassert((tree.free_nodes[2] == NULL) == (i > 12 && i <= 37));
+		dbgassert((tree.free_nodes[1] == NULL) == (i > 3 && i <= 12));
+		for (size_t j = 0; j < 256; ++j) {
+			void *value = cu_art_at(&tree, get_key(j));
+			dbgassert(value == (j < i ? KEY_STORAGE[j] : NULL));
+		}
+		dbgassert(check_sorted(cu_art_begin(&tree)) == i);
+	}
+
+	// and grows back, reusing the node it shrank out of
+	for (size_t i = 3; i < 256; ++i) {
+		dbgassert(cu_art_insert(&tree, get_key(i), KEY_STORAGE[i])
+			== 0);
+	}
+	dbgassert(tree.free_nodes[3] == NULL);
+	for (size_t i = 0; i < 256; ++i)
+		dbgassert(cu_art_at(&tree, get_key(i)) == KEY_STORAGE[i]);
+	cu_art_free(&tree);
+}
+
+int main(void)
+{
+	test_insert_erase();
+	test_shrink();
+	test_longest_prefix();
+	test_prefix_iteration();
+}
@@ -0,0 +1,12 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+// Runs the radix tree tests again, with the portable search of 16-child
+// nodes instead of SSE2.
+
+#define CU_ART_NO_SIMD
+#include "../src/art.c"
+#include "test_art.c"
@@ -0,0 +1,302 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cu/btree.h>
+#include <cu/dbgassert.h>
+
+#define NUM_KEYS 2000
+#define KEY_LEN 16
+static char KEY_STORAGE[NUM_KEYS][KEY_LEN];
+
+// zero-padded, so the keys sort the same way as their indices
+static cu_str get_key(size_t i)
+{
+	snprintf(KEY_STORAGE[i], KEY_LEN, "key%05zu", i);
+	return cu_str_from_cstr(KEY_STORAGE[i]);
+}
+
+// a permutation of 0..NUM_KEYS, since 7919 is prime
+static size_t shuffled(size_t i)
+{
+	return (i * 7919) % NUM_KEYS;
+}
+
+// Checks that iterating over `tree` gives exactly the keys marked in
+// `present`, in order, each with its own value.
+static void check_contents(const cu_btree *tree, const bool *present)
+{
+	cu_btree_iter iter = cu_btree_begin(tree);
+	cu_str key;
+	void *value;
+	size_t expected = 0;
+	uint64_t count = 0;
+	while (cu_btree_next(&iter, &key, &value)) {
+		while (!present[expected])
+			++expected;
+		dbgassert(cu_str_eq(key, get_key(expected)));
+		dbgassert(value == KEY_STORAGE[expected]);
+		++expected;
+		++count;
+	}
+	dbgassert(count == tree->nel);
+	// and the iterator stays done
+	dbgassert(!cu_btree_next(&iter, &key, &value));
+}
+
+static void test_insert_erase(size_t node_size)
+{
+	cu_btree tree;
+	dbgassert(cu_btree_new(&tree, NULL, node_size) == 0);
+	static bool present[NUM_KEYS];
+	memset(present, 0, sizeof(present));
+	check_contents(&tree, present);
+	dbgassert(cu_btree_at(&tree, get_key(0)) == NULL);
+	dbgassert(cu_btree_erase(&tree, get_key(0)) == NULL);
+
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		size_t k = shuffled(i);
+		dbgassert(cu_btree_insert(&tree, get_key(k), KEY_STORAGE[k])
+			== 0);
+		present[k] = true;
+	}
+	dbgassert(tree.nel == NUM_KEYS);
+	check_contents(&tree, present);
+
+	// replacing a value doesn't add a key
+	dbgassert(cu_btree_insert(&tree, get_key(5), NULL) == 0);
+	dbgassert(cu_btree_insert(&tree, get_key(5), KEY_STORAGE[5]) == 0);
+	dbgassert(tree.nel == NUM_KEYS);
+
+	for (size_t i = 0; i < NUM_KEYS; i += 3) {
+		size_t k = shuffled(i);
+		dbgassert(cu_btree_erase(&tree, get_key(k)) == KEY_STORAGE[k]);
+		dbgassert(cu_btree_erase(&tree, get_key(k)) == NULL);
+		present[k] = false;
+	}
+	check_contents(&tree, present);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		void *value = cu_btree_at(&tree, get_key(i));
+		dbgassert(value == (present[i] ? KEY_STORAGE[i] : NULL));
+	}
+
+	// emptying the tree completely and filling it again
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		if (present[i])
+			dbgassert(cu_btree_erase(&tree, get_key(i))
+				== KEY_STORAGE[i]);
+		present[i] = false;
+	}
+	dbgassert(tree.nel == 0);
+	check_contents(&tree, present);
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		dbgassert(cu_btree_insert(&tree, get_key(i), KEY_STORAGE[i])
+			== 0);
+		present[i] = true;
+	}
+	check_contents(&tree, present);
+	cu_btree_free(&tree);
+}
+
+static void test_iteration(void)
+{
+	cu_btree tree;
+	dbgassert(cu_btree_new(&tree, NULL, 256) == 0);
+	// only the even keys, so odd keys can be used as bounds in between
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		dbgassert(cu_btree_insert(&tree, get_key(i), KEY_STORAGE[i])
+			== 0);
+	}
+
+	cu_str key;
+	cu_btree_iter iter = cu_btree_lower_bound(&tree, get_key(101));
+	dbgassert(cu_btree_next(&iter, &key, NULL));
+	dbgassert(cu_str_eq(key, get_key(102)));
+	iter = cu_btree_lower_bound(&tree, get_key(102));
+	dbgassert(cu_btree_next(&iter, &key, NULL));
+	dbgassert(cu_str_eq(key, get_key(102)));
+	iter = cu_btree_lower_bound(&tree, get_key(NUM_KEYS - 1));
+	dbgassert(!cu_btree_next(&iter, &key, NULL));
+
+	// [500, 701) holds the even keys 500 through 700
+	size_t expected = 500;
+	iter = cu_btree_range(&tree, get_key(500), get_key(701));
+	while (cu_btree_next(&iter, &key, NULL)) {
+		dbgassert(cu_str_eq(key, get_key(expected)));
+		expected += 2;
+	}
+	dbgassert(expected == 702);
+	iter = cu_btree_range(&tree, get_key(500), get_key(500));
+	dbgassert(!cu_btree_next(&iter, &key, NULL));
+
+	// "key012" is the prefix of key01200 through key01298
+	expected = 1200;
+	iter = cu_btree_prefix(&tree, cu_str_from_cstr("key012"));
+	while (cu_btree_next(&iter, &key, NULL)) {
+		dbgassert(cu_str_eq(key, get_key(expected)));
+		expected += 2;
+	}
+	dbgassert(expected == 1300);
+	iter = cu_btree_prefix(&tree, cu_str_from_cstr("nope"));
+	dbgassert(!cu_btree_next(&iter, &key, NULL));
+	cu_btree_free(&tree);
+}
+
+static void test_prefix_order(void)
+{
+	// keys that only differ after their first 8 bytes, or in length
+	static const char *const sorted[] = {
+		"", "a", "a\0", "abcdefgh", "abcdefgh\0", "abcdefghi",
+		"abcdefghij", "abcdefgz", "b",
+	};
+	static const size_t lens[] = {0, 1, 2, 8, 9, 9, 10, 8, 1};
+	enum { NSORTED = sizeof(lens) / sizeof(lens[0]) };
+	cu_str keys[NSORTED];
+	for (size_t i = 0; i < NSORTED; ++i) {
+		keys[i] = (cu_str){.buf = (uint8_t *)sorted[i], .len = lens[i]};
+	}
+
+	cu_btree tree;
+	dbgassert(cu_btree_new(&tree, NULL, 128) == 0);
+	for (size_t i = NSORTED; i-- > 0;) {
+		dbgassert(cu_btree_insert(&tree, keys[i], keys + i) == 0);
+	}
+	cu_btree_iter iter = cu_btree_begin(&tree);
+	void *value;
+	for (size_t i = 0; i < NSORTED; ++i) {
+		dbgassert(cu_btree_next(&iter, NULL, &value));
+		dbgassert(value == keys + i);
+	}
+	dbgassert(!cu_btree_next(&iter, NULL, &value));
+	cu_btree_free(&tree);
+}
+
+static void test_build(void)
+{
+	static cu_str keys[NUM_KEYS];
+	static void *values[NUM_KEYS];
+	static bool present[NUM_KEYS];
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		keys[i] = get_key(i);
+		values[i] = KEY_STORAGE[i];
+		present[i] = true;
+	}
+
+	cu_btree tree;
+	// every size of input up to a few levels deep
+	for (size_t n = 0; n < 200; ++n) {
+		dbgassert(cu_btree_build(&tree, NULL, 128, keys, values, n)
+			== 0);
+		dbgassert(tree.nel == n);
+		for (size_t i = 0; i < NUM_KEYS; ++i)
+			present[i] = i < n;
+		check_contents(&tree, present);
+		cu_btree_free(&tree);
+	}
+
+	dbgassert(cu_btree_build(&tree, NULL, 256, keys, values, NUM_KEYS)
+		== 0);
+	for (size_t i = 0; i < NUM_KEYS; ++i)
+		present[i] = true;
+	check_contents(&tree, present);
+	// a built tree can be changed like any other
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		dbgassert(cu_btree_erase(&tree, keys[i]) == values[i]);
+		present[i] = false;
+	}
+	check_contents(&tree, present);
+	cu_btree_free(&tree);
+
+	// unsorted input and duplicates are rejected
+	cu_str swapped[2] = {get_key(1), get_key(0)};
+	dbgassert(cu_btree_build(&tree, NULL, 256, swapped, values, 2) != 0);
+	cu_str dup[2] = {get_key(1), get_key(1)};
+	dbgassert(cu_btree_build(&tree, NULL, 256, dup, values, 2) != 0);
+}
+
+static void test_arena(void)
+{
+	cu_arena *arena = cu_arena_new(4096, NULL);
+	dbgassert(arena != NULL);
+	cu_alloc alloc;
+	cu_arena_cast(&alloc, arena);
+
+	cu_btree tree;
+	dbgassert(cu_btree_new(&tree, &alloc, 256) == 0);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_btree_insert(&tree, get_key(i), KEY_STORAGE[i])
+			== 0);
+	}
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		dbgassert(cu_btree_erase(&tree, get_key(i)) == KEY_STORAGE[i]);
+	}
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		void *value = cu_btree_at(&tree, get_key(i));
+		dbgassert(value == (i % 2 == 0 ? NULL : KEY_STORAGE[i]));
+	}
+	cu_btree_free(&tree);
+	cu_arena_free(arena);
+}
+
+// Keys aren't copied, so a caller can free a key once it's erased, and the
+// tree mustn't look at it again. The keys share their first 8 bytes, so every
+// comparison follows their pointers.
+static void test_free_erased(void)
+{
+	enum { NKEYS = 256, LEN = 24 };
+	char *bufs[NKEYS];
+	char lookup[LEN];
+	cu_btree tree;
+	dbgassert(cu_btree_new(&tree, NULL, 128) == 0);
+	for (size_t i = 0; i < NKEYS; ++i) {
+		bufs[i] = malloc(LEN);
+		dbgassert(bufs[i] != NULL);
+		snprintf(bufs[i], LEN, "longprefix-%04zu", i);
+		dbgassert(cu_btree_insert(&tree, cu_str_from_cstr(bufs[i]),
+			(void *)(uintptr_t)(i + 1)) == 0);
+	}
+
+	// every other key, in a scrambled order, and then the rest
+	for (size_t pass = 0; pass < 2; ++pass) {
+		for (size_t i = 0; i < NKEYS; ++i) {
+			size_t erased = (i * 97) % NKEYS;
+			if (erased % 2 != pass)
+				continue;
+			dbgassert(cu_btree_erase(&tree,
+				cu_str_from_cstr(bufs[erased]))
+				== (void *)(uintptr_t)(erased + 1));
+			memset(bufs[erased], 'x', LEN);
+			free(bufs[erased]);
+			bufs[erased] = NULL;
+		}
+		for (size_t i = 0; i < NKEYS; ++i) {
+			snprintf(lookup, LEN, "longprefix-%04zu", i);
+			void *value = cu_btree_at(&tree,
+				cu_str_from_cstr(lookup));
+			dbgassert(value == (bufs[i] == NULL
+				? NULL : (void *)(uintptr_t)(i + 1)));
+		}
+	}
+	dbgassert(tree.nel == 0);
+	cu_btree_free(&tree);
+}
+
+int main(void)
+{
+	cu_btree tree;
+	dbgassert(cu_btree_new(&tree, NULL, 64) != 0);
+
+	// the smallest node size, for 3 keys per node, so the tree gets deep
+	test_insert_erase(128);
+	test_insert_erase(CU_BTREE_DEFAULT_NODE_SIZE);
+	test_iteration();
+	test_prefix_order();
+	test_build();
+	test_arena();
+	test_free_erased();
+}
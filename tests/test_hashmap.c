@@ -5,10 +5,13 @@
 // SPDX-License-Identifier: MPL-2.0
 
 #include <stdint.h>
+#include <stdio.h>
 #include <assert.h>
 #include <cu/hashmap.h>
 #include <cu/dbgassert.h>
 
+#include "keys.h"
+
 
 static void test_hashmap(void)
 {
@@ -71,7 +74,401 @@ static void test_hashmap(void)
 	cu_hm_free(&hm);
 }
 
+static void test_erase(void)
+{
+	cu_hm hm;
+	dbgassert(cu_hm_new(&hm, NULL) == 0);
+	dbgassert(cu_hm_erase(&hm, get_key(0)) == NULL);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_insert(&hm, get_key(i), KEY_STORAGE[i]) == 0);
+	}
+	dbgassert(hm.nel == NUM_KEYS);
+
+	// erasing every other key
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		dbgassert(cu_hm_erase(&hm, get_key(i)) == KEY_STORAGE[i]);
+		dbgassert(cu_hm_erase(&hm, get_key(i)) == NULL);
+	}
+	dbgassert(hm.nel == NUM_KEYS / 2);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		void *val = cu_hm_at(&hm, get_key(i));
+		if (i % 2 == 0)
+			dbgassert(val == NULL);
+		else
+			dbgassert(val == KEY_STORAGE[i]);
+	}
+
+	// churning, the table shouldn't need to grow
+	uint64_t capacity = hm.capacity;
+	for (size_t round = 0; round < 16; ++round) {
+		for (size_t i = 0; i < NUM_KEYS; i += 2) {
+			dbgassert(cu_hm_insert(&hm, get_key(i), KEY_STORAGE[i])
+				== 0);
+		}
+		for (size_t i = 0; i < NUM_KEYS; i += 2) {
+			dbgassert(cu_hm_erase(&hm, get_key(i))
+				== KEY_STORAGE[i]);
+		}
+	}
+	dbgassert(hm.capacity == capacity);
+	dbgassert(hm.nel == NUM_KEYS / 2);
+
+	size_t count = 0;
+	cu_hm_iter it = cu_hm_begin(&hm);
+	cu_hm_bucket *cur = NULL;
+	while ((cur = cu_hm_next(&it)) != NULL) {
+		dbgassert(cur->value == cu_hm_at(&hm, cur->key));
+		++count;
+	}
+	dbgassert(count == NUM_KEYS / 2);
+	cu_hm_free(&hm);
+}
+
+static void test_cpy_erase(void)
+{
+	cu_hm_cpy hm;
+	dbgassert(cu_hm_cpy_new(&hm, NULL, 256) == 0);
+	for (size_t i = 0; i < 64; ++i) {
+		dbgassert(cu_hm_cpy_insert(&hm, get_key(i), KEY_STORAGE[i])
+			== 0);
+	}
+	for (size_t i = 0; i < 64; ++i) {
+		dbgassert(cu_hm_cpy_erase(&hm, get_key(i)) == KEY_STORAGE[i]);
+		dbgassert(!cu_hm_cpy_contains(&hm, get_key(i)));
+	}
+	dbgassert(hm.hm.nel == 0);
+	cu_hm_cpy_free(&hm);
+}
+
+static void test_cached_hash(void)
+{
+	cu_hm hm;
+	dbgassert(cu_hm_new(&hm, NULL) == 0);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_insert(&hm, get_key(i), KEY_STORAGE[i]) == 0);
+	}
+	// the table grew several times, cached hashes must still be right
+	cu_hm_iter it = cu_hm_begin(&hm);
+	cu_hm_bucket *cur = NULL;
+	while ((cur = cu_hm_next(&it)) != NULL) {
+		dbgassert(cur->hash == cu_str_hash(cur->key, &hm.key));
+	}
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_at(&hm, get_key(i)) == KEY_STORAGE[i]);
+	}
+	cu_hm_free(&hm);
+}
+
+static void test_incremental(void)
+{
+	cu_hm hm;
+	dbgassert(cu_hm_new(&hm, NULL) == 0);
+	cu_hm_set_incremental(&hm, true);
+	bool saw_migration = false;
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		uint64_t old_capacity = hm.old_capacity;
+		dbgassert(cu_hm_insert(&hm, get_key(i), KEY_STORAGE[i]) == 0);
+		if (hm.old_arr != NULL) {
+			saw_migration = true;
+			// a resize must finish before the next one starts
+			dbgassert(old_capacity == 0 ||
+				hm.old_capacity == old_capacity);
+		}
+		// everything inserted so far must be reachable mid-resize
+		for (size_t j = 0; j <= i; j += 7) {
+			dbgassert(cu_hm_at(&hm, get_key(j)) == KEY_STORAGE[j]);
+		}
+	}
+	dbgassert(saw_migration);
+	dbgassert(hm.nel == NUM_KEYS);
+
+	size_t count = 0;
+	cu_hm_iter it = cu_hm_begin(&hm);
+	cu_hm_bucket *cur = NULL;
+	while ((cur = cu_hm_next(&it)) != NULL) {
+		dbgassert(cur->value == cu_hm_at(&hm, cur->key));
+		++count;
+	}
+	dbgassert(count == NUM_KEYS);
+
+	// erasing from whichever table the key is in
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		dbgassert(cu_hm_erase(&hm, get_key(i)) == KEY_STORAGE[i]);
+	}
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		void *val = cu_hm_at(&hm, get_key(i));
+		dbgassert(val == (i % 2 == 0 ? NULL : KEY_STORAGE[i]));
+	}
+
+	cu_hm_set_incremental(&hm, false);
+	dbgassert(hm.old_arr == NULL);
+	dbgassert(hm.nel == NUM_KEYS / 2);
+	cu_hm_free(&hm);
+}
+
+static void test_at_many(void)
+{
+	cu_hm hm;
+	dbgassert(cu_hm_new(&hm, NULL) == 0);
+
+	// lookups on an empty map
+	cu_str keys[NUM_KEYS];
+	void *values[NUM_KEYS];
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		keys[i] = get_key(i);
+	}
+	cu_hm_at_many(&hm, keys, 3, values);
+	for (size_t i = 0; i < 3; ++i) {
+		dbgassert(values[i] == NULL);
+	}
+
+	for (size_t i = 0; i < NUM_KEYS; i += 3) {
+		dbgassert(cu_hm_insert(&hm, keys[i], KEY_STORAGE[i]) == 0);
+	}
+	// not a multiple of the batch size on purpose
+	cu_hm_at_many(&hm, keys, NUM_KEYS - 5, values);
+	for (size_t i = 0; i < NUM_KEYS - 5; ++i) {
+		dbgassert(values[i] == cu_hm_at(&hm, keys[i]));
+		dbgassert(values[i] == (i % 3 == 0 ? KEY_STORAGE[i] : NULL));
+	}
+	cu_hm_free(&hm);
+}
+
+static void test_hashed(void)
+{
+	cu_hm hm;
+	dbgassert(cu_hm_new(&hm, NULL) == 0);
+	uint64_t hashes[64];
+	for (size_t i = 0; i < 64; ++i) {
+		hashes[i] = cu_hm_hash(&hm, get_key(i));
+		dbgassert(hashes[i] == cu_str_hash(get_key(i), &hm.key));
+		dbgassert(cu_hm_at_hashed(&hm, get_key(i), hashes[i]) == NULL);
+		dbgassert(cu_hm_insert_hashed(
+			&hm, get_key(i), hashes[i], KEY_STORAGE[i]) == 0);
+	}
+	for (size_t i = 0; i < 64; ++i) {
+		dbgassert(cu_hm_at_hashed(&hm, get_key(i), hashes[i])
+			== KEY_STORAGE[i]);
+		dbgassert(cu_hm_at(&hm, get_key(i)) == KEY_STORAGE[i]);
+	}
+
+	// counting occurrences with one probe per key
+	uintptr_t counts_expected[64] = {0};
+	for (size_t round = 0; round < 3; ++round) {
+		for (size_t i = round; i < 64; ++i) {
+			bool inserted = true;
+			cu_hm_bucket *bucket = cu_hm_get_or_insert(
+				&hm, get_key(i + 64), &inserted);
+			dbgassert(bucket != NULL);
+			dbgassert(inserted == (round == 0));
+			bucket->value = (void *)((uintptr_t)bucket->value + 1);
+			++counts_expected[i];
+		}
+	}
+	for (size_t i = 0; i < 64; ++i) {
+		dbgassert((uintptr_t)cu_hm_at(&hm, get_key(i + 64))
+			== counts_expected[i]);
+	}
+	dbgassert(hm.nel == 128);
+	for (size_t i = 0; i < 64; ++i) {
+		dbgassert(cu_hm_erase_hashed(&hm, get_key(i), hashes[i])
+			== KEY_STORAGE[i]);
+	}
+	dbgassert(hm.nel == 64);
+	cu_hm_free(&hm);
+}
+
+static void test_cpy_hashed(void)
+{
+	cu_hm_cpy hm;
+	dbgassert(cu_hm_cpy_new(&hm, NULL, 256) == 0);
+	char buf[KEY_LEN] = "shared";
+	cu_str key = cu_str_from_cstr(buf);
+	uint64_t hash = cu_hm_cpy_hash(&hm, key);
+
+	bool inserted = false;
+	cu_hm_bucket *bucket =
+		cu_hm_cpy_get_or_insert_hashed(&hm, key, hash, &inserted);
+	dbgassert(bucket != NULL && inserted);
+	dbgassert(bucket->key.buf != key.buf);
+	uint8_t *copy = bucket->key.buf;
+	bucket->value = buf;
+
+	// the existing copy is reused
+	dbgassert(cu_hm_cpy_insert_hashed(&hm, key, hash, KEY_STORAGE[0]) == 0);
+	bucket = cu_hm_cpy_get_or_insert(&hm, key, &inserted);
+	dbgassert(!inserted && bucket->key.buf == copy);
+	dbgassert(bucket->value == KEY_STORAGE[0]);
+
+	// the map must not depend on the caller's buffer
+	buf[0] = 'S';
+	dbgassert(cu_hm_cpy_at(&hm, cu_str_from_cstr("shared"))
+		== KEY_STORAGE[0]);
+	dbgassert(cu_hm_cpy_erase_hashed(&hm, cu_str_from_cstr("shared"),
+		hash) == KEY_STORAGE[0]);
+	cu_hm_cpy_free(&hm);
+}
+
+static void test_shrink(void)
+{
+	cu_hm hm;
+	dbgassert(cu_hm_new(&hm, NULL) == 0);
+	dbgassert(cu_hm_shrink_to_fit(&hm) == 0);
+	dbgassert(hm.capacity == 0);
+
+	cu_hm_set_incremental(&hm, true);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_insert(&hm, get_key(i), KEY_STORAGE[i]) == 0);
+	}
+	uint64_t full_capacity = hm.capacity;
+	for (size_t i = 10; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_erase(&hm, get_key(i)) == KEY_STORAGE[i]);
+	}
+	dbgassert(cu_hm_shrink_to_fit(&hm) == 0);
+	dbgassert(hm.old_arr == NULL);
+	dbgassert(hm.capacity < full_capacity);
+	dbgassert(hm.capacity >= 10 * 2);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		void *val = cu_hm_at(&hm, get_key(i));
+		dbgassert(val == (i < 10 ? KEY_STORAGE[i] : NULL));
+	}
+
+	// shrinking again changes nothing
+	uint64_t capacity = hm.capacity;
+	dbgassert(cu_hm_shrink_to_fit(&hm) == 0);
+	dbgassert(hm.capacity == capacity);
+
+	for (size_t i = 0; i < 10; ++i) {
+		dbgassert(cu_hm_erase(&hm, get_key(i)) == KEY_STORAGE[i]);
+	}
+	dbgassert(cu_hm_shrink_to_fit(&hm) == 0);
+	dbgassert(hm.capacity == 0 && hm.arr == NULL);
+	dbgassert(cu_hm_insert(&hm, get_key(0), KEY_STORAGE[0]) == 0);
+	dbgassert(cu_hm_at(&hm, get_key(0)) == KEY_STORAGE[0]);
+	cu_hm_free(&hm);
+}
+
+static void test_build(void)
+{
+	cu_str keys[NUM_KEYS + 1];
+	void *values[NUM_KEYS + 1];
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		keys[i] = get_key(i);
+		values[i] = KEY_STORAGE[i];
+	}
+	// a duplicate key keeps its last value
+	keys[NUM_KEYS] = get_key(3);
+	values[NUM_KEYS] = KEY_STORAGE[4];
+
+	cu_hm hm;
+	dbgassert(cu_hm_build(&hm, NULL, keys, values, NUM_KEYS + 1) == 0);
+	dbgassert(hm.nel == NUM_KEYS);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_at(&hm, get_key(i))
+			== KEY_STORAGE[i == 3 ? 4 : i]);
+	}
+	dbgassert(cu_hm_at(&hm, cu_str_from_cstr("missing")) == NULL);
+	// the map works as usual afterwards
+	dbgassert(cu_hm_erase(&hm, get_key(0)) == KEY_STORAGE[0]);
+	dbgassert(cu_hm_insert(&hm, get_key(0), KEY_STORAGE[1]) == 0);
+	dbgassert(cu_hm_at(&hm, get_key(0)) == KEY_STORAGE[1]);
+	cu_hm_free(&hm);
+
+	dbgassert(cu_hm_build(&hm, NULL, keys, values, 0) == 0);
+	dbgassert(hm.nel == 0);
+	dbgassert(cu_hm_at(&hm, get_key(0)) == NULL);
+	cu_hm_free(&hm);
+}
+
+static void test_hasher(cu_hm_hasher hasher)
+{
+	cu_hm hm;
+	dbgassert(cu_hm_new_hasher(&hm, NULL, hasher) == 0);
+	dbgassert(hm.hasher == hasher);
+	cu_str key = get_key(0);
+	uint64_t expected;
+	switch (hasher) {
+	case CU_HM_SIPHASH24:
+		expected = cu_siphash24_hash(&hm.key, key.buf, key.len);
+		break;
+	case CU_HM_WYHASH:
+		expected = cu_wyhash(&hm.key, key.buf, key.len);
+		break;
+	default:
+		expected = cu_siphash_hash(&hm.key, key.buf, key.len);
+		break;
+	}
+	dbgassert(cu_hm_hash(&hm, key) == expected);
+
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_insert(&hm, get_key(i), KEY_STORAGE[i]) == 0);
+	}
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		dbgassert(cu_hm_erase(&hm, get_key(i)) == KEY_STORAGE[i]);
+	}
+	// a clone hashes the same way
+	cu_hm clone;
+	dbgassert(cu_hm_clone(&clone, &hm) == 0);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		void *expected_val = i % 2 == 0 ? NULL : KEY_STORAGE[i];
+		dbgassert(cu_hm_at(&hm, get_key(i)) == expected_val);
+		dbgassert(cu_hm_at(&clone, get_key(i)) == expected_val);
+	}
+	cu_hm_free(&clone);
+	cu_hm_free(&hm);
+
+	cu_hm_cpy cpy;
+	dbgassert(cu_hm_cpy_new_hasher(&cpy, NULL, 4096, hasher) == 0);
+	dbgassert(cpy.hm.hasher == hasher);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_cpy_insert(&cpy, get_key(i), KEY_STORAGE[i])
+			== 0);
+	}
+	for (size_t i = 0; i < NUM_KEYS; ++i)
+		dbgassert(cu_hm_cpy_at(&cpy, get_key(i)) == KEY_STORAGE[i]);
+	cu_hm_cpy_free(&cpy);
+
+	cu_keystore store;
+	dbgassert(cu_keystore_new(&store, NULL, 4096) == 0);
+	dbgassert(cu_hm_cpy_new_shared_hasher(&cpy, NULL, &store, hasher)
+		== 0);
+	dbgassert(cpy.hm.hasher == hasher);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_cpy_insert(&cpy, get_key(i), KEY_STORAGE[i])
+			== 0);
+	}
+	for (size_t i = 0; i < NUM_KEYS; ++i)
+		dbgassert(cu_hm_cpy_at(&cpy, get_key(i)) == KEY_STORAGE[i]);
+	cu_hm_cpy_free(&cpy);
+	cu_keystore_free(&store);
+
+	cu_str keys[NUM_KEYS];
+	void *values[NUM_KEYS];
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		keys[i] = get_key(i);
+		values[i] = KEY_STORAGE[i];
+	}
+	dbgassert(cu_hm_build_hasher(&hm, NULL, keys, values, NUM_KEYS,
+		hasher) == 0);
+	dbgassert(hm.hasher == hasher);
+	for (size_t i = 0; i < NUM_KEYS; ++i)
+		dbgassert(cu_hm_at(&hm, get_key(i)) == KEY_STORAGE[i]);
+	cu_hm_free(&hm);
+}
+
 int main(void)
 {
 	test_hashmap();
+	test_erase();
+	test_cpy_erase();
+	test_cached_hash();
+	test_incremental();
+	test_at_many();
+	test_hashed();
+	test_cpy_hashed();
+	test_shrink();
+	test_build();
+	test_hasher(CU_HM_SIPHASH13);
+	test_hasher(CU_HM_SIPHASH24);
+	test_hasher(CU_HM_WYHASH);
 }
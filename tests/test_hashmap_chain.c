@@ -0,0 +1,122 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <stdint.h>
+#include <stdio.h>
+#include <cu/hashmap_chain.h>
+#include <cu/dbgassert.h>
+
+#define NUM_KEYS 1024
+#define KEY_LEN 16
+
+typedef struct {
+	char name[KEY_LEN];
+	cu_hm_chain_node node;
+} entry;
+
+static entry ENTRIES[NUM_KEYS];
+
+static cu_str get_key(size_t i)
+{
+	snprintf(ENTRIES[i].name, KEY_LEN, "key%zu", i);
+	return cu_str_from_cstr(ENTRIES[i].name);
+}
+
+static entry *entry_of(cu_hm_chain_node *node)
+{
+	return node == NULL ? NULL : cu_container_of(node, entry, node);
+}
+
+static void fill(cu_hm_chain *hm)
+{
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		cu_hm_chain_node *node = &ENTRIES[i].node;
+		dbgassert(cu_hm_chain_insert(hm, node, get_key(i)) == node);
+	}
+	dbgassert(hm->nel == NUM_KEYS);
+}
+
+static void test_insert(bool incremental, uint64_t max_load)
+{
+	cu_hm_chain hm;
+	dbgassert(cu_hm_chain_new(&hm, NULL) == 0);
+	cu_hm_chain_set_incremental(&hm, incremental);
+	cu_hm_chain_set_max_load(&hm, max_load);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_chain_at(&hm, get_key(i)) == NULL);
+	}
+	fill(&hm);
+	dbgassert(hm.nel <= (hm.capacity + hm.old_capacity) * max_load);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(entry_of(cu_hm_chain_at(&hm, get_key(i)))
+			== ENTRIES + i);
+	}
+	dbgassert(!cu_hm_chain_contains(&hm, cu_str_from_cstr("asdf")));
+
+	// a key that's already there isn't replaced
+	entry dup;
+	dbgassert(cu_hm_chain_insert(&hm, &dup.node, get_key(3))
+		== &ENTRIES[3].node);
+	dbgassert(hm.nel == NUM_KEYS);
+	cu_hm_chain_free(&hm);
+}
+
+static void test_erase(bool incremental)
+{
+	cu_hm_chain hm;
+	dbgassert(cu_hm_chain_new(&hm, NULL) == 0);
+	cu_hm_chain_set_incremental(&hm, incremental);
+	dbgassert(cu_hm_chain_erase(&hm, get_key(0)) == NULL);
+	fill(&hm);
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		dbgassert(entry_of(cu_hm_chain_erase(&hm, get_key(i)))
+			== ENTRIES + i);
+		dbgassert(cu_hm_chain_erase(&hm, get_key(i)) == NULL);
+	}
+	for (size_t i = 1; i < NUM_KEYS; i += 4) {
+		cu_hm_chain_erase_node(&hm, &ENTRIES[i].node);
+	}
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		entry *val = entry_of(cu_hm_chain_at(&hm, get_key(i)));
+		dbgassert(val == (i % 4 == 3 ? ENTRIES + i : NULL));
+	}
+	dbgassert(hm.nel == NUM_KEYS / 4);
+	cu_hm_chain_free(&hm);
+}
+
+static void test_iter(void)
+{
+	cu_hm_chain hm;
+	dbgassert(cu_hm_chain_new(&hm, NULL) == 0);
+	cu_hm_chain_set_incremental(&hm, true);
+	cu_hm_chain_iter iter = cu_hm_chain_begin(&hm);
+	dbgassert(cu_hm_chain_next(&iter) == NULL);
+
+	fill(&hm);
+	bool seen[NUM_KEYS] = {0};
+	size_t count = 0;
+	iter = cu_hm_chain_begin(&hm);
+	cu_hm_chain_node *node;
+	while ((node = cu_hm_chain_next(&iter)) != NULL) {
+		size_t i = entry_of(node) - ENTRIES;
+		dbgassert(!seen[i]);
+		seen[i] = true;
+		++count;
+	}
+	dbgassert(count == NUM_KEYS);
+	cu_hm_chain_free(&hm);
+}
+
+int main(void)
+{
+	test_insert(false, 1);
+	test_insert(true, 1);
+	test_insert(false, 4);
+	test_insert(true, 4);
+	test_erase(false);
+	test_erase(true);
+	test_iter();
+}
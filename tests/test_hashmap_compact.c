@@ -0,0 +1,124 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <stdint.h>
+#include <stdio.h>
+#include <cu/hashmap_compact.h>
+#include <cu/dbgassert.h>
+
+#define NUM_KEYS 1024
+#define KEY_LEN 48
+static char KEY_STORAGE[NUM_KEYS][KEY_LEN];
+
+// Keys get longer with `i`, so both short and long keys are covered, along
+// with every length around CU_HM_COMPACT_INLINE.
+static cu_str get_key(size_t i)
+{
+	int len = snprintf(KEY_STORAGE[i], KEY_LEN, "%zu", i);
+	size_t pad = i % 32;
+	memset(KEY_STORAGE[i] + len, '-', pad);
+	KEY_STORAGE[i][len + pad] = '\0';
+	return cu_str_from_cstr(KEY_STORAGE[i]);
+}
+
+static void test_insert_erase(void)
+{
+	cu_hm_compact hm;
+	dbgassert(cu_hm_compact_new(&hm, NULL, 256) == 0);
+	dbgassert(cu_hm_compact_at(&hm, get_key(0)) == NULL);
+	dbgassert(cu_hm_compact_erase(&hm, get_key(0)) == NULL);
+
+	bool saw_short = false;
+	bool saw_long = false;
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		bool inserted = false;
+		cu_hm_compact_bucket *bucket =
+			cu_hm_compact_get_or_insert(&hm, get_key(i), &inserted);
+		dbgassert(bucket != NULL && inserted);
+		bucket->value = KEY_STORAGE[i];
+		saw_short |= bucket->tag != CU_HM_COMPACT_SPILLED;
+		saw_long |= bucket->tag == CU_HM_COMPACT_SPILLED;
+	}
+	dbgassert(saw_short && saw_long);
+	dbgassert(hm.nel == NUM_KEYS);
+
+	// the map must not depend on the caller's buffers, whether the key is
+	// short (5) or long (31)
+	char saved[2][KEY_LEN];
+	memcpy(saved[0], KEY_STORAGE[5], KEY_LEN);
+	memcpy(saved[1], KEY_STORAGE[31], KEY_LEN);
+	memset(KEY_STORAGE[5], 'x', KEY_LEN - 1);
+	memset(KEY_STORAGE[31], 'x', KEY_LEN - 1);
+	dbgassert(cu_hm_compact_at(&hm, cu_str_from_cstr(saved[0]))
+		== KEY_STORAGE[5]);
+	dbgassert(cu_hm_compact_at(&hm, cu_str_from_cstr(saved[1]))
+		== KEY_STORAGE[31]);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_compact_at(&hm, get_key(i)) == KEY_STORAGE[i]);
+	}
+
+	size_t count = 0;
+	cu_hm_compact_iter it = cu_hm_compact_begin(&hm);
+	cu_hm_compact_bucket *cur;
+	while ((cur = cu_hm_compact_next(&it)) != NULL) {
+		cu_str key = cu_hm_compact_key(cur);
+		dbgassert(cu_str_eq(key, cu_str_from_cstr(cur->value)));
+		++count;
+	}
+	dbgassert(count == NUM_KEYS);
+
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		dbgassert(cu_hm_compact_erase(&hm, get_key(i))
+			== KEY_STORAGE[i]);
+		dbgassert(cu_hm_compact_erase(&hm, get_key(i)) == NULL);
+	}
+	dbgassert(hm.nel == NUM_KEYS / 2);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		void *val = cu_hm_compact_at(&hm, get_key(i));
+		dbgassert(val == (i % 2 == 0 ? NULL : KEY_STORAGE[i]));
+	}
+
+	// existing keys are updated in place
+	dbgassert(cu_hm_compact_insert(&hm, get_key(1), KEY_STORAGE[0]) == 0);
+	dbgassert(cu_hm_compact_at(&hm, get_key(1)) == KEY_STORAGE[0]);
+	dbgassert(hm.nel == NUM_KEYS / 2);
+	cu_hm_compact_free(&hm);
+}
+
+static void test_boundary(void)
+{
+	cu_hm_compact hm;
+	dbgassert(cu_hm_compact_new(&hm, NULL, 64) == 0);
+	char buf[CU_HM_COMPACT_INLINE + 2];
+	memset(buf, 'a', sizeof(buf));
+
+	// every prefix of the same bytes, from empty to just past the inline
+	// limit, is a different key
+	for (size_t len = 0; len <= sizeof(buf); ++len) {
+		cu_str key = {.buf = (uint8_t *)buf, .len = len};
+		dbgassert(cu_hm_compact_insert(&hm, key, buf + len) == 0);
+	}
+	for (size_t len = 0; len <= sizeof(buf); ++len) {
+		cu_str key = {.buf = (uint8_t *)buf, .len = len};
+		dbgassert(cu_hm_compact_at(&hm, key) == buf + len);
+	}
+
+	cu_hm_compact_iter it = cu_hm_compact_begin(&hm);
+	cu_hm_compact_bucket *cur;
+	while ((cur = cu_hm_compact_next(&it)) != NULL) {
+		cu_str key = cu_hm_compact_key(cur);
+		dbgassert(cur->value == buf + key.len);
+		dbgassert((cur->tag == CU_HM_COMPACT_SPILLED)
+			== (key.len > CU_HM_COMPACT_INLINE));
+	}
+	cu_hm_compact_free(&hm);
+}
+
+int main(void)
+{
+	test_insert_erase();
+	test_boundary();
+}
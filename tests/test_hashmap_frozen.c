@@ -0,0 +1,99 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <stdint.h>
+#include <stdio.h>
+#include <cu/hashmap_frozen.h>
+#include <cu/dbgassert.h>
+
+#define NUM_KEYS 4096
+#include "keys.h"
+
+static void test_freeze(size_t nkeys)
+{
+	cu_hm hm;
+	dbgassert(cu_hm_new(&hm, NULL) == 0);
+	for (size_t i = 0; i < nkeys; ++i) {
+		dbgassert(cu_hm_insert(&hm, get_key(i), KEY_STORAGE[i]) == 0);
+	}
+
+	cu_hm_frozen frozen;
+	dbgassert(cu_hm_freeze(&frozen, &hm) == 0);
+	cu_hm_free(&hm);
+	dbgassert(frozen.nel == nkeys);
+	for (size_t i = 0; i < nkeys; ++i) {
+		dbgassert(cu_hm_frozen_at(&frozen, get_key(i))
+			== KEY_STORAGE[i]);
+	}
+	for (size_t i = nkeys; i < nkeys + 64 && i < NUM_KEYS; ++i) {
+		dbgassert(!cu_hm_frozen_contains(&frozen, get_key(i)));
+	}
+	dbgassert(!cu_hm_frozen_contains(&frozen, cu_str_from_cstr("")));
+
+	// every bucket holds a key
+	size_t count = 0;
+	cu_hm_frozen_iter iter = cu_hm_frozen_begin(&frozen);
+	const cu_hm_bucket *bucket;
+	while ((bucket = cu_hm_frozen_next(&iter)) != NULL) {
+		dbgassert(cu_str_eq(bucket->key,
+			cu_str_from_cstr(bucket->value)));
+		++count;
+	}
+	dbgassert(count == nkeys);
+	cu_hm_frozen_free(&frozen);
+}
+
+// freezing a map that has had keys erased and resizes incrementally
+static void test_freeze_incremental(void)
+{
+	cu_hm hm;
+	dbgassert(cu_hm_new(&hm, NULL) == 0);
+	cu_hm_set_incremental(&hm, true);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_insert(&hm, get_key(i), KEY_STORAGE[i]) == 0);
+	}
+	for (size_t i = 0; i < NUM_KEYS; i += 3) {
+		dbgassert(cu_hm_erase(&hm, get_key(i)) == KEY_STORAGE[i]);
+	}
+
+	cu_hm_frozen frozen;
+	dbgassert(cu_hm_freeze(&frozen, &hm) == 0);
+	dbgassert(frozen.nel == hm.nel);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		void *val = cu_hm_frozen_at(&frozen, get_key(i));
+		dbgassert(val == (i % 3 == 0 ? NULL : KEY_STORAGE[i]));
+	}
+	cu_hm_frozen_free(&frozen);
+	cu_hm_free(&hm);
+}
+
+// the cached hashes of a map using another hash function can't be reused
+static void test_freeze_hasher(void)
+{
+	cu_hm hm;
+	dbgassert(cu_hm_new_hasher(&hm, NULL, CU_HM_WYHASH) == 0);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_insert(&hm, get_key(i), KEY_STORAGE[i]) == 0);
+	}
+	cu_hm_frozen frozen;
+	dbgassert(cu_hm_freeze(&frozen, &hm) == 0);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_frozen_at(&frozen, get_key(i))
+			== KEY_STORAGE[i]);
+	}
+	cu_hm_frozen_free(&frozen);
+	cu_hm_free(&hm);
+}
+
+int main(void)
+{
+	test_freeze(0);
+	test_freeze(1);
+	test_freeze(5);
+	test_freeze(NUM_KEYS);
+	test_freeze_incremental();
+	test_freeze_hasher();
+}
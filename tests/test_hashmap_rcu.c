@@ -0,0 +1,107 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <cu/hashmap_rcu.h>
+#include <cu/dbgassert.h>
+
+#ifndef _WIN32
+#	include <pthread.h>
+#endif
+
+#define NUM_READERS 4
+#define NUM_KEYS 256
+#define NUM_VERSIONS 64
+#define KEY_LEN 16
+static char KEY_STORAGE[NUM_KEYS][KEY_LEN];
+static cu_str KEYS[NUM_KEYS];
+static cu_hm_rcu *MAP;
+static atomic_bool DONE;
+
+// values are the version of the map they were published in
+static void *reader(void *arg)
+{
+	(void)arg;
+	cu_hm_rcu_reader *rd = cu_hm_rcu_register(MAP);
+	dbgassert(rd != NULL);
+	while (!atomic_load(&DONE)) {
+		// every key in one snapshot must come from the same version
+		cu_hm *snap = cu_hm_rcu_read_lock(rd);
+		uintptr_t version = (uintptr_t)cu_hm_at(snap, KEYS[0]);
+		for (size_t i = 1; i < NUM_KEYS; ++i) {
+			uintptr_t val = (uintptr_t)cu_hm_at(snap, KEYS[i]);
+			dbgassert(val == version);
+		}
+		cu_hm_rcu_read_unlock(rd);
+		cu_hm_rcu_at(rd, KEYS[NUM_KEYS - 1]);
+	}
+	cu_hm_rcu_unregister(rd);
+	return NULL;
+}
+
+static void publish_versions(void)
+{
+	for (uintptr_t version = 1; version <= NUM_VERSIONS; ++version) {
+		cu_hm table;
+		dbgassert(cu_hm_rcu_clone(MAP, &table) == 0);
+		for (size_t i = 0; i < NUM_KEYS; ++i) {
+			dbgassert(cu_hm_insert(&table, KEYS[i], (void *)version)
+				== 0);
+		}
+		dbgassert(cu_hm_rcu_publish(MAP, &table) == 0);
+	}
+}
+
+int main(void)
+{
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		snprintf(KEY_STORAGE[i], KEY_LEN, "key%zu", i);
+		KEYS[i] = cu_str_from_cstr(KEY_STORAGE[i]);
+	}
+	MAP = cu_hm_rcu_new(NUM_READERS + 1, NULL);
+	dbgassert(MAP != NULL);
+	atomic_init(&DONE, false);
+
+	// starting from a consistent version
+	publish_versions();
+
+#ifndef _WIN32
+	pthread_t threads[NUM_READERS];
+	for (size_t i = 0; i < NUM_READERS; ++i) {
+		dbgassert(pthread_create(threads + i, NULL, reader, NULL) == 0);
+	}
+	publish_versions();
+	atomic_store(&DONE, true);
+	for (size_t i = 0; i < NUM_READERS; ++i) {
+		dbgassert(pthread_join(threads[i], NULL) == 0);
+	}
+#endif
+	cu_hm_rcu_synchronize(MAP);
+
+	cu_hm_rcu_reader *rd = cu_hm_rcu_register(MAP);
+	dbgassert(rd != NULL);
+	// readers sit on their own cache lines
+	dbgassert((uintptr_t)rd % 64 == 0);
+	dbgassert(cu_hm_rcu_at(rd, KEYS[0]) != NULL);
+	dbgassert(cu_hm_rcu_insert(MAP, cu_str_from_cstr("new"), KEYS) == 0);
+	dbgassert(cu_hm_rcu_at(rd, cu_str_from_cstr("new")) == KEYS);
+	dbgassert(cu_hm_rcu_erase(MAP, cu_str_from_cstr("new")) == KEYS);
+	dbgassert(cu_hm_rcu_at(rd, cu_str_from_cstr("new")) == NULL);
+	dbgassert(cu_hm_rcu_erase(MAP, cu_str_from_cstr("new")) == NULL);
+
+	// a reader holding a snapshot keeps it alive
+	cu_hm *snap = cu_hm_rcu_read_lock(rd);
+	dbgassert(cu_hm_rcu_insert(MAP, cu_str_from_cstr("new"), KEYS) == 0);
+	dbgassert(cu_hm_at(snap, cu_str_from_cstr("new")) == NULL);
+	dbgassert(cu_hm_at(snap, KEYS[0]) != NULL);
+	cu_hm_rcu_read_unlock(rd);
+	cu_hm_rcu_unregister(rd);
+
+	cu_hm_rcu_synchronize(MAP);
+	cu_hm_rcu_free(MAP);
+}
@@ -0,0 +1,94 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <stdint.h>
+#include <stdio.h>
+#include <cu/hashmap_sharded.h>
+#include <cu/dbgassert.h>
+
+#ifndef _WIN32
+#	include <pthread.h>
+#endif
+
+#define NUM_THREADS 8
+#define KEYS_PER_THREAD 512
+#define NUM_KEYS (NUM_THREADS * KEYS_PER_THREAD)
+#define KEY_LEN 16
+static char KEY_STORAGE[NUM_KEYS][KEY_LEN];
+static cu_str KEYS[NUM_KEYS];
+static cu_hm_sharded MAP;
+
+static void *writer(void *arg)
+{
+	size_t start = (uintptr_t)arg * KEYS_PER_THREAD;
+	for (size_t i = start; i < start + KEYS_PER_THREAD; ++i) {
+		dbgassert(cu_hm_sharded_insert(&MAP, KEYS[i], KEY_STORAGE[i])
+			== 0);
+		// reading back other threads' keys while they're writing
+		void *other = cu_hm_sharded_at(&MAP, KEYS[(i * 7) % NUM_KEYS]);
+		dbgassert(other == NULL
+			|| other == KEY_STORAGE[(i * 7) % NUM_KEYS]);
+	}
+	for (size_t i = start; i < start + KEYS_PER_THREAD; i += 2) {
+		dbgassert(cu_hm_sharded_erase(&MAP, KEYS[i]) == KEY_STORAGE[i]);
+	}
+	return NULL;
+}
+
+static void run_writers(void)
+{
+#ifndef _WIN32
+	pthread_t threads[NUM_THREADS];
+	for (uintptr_t i = 0; i < NUM_THREADS; ++i) {
+		dbgassert(pthread_create(threads + i, NULL, writer, (void *)i)
+			== 0);
+	}
+	for (size_t i = 0; i < NUM_THREADS; ++i) {
+		dbgassert(pthread_join(threads[i], NULL) == 0);
+	}
+#else
+	for (uintptr_t i = 0; i < NUM_THREADS; ++i) {
+		writer((void *)i);
+	}
+#endif
+}
+
+int main(void)
+{
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		snprintf(KEY_STORAGE[i], KEY_LEN, "key%zu", i);
+		KEYS[i] = cu_str_from_cstr(KEY_STORAGE[i]);
+	}
+	dbgassert(cu_hm_sharded_new(&MAP, 13, NULL) == 0);
+	dbgassert(MAP.nshards == 16);
+	// shards start on cache lines
+	dbgassert((uintptr_t)MAP.shards % 64 == 0);
+	dbgassert(cu_hm_sharded_reserve(&MAP, NUM_KEYS / 4) == 0);
+
+	run_writers();
+
+	dbgassert(cu_hm_sharded_size(&MAP) == NUM_KEYS / 2);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		void *val = cu_hm_sharded_at(&MAP, KEYS[i]);
+		dbgassert(val == (i % 2 == 0 ? NULL : KEY_STORAGE[i]));
+	}
+
+	size_t count = 0;
+	cu_hm_sharded_iter it = cu_hm_sharded_begin(&MAP);
+	cu_hm_bucket *cur = NULL;
+	while ((cur = cu_hm_sharded_next(&it)) != NULL) {
+		++count;
+	}
+	dbgassert(count == NUM_KEYS / 2);
+
+	// stopping early must release the shard's lock
+	it = cu_hm_sharded_begin(&MAP);
+	dbgassert(cu_hm_sharded_next(&it) != NULL);
+	cu_hm_sharded_end(&it);
+	dbgassert(cu_hm_sharded_insert(&MAP, KEYS[0], KEY_STORAGE[0]) == 0);
+
+	cu_hm_sharded_free(&MAP);
+}
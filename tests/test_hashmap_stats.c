@@ -0,0 +1,70 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+// Builds cu_hm with CU_HM_STATS on, whether or not the library was.
+
+#ifndef CU_HM_STATS
+#define CU_HM_STATS
+#endif
+#include "../src/hashmap.c"
+#include <stdio.h>
+#include <cu/dbgassert.h>
+
+#include "keys.h"
+
+static uint64_t RESIZES_SEEN;
+static uint64_t LAST_CAPACITY;
+
+static void on_resize(const cu_hm_resize_event *event, void *ctx)
+{
+	dbgassert(ctx == &RESIZES_SEEN);
+	dbgassert(event->new_capacity > event->old_capacity);
+	dbgassert(event->old_capacity == LAST_CAPACITY);
+	LAST_CAPACITY = event->new_capacity;
+	++RESIZES_SEEN;
+}
+
+static void test_stats(bool incremental)
+{
+	RESIZES_SEEN = 0;
+	LAST_CAPACITY = 0;
+	cu_hm hm;
+	dbgassert(cu_hm_new(&hm, NULL) == 0);
+	cu_hm_set_incremental(&hm, incremental);
+	hm.stats.on_resize = on_resize;
+	hm.stats.on_resize_ctx = &RESIZES_SEEN;
+
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_insert(&hm, get_key(i), KEY_STORAGE[i]) == 0);
+	}
+	const cu_hm_stats *stats = &hm.stats;
+	dbgassert(stats->resizes == RESIZES_SEEN && RESIZES_SEEN > 0);
+	dbgassert(stats->max_resize_nanoseconds <= stats->resize_nanoseconds);
+	dbgassert(stats->bytes_allocated == (hm.capacity + hm.old_capacity)
+		* sizeof(cu_hm_bucket));
+	dbgassert(stats->peak_bytes_allocated >= stats->bytes_allocated);
+
+	cu_hm_stats_reset(&hm);
+	dbgassert(stats->probes == 0 && stats->resizes == 0);
+	dbgassert(stats->bytes_allocated != 0);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_at(&hm, get_key(i)) == KEY_STORAGE[i]);
+	}
+	uint64_t probes = 0;
+	for (size_t i = 0; i < CU_HM_STATS_PROBE_LENGTHS; ++i)
+		probes += stats->probe_lengths[i];
+	dbgassert(probes == stats->probes && probes >= NUM_KEYS);
+	dbgassert(stats->max_probe_length < hm.capacity);
+	dbgassert(stats->total_probe_length
+		<= probes * stats->max_probe_length);
+	cu_hm_free(&hm);
+}
+
+int main(void)
+{
+	test_stats(false);
+	test_stats(true);
+}
@@ -0,0 +1,236 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+// Runs cu_hm through its whole interface with the CU_HM_SWISS layout.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <cu/hashmap.h>
+#include <cu/dbgassert.h>
+
+#include "keys.h"
+
+static void new_swiss(cu_hm *hm, cu_hm_hasher hasher)
+{
+	dbgassert(cu_hm_new_engine(hm, NULL, hasher, CU_HM_SWISS) == 0);
+	dbgassert(hm->engine == CU_HM_SWISS && hm->hasher == hasher);
+}
+
+static void test_insert(cu_hm_hasher hasher)
+{
+	cu_hm hm;
+	new_swiss(&hm, hasher);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_at(&hm, get_key(i)) == NULL);
+	}
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_insert(&hm, get_key(i), KEY_STORAGE[i]) == 0);
+	}
+	dbgassert(hm.nel == NUM_KEYS);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_at(&hm, get_key(i)) == KEY_STORAGE[i]);
+	}
+	// overwriting
+	dbgassert(cu_hm_insert(&hm, get_key(0), KEY_STORAGE[1]) == 0);
+	dbgassert(cu_hm_at(&hm, get_key(0)) == KEY_STORAGE[1]);
+	dbgassert(hm.nel == NUM_KEYS);
+	dbgassert(!cu_hm_contains(&hm, cu_str_from_cstr("asdf")));
+
+	bool inserted = true;
+	cu_hm_bucket *bucket = cu_hm_get_or_insert(&hm, get_key(1), &inserted);
+	dbgassert(!inserted && bucket->value == KEY_STORAGE[1]);
+	bucket = cu_hm_get_or_insert(&hm, cu_str_from_cstr("new"), &inserted);
+	dbgassert(inserted && bucket->value == NULL);
+	bucket->value = KEY_STORAGE[2];
+	dbgassert(cu_hm_at(&hm, cu_str_from_cstr("new")) == KEY_STORAGE[2]);
+	dbgassert(hm.nel == NUM_KEYS + 1);
+
+#ifdef CU_HM_STATS
+	dbgassert(hm.stats.probes > 0);
+	dbgassert(hm.stats.bytes_allocated == hm.capacity
+		* (sizeof(cu_hm_bucket) + 1) + CU_HM_SWISS_GROUP);
+#endif
+	cu_hm_free(&hm);
+}
+
+static void test_erase(void)
+{
+	cu_hm hm;
+	new_swiss(&hm, CU_HM_SIPHASH13);
+	dbgassert(cu_hm_erase(&hm, get_key(0)) == NULL);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_insert(&hm, get_key(i), KEY_STORAGE[i]) == 0);
+	}
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		dbgassert(cu_hm_erase(&hm, get_key(i)) == KEY_STORAGE[i]);
+		dbgassert(cu_hm_erase(&hm, get_key(i)) == NULL);
+	}
+	dbgassert(hm.nel == NUM_KEYS / 2);
+
+	// churning, deleted markers must get cleaned up instead of growing
+	// the table forever
+	for (size_t round = 0; round < 64; ++round) {
+		for (size_t i = 0; i < NUM_KEYS; i += 2) {
+			dbgassert(cu_hm_insert(&hm, get_key(i), KEY_STORAGE[i])
+				== 0);
+		}
+		for (size_t i = 0; i < NUM_KEYS; i += 2) {
+			dbgassert(cu_hm_erase(&hm, get_key(i))
+				== KEY_STORAGE[i]);
+		}
+	}
+	dbgassert(hm.capacity <= 4 * NUM_KEYS);
+
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		void *val = cu_hm_at(&hm, get_key(i));
+		if (i % 2 == 0)
+			dbgassert(val == NULL);
+		else
+			dbgassert(val == KEY_STORAGE[i]);
+	}
+
+	size_t count = 0;
+	cu_hm_iter it = cu_hm_begin(&hm);
+	cu_hm_bucket *cur = NULL;
+	while ((cur = cu_hm_next(&it)) != NULL) {
+		dbgassert(cur->value == cu_hm_at(&hm, cur->key));
+		dbgassert(cur->hash == cu_hm_hash(&hm, cur->key));
+		++count;
+	}
+	dbgassert(count == NUM_KEYS / 2);
+	cu_hm_free(&hm);
+}
+
+static void test_at_many(void)
+{
+	cu_hm hm;
+	new_swiss(&hm, CU_HM_SIPHASH13);
+	cu_str keys[NUM_KEYS];
+	void *values[NUM_KEYS];
+	cu_hm_at_many(&hm, NULL, 0, NULL);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		keys[i] = get_key(i);
+		if (i % 3 != 0)
+			dbgassert(cu_hm_insert(&hm, keys[i], KEY_STORAGE[i])
+				== 0);
+	}
+	cu_hm_at_many(&hm, keys, NUM_KEYS, values);
+	for (size_t i = 0; i < NUM_KEYS; ++i)
+		dbgassert(values[i] == (i % 3 == 0 ? NULL : KEY_STORAGE[i]));
+
+	uint64_t hash = cu_hm_hash(&hm, keys[1]);
+	dbgassert(cu_hm_at_hashed(&hm, keys[1], hash) == KEY_STORAGE[1]);
+	dbgassert(cu_hm_erase_hashed(&hm, keys[1], hash) == KEY_STORAGE[1]);
+	dbgassert(cu_hm_insert_hashed(&hm, keys[1], hash, KEY_STORAGE[2])
+		== 0);
+	dbgassert(cu_hm_at(&hm, keys[1]) == KEY_STORAGE[2]);
+	cu_hm_free(&hm);
+}
+
+static void test_clone_shrink(void)
+{
+	cu_hm hm;
+	new_swiss(&hm, CU_HM_SIPHASH13);
+	dbgassert(cu_hm_shrink_to_fit(&hm) == 0);
+	dbgassert(cu_hm_reserve(&hm, NUM_KEYS) == 0);
+	uint64_t capacity = hm.capacity;
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_insert(&hm, get_key(i), KEY_STORAGE[i]) == 0);
+	}
+	// reserving made enough room up front
+	dbgassert(hm.capacity == capacity);
+
+	cu_hm clone;
+	dbgassert(cu_hm_clone(&clone, &hm) == 0);
+	dbgassert(clone.engine == CU_HM_SWISS);
+	for (size_t i = 0; i < NUM_KEYS - 8; ++i) {
+		dbgassert(cu_hm_erase(&clone, get_key(i)) == KEY_STORAGE[i]);
+	}
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_at(&hm, get_key(i)) == KEY_STORAGE[i]);
+		dbgassert(cu_hm_at(&clone, get_key(i))
+			== (i < NUM_KEYS - 8 ? NULL : KEY_STORAGE[i]));
+	}
+
+	dbgassert(cu_hm_shrink_to_fit(&clone) == 0);
+	dbgassert(clone.capacity < capacity);
+	for (size_t i = NUM_KEYS - 8; i < NUM_KEYS; ++i)
+		dbgassert(cu_hm_at(&clone, get_key(i)) == KEY_STORAGE[i]);
+	for (size_t i = NUM_KEYS - 8; i < NUM_KEYS; ++i)
+		dbgassert(cu_hm_erase(&clone, get_key(i)) == KEY_STORAGE[i]);
+	dbgassert(cu_hm_shrink_to_fit(&clone) == 0);
+	dbgassert(clone.capacity == 0);
+	dbgassert(cu_hm_insert(&clone, get_key(0), KEY_STORAGE[0]) == 0);
+	dbgassert(cu_hm_at(&clone, get_key(0)) == KEY_STORAGE[0]);
+	cu_hm_free(&clone);
+	cu_hm_free(&hm);
+}
+
+static void test_build(void)
+{
+	cu_str keys[NUM_KEYS + 1];
+	void *values[NUM_KEYS + 1];
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		keys[i] = get_key(i);
+		values[i] = KEY_STORAGE[i];
+	}
+	// a duplicate key keeps its last value
+	keys[NUM_KEYS] = get_key(3);
+	values[NUM_KEYS] = KEY_STORAGE[4];
+
+	cu_hm hm;
+	dbgassert(cu_hm_build_engine(&hm, NULL, keys, values, NUM_KEYS + 1,
+		CU_HM_WYHASH, CU_HM_SWISS) == 0);
+	dbgassert(hm.engine == CU_HM_SWISS && hm.hasher == CU_HM_WYHASH);
+	dbgassert(hm.nel == NUM_KEYS);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_at(&hm, get_key(i))
+			== KEY_STORAGE[i == 3 ? 4 : i]);
+	}
+	cu_hm_free(&hm);
+}
+
+static void test_cpy(void)
+{
+	cu_keystore store;
+	dbgassert(cu_keystore_new(&store, NULL, 4096) == 0);
+	cu_hm_cpy owned;
+	cu_hm_cpy shared;
+	dbgassert(cu_hm_cpy_new_engine(&owned, NULL, 4096, CU_HM_SIPHASH13,
+		CU_HM_SWISS) == 0);
+	dbgassert(cu_hm_cpy_new_shared_engine(&shared, NULL, &store,
+		CU_HM_SIPHASH13, CU_HM_SWISS) == 0);
+	dbgassert(owned.hm.engine == CU_HM_SWISS);
+	dbgassert(shared.hm.engine == CU_HM_SWISS);
+
+	char buf[KEY_LEN];
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		snprintf(buf, KEY_LEN, "key%zu", i);
+		cu_str key = cu_str_from_cstr(buf);
+		dbgassert(cu_hm_cpy_insert(&owned, key, KEY_STORAGE[i]) == 0);
+		dbgassert(cu_hm_cpy_insert(&shared, key, KEY_STORAGE[i]) == 0);
+	}
+	// the maps hold their own copies of the keys
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_cpy_at(&owned, get_key(i)) == KEY_STORAGE[i]);
+		dbgassert(cu_hm_cpy_at(&shared, get_key(i)) == KEY_STORAGE[i]);
+	}
+	cu_hm_cpy_free(&owned);
+	cu_hm_cpy_free(&shared);
+	cu_keystore_free(&store);
+}
+
+int main(void)
+{
+	test_insert(CU_HM_SIPHASH13);
+	test_insert(CU_HM_SIPHASH24);
+	test_insert(CU_HM_WYHASH);
+	test_erase();
+	test_at_many();
+	test_clone_shrink();
+	test_build();
+	test_cpy();
+}
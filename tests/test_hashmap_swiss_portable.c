@@ -0,0 +1,12 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+// Runs the Swiss table tests again, with the portable group matching instead
+// of SSE2.
+
+#define CU_HM_SWISS_NO_SIMD
+#include "../src/hashmap.c"
+#include "test_hashmap_swiss.c"
@@ -0,0 +1,133 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <stdint.h>
+#include <cu/hashmap_u64.h>
+#include <cu/dbgassert.h>
+
+#define NUM_KEYS 1024
+static int VALUES[NUM_KEYS];
+
+// spread out so that keys don't just land in consecutive buckets
+static uint64_t get_key(size_t i)
+{
+	return (uint64_t)i * UINT64_C(0x9E3779B97F4A7C15);
+}
+
+// a 12-byte key without padding
+typedef struct {
+	uint32_t parts[3];
+} triple;
+
+CU_HM_TYPED_DECLARE(triple_map, triple)
+CU_HM_TYPED_DEFINE(triple_map, triple)
+
+static void test_insert(cu_hm_fixed_hash kind)
+{
+	cu_hm_u64 hm;
+	dbgassert(cu_hm_u64_new(&hm, NULL, kind) == 0);
+	dbgassert(sizeof(cu_hm_u64_bucket) == 16);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_u64_at(&hm, get_key(i)) == NULL);
+	}
+	// key 0 is get_key(0), so the zero key gets tested too
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_u64_insert(&hm, get_key(i), VALUES + i) == 0);
+	}
+	dbgassert(hm.nel == NUM_KEYS);
+	dbgassert(hm.has_zero);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_u64_at(&hm, get_key(i)) == VALUES + i);
+	}
+	dbgassert(!cu_hm_u64_contains(&hm, 1));
+
+	// overwriting
+	dbgassert(cu_hm_u64_insert(&hm, get_key(1), VALUES) == 0);
+	dbgassert(cu_hm_u64_at(&hm, get_key(1)) == VALUES);
+	dbgassert(hm.nel == NUM_KEYS);
+
+	bool inserted = true;
+	cu_hm_u64_bucket *bucket =
+		cu_hm_u64_get_or_insert(&hm, get_key(2), &inserted);
+	dbgassert(!inserted && bucket->value == VALUES + 2);
+	bucket = cu_hm_u64_get_or_insert(&hm, 1, &inserted);
+	dbgassert(inserted && bucket->key == 1 && bucket->value == NULL);
+	dbgassert(hm.nel == NUM_KEYS + 1);
+	cu_hm_u64_free(&hm);
+}
+
+static void test_erase(cu_hm_fixed_hash kind)
+{
+	cu_hm_u64 hm;
+	dbgassert(cu_hm_u64_new(&hm, NULL, kind) == 0);
+	dbgassert(cu_hm_u64_erase(&hm, 0) == NULL);
+	dbgassert(cu_hm_u64_erase(&hm, 5) == NULL);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_u64_insert(&hm, get_key(i), VALUES + i) == 0);
+	}
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		dbgassert(cu_hm_u64_erase(&hm, get_key(i)) == VALUES + i);
+		dbgassert(cu_hm_u64_erase(&hm, get_key(i)) == NULL);
+	}
+	dbgassert(hm.nel == NUM_KEYS / 2);
+	dbgassert(!hm.has_zero);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		void *val = cu_hm_u64_at(&hm, get_key(i));
+		dbgassert(val == (i % 2 == 0 ? NULL : VALUES + i));
+	}
+	cu_hm_u64_free(&hm);
+}
+
+static void test_iter(void)
+{
+	cu_hm_u64 hm;
+	dbgassert(cu_hm_u64_new(&hm, NULL, CU_HM_FIXED_MIX) == 0);
+	cu_hm_u64_iter iter = cu_hm_u64_begin(&hm);
+	dbgassert(cu_hm_u64_next(&iter) == NULL);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_u64_insert(&hm, get_key(i), VALUES + i) == 0);
+	}
+	size_t count = 0;
+	iter = cu_hm_u64_begin(&hm);
+	cu_hm_u64_bucket *bucket;
+	while ((bucket = cu_hm_u64_next(&iter)) != NULL) {
+		int *val = bucket->value;
+		dbgassert(get_key(val - VALUES) == bucket->key);
+		++count;
+	}
+	dbgassert(count == NUM_KEYS);
+	cu_hm_u64_free(&hm);
+}
+
+static void test_typed(void)
+{
+	triple_map hm;
+	dbgassert(triple_map_new(&hm, NULL, CU_HM_FIXED_MIX) == 0);
+	for (uint32_t i = 0; i < NUM_KEYS; ++i) {
+		triple key = {{i, i * 7, i % 3}};
+		dbgassert(triple_map_insert(&hm, key, VALUES + i) == 0);
+	}
+	for (uint32_t i = 0; i < NUM_KEYS; ++i) {
+		triple key = {{i, i * 7, i % 3}};
+		dbgassert(triple_map_at(&hm, key) == VALUES + i);
+		key.parts[2] += 1;
+		dbgassert(triple_map_at(&hm, key) == NULL);
+	}
+	triple zero = {{0, 0, 0}};
+	dbgassert(triple_map_erase(&hm, zero) == VALUES);
+	dbgassert(hm.nel == NUM_KEYS - 1);
+	triple_map_free(&hm);
+}
+
+int main(void)
+{
+	test_insert(CU_HM_FIXED_SIPHASH);
+	test_insert(CU_HM_FIXED_MIX);
+	test_erase(CU_HM_FIXED_SIPHASH);
+	test_erase(CU_HM_FIXED_MIX);
+	test_iter();
+	test_typed();
+}
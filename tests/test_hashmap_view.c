@@ -0,0 +1,97 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cu/hashmap_view.h>
+#include <cu/dbgassert.h>
+
+#include "keys.h"
+
+#define PATH "test_hashmap_view.bin"
+
+static void save_map(size_t nkeys)
+{
+	cu_hm hm;
+	dbgassert(cu_hm_new(&hm, NULL) == 0);
+	for (size_t i = 0; i < nkeys; ++i) {
+		// values are offsets, not pointers
+		dbgassert(cu_hm_insert(&hm, get_key(i), (void *)(i * 100 + 1))
+			== 0);
+	}
+	dbgassert(cu_hm_save(&hm, PATH) == 0);
+	cu_hm_free(&hm);
+}
+
+static void test_view(size_t nkeys)
+{
+	save_map(nkeys);
+	cu_hm_view view;
+	dbgassert(cu_hm_view_open(&view, PATH) == 0);
+	dbgassert(view.nel == nkeys);
+	for (size_t i = 0; i < nkeys; ++i) {
+		uint64_t value = 0;
+		dbgassert(cu_hm_view_at(&view, get_key(i), &value));
+		dbgassert(value == i * 100 + 1);
+	}
+	for (size_t i = nkeys; i < NUM_KEYS; ++i) {
+		dbgassert(!cu_hm_view_contains(&view, get_key(i)));
+	}
+
+	size_t count = 0;
+	cu_hm_view_iter iter = cu_hm_view_begin(&view);
+	cu_str key;
+	uint64_t value;
+	while (cu_hm_view_next(&iter, &key, &value)) {
+		size_t i = (value - 1) / 100;
+		dbgassert(cu_str_eq(key, get_key(i)));
+		++count;
+	}
+	dbgassert(count == nkeys);
+	cu_hm_view_close(&view);
+}
+
+static void test_invalid(void)
+{
+	cu_hm_view view;
+	remove(PATH);
+	dbgassert(cu_hm_view_open(&view, PATH) != 0);
+
+	FILE *file = fopen(PATH, "wb");
+	dbgassert(file != NULL);
+	dbgassert(fputs("not a hashmap, but long enough to have a header",
+		file) >= 0);
+	dbgassert(fclose(file) == 0);
+	dbgassert(cu_hm_view_open(&view, PATH) != 0);
+
+	// cutting a valid file short
+	save_map(NUM_KEYS);
+	file = fopen(PATH, "r+b");
+	dbgassert(file != NULL);
+	dbgassert(fseek(file, 0, SEEK_END) == 0);
+	long size = ftell(file);
+	dbgassert(fclose(file) == 0);
+	char *buf = malloc(size);
+	file = fopen(PATH, "rb");
+	dbgassert(fread(buf, 1, size, file) == (size_t)size);
+	dbgassert(fclose(file) == 0);
+	file = fopen(PATH, "wb");
+	dbgassert(fwrite(buf, 1, 200, file) == 200);
+	dbgassert(fclose(file) == 0);
+	free(buf);
+	dbgassert(cu_hm_view_open(&view, PATH) != 0);
+	remove(PATH);
+}
+
+int main(void)
+{
+	test_view(0);
+	test_view(1);
+	test_view(NUM_KEYS);
+	test_invalid();
+	remove(PATH);
+}
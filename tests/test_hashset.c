@@ -0,0 +1,153 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cu/hashset.h>
+#include <cu/dbgassert.h>
+
+#include "keys.h"
+
+// the set of every key whose index is a multiple of `step`
+static void make_multiples(cu_hs *set, size_t step)
+{
+	for (size_t i = 0; i < NUM_KEYS; i += step) {
+		dbgassert(cu_hs_insert(set, get_key(i), NULL) == 0);
+	}
+}
+
+static size_t count(const cu_hs *set)
+{
+	size_t n = 0;
+	cu_hs_iter iter = cu_hs_begin(set);
+	while (cu_hs_next(&iter) != NULL)
+		++n;
+	return n;
+}
+
+static void test_insert_erase(void)
+{
+	cu_hs set;
+	dbgassert(cu_hs_new(&set, NULL) == 0);
+	dbgassert(!cu_hs_contains(&set, get_key(0)));
+	dbgassert(!cu_hs_erase(&set, get_key(0)));
+
+	bool inserted = false;
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hs_insert(&set, get_key(i), &inserted) == 0);
+		dbgassert(inserted);
+	}
+	dbgassert(cu_hs_insert(&set, get_key(7), &inserted) == 0);
+	dbgassert(!inserted);
+	dbgassert(set.nel == NUM_KEYS);
+	dbgassert(count(&set) == NUM_KEYS);
+
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		dbgassert(cu_hs_erase(&set, get_key(i)));
+		dbgassert(!cu_hs_erase(&set, get_key(i)));
+	}
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hs_contains(&set, get_key(i)) == (i % 2 == 1));
+	}
+	dbgassert(count(&set) == NUM_KEYS / 2);
+	cu_hs_free(&set);
+}
+
+static void test_set_ops(bool shared_key)
+{
+	cu_hs twos, threes;
+	dbgassert(cu_hs_new(&twos, NULL) == 0);
+	if (shared_key)
+		cu_hs_new_with_key(&threes, NULL, &twos.key);
+	else
+		dbgassert(cu_hs_new(&threes, NULL) == 0);
+	make_multiples(&twos, 2);
+	make_multiples(&threes, 3);
+
+	cu_hs result;
+	dbgassert(cu_hs_union(&result, &twos, &threes) == 0);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hs_contains(&result, get_key(i))
+			== (i % 2 == 0 || i % 3 == 0));
+	}
+	dbgassert(count(&result) == result.nel);
+	cu_hs_free(&result);
+
+	dbgassert(cu_hs_intersection(&result, &twos, &threes) == 0);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hs_contains(&result, get_key(i)) == (i % 6 == 0));
+	}
+	cu_hs_free(&result);
+
+	dbgassert(cu_hs_difference(&result, &twos, &threes) == 0);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hs_contains(&result, get_key(i))
+			== (i % 2 == 0 && i % 3 != 0));
+	}
+	cu_hs_free(&result);
+
+	cu_hs empty;
+	dbgassert(cu_hs_new(&empty, NULL) == 0);
+	dbgassert(cu_hs_intersection(&result, &empty, &twos) == 0);
+	dbgassert(result.nel == 0 && count(&result) == 0);
+	cu_hs_free(&result);
+	dbgassert(cu_hs_union(&result, &empty, &twos) == 0);
+	dbgassert(result.nel == twos.nel);
+	cu_hs_free(&result);
+
+	cu_hs_free(&empty);
+	cu_hs_free(&threes);
+	cu_hs_free(&twos);
+}
+
+static size_t NALLOCS;
+
+static void *counting_alloc(size_t amount, void *ctx)
+{
+	(void)ctx;
+	++NALLOCS;
+	return malloc(amount);
+}
+
+static void counting_free(void *mem, size_t amount, void *ctx)
+{
+	(void)amount;
+	(void)ctx;
+	free(mem);
+}
+
+// A union of disjoint sets is allocated once up front, and never grows.
+static void test_disjoint_union(void)
+{
+	cu_alloc alloc = {.alloc = counting_alloc, .free = counting_free};
+	cu_hs evens, odds;
+	dbgassert(cu_hs_new(&evens, &alloc) == 0);
+	cu_hs_new_with_key(&odds, &alloc, &evens.key);
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hs_insert(i % 2 == 0 ? &evens : &odds,
+			get_key(i), NULL) == 0);
+	}
+
+	cu_hs result;
+	NALLOCS = 0;
+	dbgassert(cu_hs_union(&result, &evens, &odds) == 0);
+	dbgassert(NALLOCS == 1);
+	dbgassert(result.nel == NUM_KEYS);
+	for (size_t i = 0; i < NUM_KEYS; ++i)
+		dbgassert(cu_hs_contains(&result, get_key(i)));
+	cu_hs_free(&result);
+	cu_hs_free(&odds);
+	cu_hs_free(&evens);
+}
+
+int main(void)
+{
+	test_insert_erase();
+	test_set_ops(true);
+	test_set_ops(false);
+	test_disjoint_union();
+}
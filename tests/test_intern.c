@@ -0,0 +1,83 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <stdint.h>
+#include <stdio.h>
+#include <cu/intern.h>
+#include <cu/dbgassert.h>
+
+#include "keys.h"
+
+static void test_intern_str(void)
+{
+	cu_intern table;
+	dbgassert(cu_intern_new(&table, NULL, 256) == 0);
+	uint32_t id = 1234;
+	dbgassert(!cu_intern_find(&table, get_key(0), &id));
+	dbgassert(id == 1234);
+
+	// IDs are handed out densely, in order
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_intern_str(&table, get_key(i), &id) == 0);
+		dbgassert(id == i);
+	}
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_intern_str(&table, get_key(i), &id) == 0);
+		dbgassert(id == i);
+		dbgassert(cu_intern_find(&table, get_key(i), &id) && id == i);
+	}
+	dbgassert(table.nel == NUM_KEYS);
+
+	// the table keeps its own copies
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		memset(KEY_STORAGE[i], 'x', KEY_LEN - 1);
+	}
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		cu_str str = cu_intern_get(&table, i);
+		dbgassert(str.buf != (uint8_t *)KEY_STORAGE[i]);
+		dbgassert(cu_str_eq(str, get_key(i)));
+	}
+	cu_intern_free(&table);
+}
+
+static void test_intern_many(void)
+{
+	cu_intern table;
+	dbgassert(cu_intern_new(&table, NULL, 256) == 0);
+
+	// a stream with repeats, both within and across batches
+	enum { STREAM_LEN = 3 * NUM_KEYS + 7 };
+	static cu_str stream[STREAM_LEN];
+	static uint32_t ids[STREAM_LEN];
+	for (size_t i = 0; i < STREAM_LEN; ++i) {
+		stream[i] = get_key((i * 7) % (NUM_KEYS / 2));
+	}
+	dbgassert(cu_intern_many(&table, stream, STREAM_LEN, ids) == 0);
+	dbgassert(table.nel == NUM_KEYS / 2);
+	for (size_t i = 0; i < STREAM_LEN; ++i) {
+		dbgassert(cu_str_eq(cu_intern_get(&table, ids[i]), stream[i]));
+		uint32_t id;
+		dbgassert(cu_intern_find(&table, stream[i], &id));
+		dbgassert(id == ids[i]);
+	}
+
+	// first appearances get the next IDs
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		stream[i] = get_key(NUM_KEYS - 1 - i);
+	}
+	dbgassert(cu_intern_many(&table, stream, NUM_KEYS, ids) == 0);
+	for (size_t i = 0; i < NUM_KEYS / 2; ++i) {
+		dbgassert(ids[i] == NUM_KEYS / 2 + i);
+	}
+	dbgassert(table.nel == NUM_KEYS);
+	cu_intern_free(&table);
+}
+
+int main(void)
+{
+	test_intern_str();
+	test_intern_many();
+}
@@ -0,0 +1,97 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <stdint.h>
+#include <stdio.h>
+#include <cu/keystore.h>
+#include <cu/hashmap.h>
+#include <cu/dbgassert.h>
+
+#include "keys.h"
+
+static void test_intern(void)
+{
+	cu_keystore store;
+	dbgassert(cu_keystore_new(&store, NULL, 256) == 0);
+	dbgassert(cu_str_isnil(cu_keystore_find(&store, get_key(0))));
+
+	cu_str handles[NUM_KEYS];
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		handles[i] = cu_keystore_intern(&store, get_key(i));
+		dbgassert(!cu_str_isnil(handles[i]));
+		dbgassert(handles[i].buf != (uint8_t *)KEY_STORAGE[i]);
+		dbgassert(cu_str_eq(handles[i], get_key(i)));
+	}
+	// the same bytes from a different buffer give the same handle
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		char buf[KEY_LEN];
+		memcpy(buf, KEY_STORAGE[i], KEY_LEN);
+		cu_str key = cu_str_from_cstr(buf);
+		dbgassert(cu_keystore_intern(&store, key).buf
+			== handles[i].buf);
+		dbgassert(cu_keystore_find(&store, key).buf == handles[i].buf);
+	}
+	dbgassert(store.set.nel == NUM_KEYS);
+
+	// the empty string is a key like any other
+	cu_str empty = cu_keystore_intern(&store, cu_str_from_cstr(""));
+	dbgassert(!cu_str_isnil(empty) && empty.len == 0);
+	dbgassert(cu_keystore_intern(&store, cu_str_from_cstr("")).buf
+		== empty.buf);
+	cu_keystore_free(&store);
+}
+
+static void test_shared_maps(void)
+{
+	cu_keystore store;
+	dbgassert(cu_keystore_new(&store, NULL, 256) == 0);
+	cu_hm_cpy a;
+	cu_hm_cpy b;
+	dbgassert(cu_hm_cpy_new_shared(&a, NULL, &store) == 0);
+	dbgassert(cu_hm_cpy_new_shared(&b, NULL, &store) == 0);
+
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		dbgassert(cu_hm_cpy_insert(&a, get_key(i), KEY_STORAGE[i])
+			== 0);
+	}
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		dbgassert(cu_hm_cpy_insert(&b, get_key(i), KEY_STORAGE[i])
+			== 0);
+	}
+	// b's keys were all in the store already
+	dbgassert(store.set.nel == NUM_KEYS);
+
+	// both maps point at the store's copies
+	for (size_t i = 0; i < NUM_KEYS; i += 2) {
+		cu_str handle = cu_keystore_find(&store, get_key(i));
+		cu_hm_bucket *in_a = cu_hm_cpy_get_or_insert(&a, handle, NULL);
+		cu_hm_bucket *in_b = cu_hm_cpy_get_or_insert(&b, handle, NULL);
+		dbgassert(in_a->key.buf == handle.buf);
+		dbgassert(in_b->key.buf == handle.buf);
+		dbgassert(in_a->value == KEY_STORAGE[i]);
+	}
+
+	// the maps don't depend on the caller's buffers
+	memset(KEY_STORAGE[1], 'x', KEY_LEN - 1);
+	dbgassert(cu_hm_cpy_at(&a, cu_str_from_cstr("key1"))
+		== KEY_STORAGE[1]);
+	dbgassert(cu_hm_cpy_at(&b, cu_str_from_cstr("key1")) == NULL);
+
+	dbgassert(cu_hm_cpy_erase(&a, get_key(2)) == KEY_STORAGE[2]);
+	dbgassert(cu_hm_cpy_at(&b, get_key(2)) == KEY_STORAGE[2]);
+
+	cu_hm_cpy_free(&a);
+	// the store outlives the maps
+	dbgassert(cu_hm_cpy_at(&b, get_key(4)) == KEY_STORAGE[4]);
+	cu_hm_cpy_free(&b);
+	cu_keystore_free(&store);
+}
+
+int main(void)
+{
+	test_intern();
+	test_shared_maps();
+}
@@ -17,7 +17,7 @@ static cu_siphash_key SIPHASH_KEY_DEFAULT = {
 	}
 };
 
-int main(void)
+static void test_vectors(void)
 {
 	uint8_t inbuf[64] = {0};
 	for (size_t i = 0; i < 64; ++i) {
@@ -25,5 +25,149 @@ int main(void)
 		uint64_t hash = cu_siphash_hash(&SIPHASH_KEY_DEFAULT, inbuf, i);
 		uint64_t expected = parse_little_endian(vectors_sip64[i]);
 		assert(hash == expected);
+		// the same whatever SIPHASH_C and SIPHASH_D are
+		hash = cu_siphash24_hash(&SIPHASH_KEY_DEFAULT, inbuf, i);
+		dbgassert(hash == expected);
+	}
+}
+
+static void test_other_outputs(void)
+{
+	uint8_t inbuf[64];
+	for (size_t i = 0; i < 64; ++i) {
+		inbuf[i] = i;
+		uint64_t out[2];
+		cu_siphash128_hash(&SIPHASH_KEY_DEFAULT, inbuf, i, out);
+		dbgassert(out[0] == parse_little_endian(vectors_sip128[i]));
+		dbgassert(out[1] == parse_little_endian(vectors_sip128[i] + 8));
+
+		uint32_t half = cu_halfsiphash_hash(&SIPHASH_KEY_DEFAULT, inbuf,
+			i);
+		dbgassert(half == parse_little_endian32(vectors_hsip32[i]));
+		uint64_t half64 = cu_halfsiphash64_hash(&SIPHASH_KEY_DEFAULT,
+			inbuf, i);
+		dbgassert(half64 == parse_little_endian(vectors_hsip64[i]));
 	}
 }
+
+// Checks every way of hashing 8 messages at once against hashing them one at
+// a time.
+static void check_lanes(const uint8_t *const bufs[8], const size_t sizes[8])
+{
+	const cu_siphash_key *key = &SIPHASH_KEY_DEFAULT;
+	uint64_t expected[8];
+	for (size_t l = 0; l < 8; ++l)
+		expected[l] = cu_siphash_hash(key, bufs[l], sizes[l]);
+
+	uint64_t out[8];
+	cu_siphash_hash_x4(key, bufs, sizes, out);
+	cu_siphash_hash_x4(key, bufs + 4, sizes + 4, out + 4);
+	dbgassert(memcmp(out, expected, sizeof(out)) == 0);
+	cu_siphash_hash_x8(key, bufs, sizes, out);
+	dbgassert(memcmp(out, expected, sizeof(out)) == 0);
+
+	// and the vector versions the dispatch wouldn't pick on this CPU
+#ifdef CU_SIPHASH_X86
+	if (__builtin_cpu_supports("avx2")) {
+		hash_x4_avx2(key, bufs, sizes, out);
+		hash_x4_avx2(key, bufs + 4, sizes + 4, out + 4);
+		dbgassert(memcmp(out, expected, sizeof(out)) == 0);
+	}
+	if (__builtin_cpu_supports("avx512f")) {
+		hash_x8_avx512(key, bufs, sizes, out);
+		dbgassert(memcmp(out, expected, sizeof(out)) == 0);
+	}
+#endif
+}
+
+static void test_lanes(void)
+{
+	uint8_t inbuf[256];
+	for (size_t i = 0; i < sizeof(inbuf); ++i)
+		inbuf[i] = (uint8_t)(i * 7 + 3);
+	const uint8_t *bufs[8];
+	size_t sizes[8];
+
+	// the same lengths in every lane, straight against the test vectors
+	for (size_t len = 0; len < 64; ++len) {
+		uint8_t vecbuf[64];
+		for (size_t i = 0; i < 64; ++i)
+			vecbuf[i] = i;
+		for (size_t l = 0; l < 8; ++l) {
+			bufs[l] = vecbuf;
+			sizes[l] = len;
+		}
+		uint64_t out[8];
+		cu_siphash_hash_x8(&SIPHASH_KEY_DEFAULT, bufs, sizes, out);
+		uint64_t expected = parse_little_endian(vectors_sip64[len]);
+		for (size_t l = 0; l < 8; ++l)
+			dbgassert(out[l] == expected);
+	}
+
+	// lanes finishing at different times, including empty messages
+	uint64_t rng = 12345;
+	for (size_t round = 0; round < 2000; ++round) {
+		for (size_t l = 0; l < 8; ++l) {
+			rng = rng * 6364136223846793005u + 1442695040888963407u;
+			size_t max_len = round % 2 == 0 ? 24 : sizeof(inbuf);
+			sizes[l] = (size_t)(rng >> 33) % (max_len + 1);
+			bufs[l] = inbuf + (sizeof(inbuf) - sizes[l]) / (l + 1);
+		}
+		check_lanes(bufs, sizes);
+	}
+}
+
+// Hashes `buf` a piece at a time, in pieces of `step` bytes.
+static uint64_t hash_in_pieces(const uint8_t *buf, size_t size, size_t step)
+{
+	cu_siphash_state state;
+	cu_siphash_state_init(&state, &SIPHASH_KEY_DEFAULT);
+	for (size_t i = 0; i < size; i += step) {
+		size_t piece = size - i < step ? size - i : step;
+		cu_siphash_update(&state, buf + i, piece);
+		// peeking at the hash so far doesn't disturb it
+		uint64_t so_far = cu_siphash_hash(&SIPHASH_KEY_DEFAULT, buf,
+			i + piece);
+		dbgassert(cu_siphash_final(&state) == so_far);
+	}
+	return cu_siphash_final(&state);
+}
+
+static void test_streaming(void)
+{
+	uint8_t inbuf[300];
+	for (size_t i = 0; i < sizeof(inbuf); ++i)
+		inbuf[i] = i < 64 ? i : (uint8_t)(i * 13 + 1);
+
+	for (size_t len = 0; len < 64; ++len) {
+		uint64_t expected = parse_little_endian(vectors_sip64[len]);
+		for (size_t step = 1; step <= 17; ++step)
+			dbgassert(hash_in_pieces(inbuf, len, step) == expected);
+	}
+
+	// pieces straddling word boundaries in every way, and empty updates
+	uint64_t expected = cu_siphash_hash(&SIPHASH_KEY_DEFAULT, inbuf,
+		sizeof(inbuf));
+	for (size_t step = 1; step <= 40; ++step) {
+		dbgassert(hash_in_pieces(inbuf, sizeof(inbuf), step)
+			== expected);
+	}
+	cu_siphash_state state;
+	cu_siphash_state_init(&state, &SIPHASH_KEY_DEFAULT);
+	cu_siphash_update(&state, inbuf, 0);
+	dbgassert(cu_siphash_final(&state)
+		== parse_little_endian(vectors_sip64[0]));
+	cu_siphash_update(&state, inbuf, 3);
+	cu_siphash_update(&state, inbuf + 3, 0);
+	cu_siphash_update(&state, inbuf + 3, 2);
+	dbgassert(cu_siphash_final(&state)
+		== parse_little_endian(vectors_sip64[5]));
+}
+
+int main(void)
+{
+	test_vectors();
+	test_other_outputs();
+	test_lanes();
+	test_streaming();
+}
@@ -0,0 +1,11 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+// Runs the SipHash tests again, with the multi-message functions hashing one
+// message at a time instead of using AVX2 or AVX-512.
+
+#define CU_SIPHASH_NO_SIMD
+#include "test_siphash.c"
@@ -0,0 +1,83 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cu/dbgassert.h>
+#include "../src/wyhash.c"
+
+// The reference implementation's test vectors, with the seed as the first
+// half of the key.
+static const struct {
+	const char *msg;
+	uint64_t seed;
+	uint64_t hash;
+} VECTORS[] = {
+	{"", 0, UINT64_C(0x93228a4de0eec5a2)},
+	{"a", 1, UINT64_C(0xc5bac3db178713c4)},
+	{"abc", 2, UINT64_C(0xa97f2f7b1d9b3314)},
+	{"message digest", 3, UINT64_C(0x786d1f1df3801df4)},
+	{"abcdefghijklmnopqrstuvwxyz", 4, UINT64_C(0xdca5a8138ad37c87)},
+	{
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+		"0123456789",
+		5,
+		UINT64_C(0xb9e734f117cfaf70),
+	},
+	{
+		"1234567890123456789012345678901234567890"
+		"1234567890123456789012345678901234567890",
+		6,
+		UINT64_C(0x6cc5eab49a92d617),
+	},
+};
+
+static void test_vectors(void)
+{
+	for (size_t i = 0; i < sizeof(VECTORS) / sizeof(VECTORS[0]); ++i) {
+		cu_siphash_key key = {.key = {VECTORS[i].seed, 0}};
+		const uint8_t *msg = (const uint8_t *)VECTORS[i].msg;
+		dbgassert(cu_wyhash(&key, msg, strlen(VECTORS[i].msg))
+			== VECTORS[i].hash);
+	}
+}
+
+// The fallback multiply has to agree with the one that's compiled in.
+static void test_mum(void)
+{
+	uint64_t rng = 1;
+	for (size_t i = 0; i < 100000; ++i) {
+		rng = rng * 6364136223846793005u + 1442695040888963407u;
+		uint64_t a = rng;
+		rng = rng * 6364136223846793005u + 1442695040888963407u;
+		uint64_t b = i % 7 == 0 ? UINT64_MAX : rng;
+		uint64_t a1 = a, b1 = b, a2 = a, b2 = b;
+		mum(&a1, &b1);
+		mum_portable(&a2, &b2);
+		dbgassert(a1 == a2 && b1 == b2);
+	}
+}
+
+// Every length hashes differently, and the second half of the key matters.
+static void test_keyed(void)
+{
+	uint8_t buf[128];
+	for (size_t i = 0; i < sizeof(buf); ++i)
+		buf[i] = (uint8_t)(i * 31);
+	cu_siphash_key key1 = {.key = {1, 2}};
+	cu_siphash_key key2 = {.key = {1, 3}};
+	for (size_t len = 0; len <= sizeof(buf); ++len) {
+		uint64_t hash = cu_wyhash(&key1, buf, len);
+		dbgassert(hash != cu_wyhash(&key2, buf, len));
+		if (len > 0)
+			dbgassert(hash != cu_wyhash(&key1, buf, len - 1));
+	}
+}
+
+int main(void)
+{
+	test_vectors();
+	test_mum();
+	test_keyed();
+}